@@ -0,0 +1,35 @@
+#-------------------------------------------------
+#
+# Benchmark of the Feldbus slave implementation
+# running on the desktop platform
+#
+#-------------------------------------------------
+
+QT       -= core gui
+
+TARGET = feldbus-slave-benchmark
+CONFIG   += console release
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+CONFIG += c++11
+
+QMAKE_CXXFLAGS += -Wall -Wextra -Wno-unused-parameter
+
+# TinA and slave configuration, usually given by the firmware project
+INCLUDEPATH += $$PWD/slave-config
+
+HEADERS += \
+    slave-config/config_tina.h \
+    slave-config/tina/feldbus/slave/feldbus_config_check.h
+
+SOURCES += \
+    feldbus_slave_stellantriebe_benchmark.cpp \
+    ../tina++/feldbus/device/feldbus_slave_base.cpp \
+    ../tina++/feldbus/device/feldbus_slave_stellantriebe.cpp
+
+TINA += debug base64 crc feldbus-host
+
+include(../tina.pri)
+include(../platform/desktop/tina-desktop.pri)
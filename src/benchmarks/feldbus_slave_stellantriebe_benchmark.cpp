@@ -0,0 +1,142 @@
+// Measures how long the Stellantriebe slave implementation needs to process
+// typical packets. The slave code runs unchanged on the desktop, only the
+// driver is replaced by the desktop one which has no interface.
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include <tina++/crc.h>
+#include <tina++/feldbus/device/feldbus_slave_stellantriebe.h>
+
+using namespace TURAG::Feldbus::Slave;
+
+namespace {
+
+constexpr unsigned iterations = 200000;
+constexpr unsigned runs = 10;
+
+int8_t mode = 1;
+int16_t current_angle = 1234;
+int16_t desired_angle = -200;
+int32_t position = 100000;
+int32_t ticks = 42;
+float gain_p = 1.5f;
+float gain_i = 0.25f;
+float gain_d = 0.0f;
+float current = 0.8f;
+float voltage = 12.1f;
+struct {
+    int16_t x;
+    int16_t y;
+    float velocity;
+} state = { 10, 20, 0.5f };
+
+const Stellantriebe::Command commands[] = {
+    { "currentAngle", &current_angle, 0.01f },
+    { "desiredAngle", &desired_angle, 0.01f, Stellantriebe::Access::WRITE },
+    { "mode", &mode, Stellantriebe::Access::WRITE },
+    { "position", &position, 0.001f },
+    { "ticks", &ticks },
+    { "gainP", &gain_p, 1.0f, Stellantriebe::Access::WRITE },
+    { "gainI", &gain_i, 1.0f, Stellantriebe::Access::WRITE },
+    { "gainD", &gain_d, 1.0f, Stellantriebe::Access::WRITE },
+    { "current", &current },
+    { "voltage", &voltage },
+    { "Zustand" },
+    { "x", &state.x, 0.001f },
+    { "y", &state.y, 0.001f },
+    { "velocity", &state.velocity },
+};
+
+struct Packet {
+    uint8_t data[TURAG_FELDBUS_SLAVE_CONFIG_BUFFER_SIZE];
+    FeldbusSize_t length;
+};
+
+Packet makePacket(std::initializer_list<uint8_t> payload) {
+    Packet packet;
+    FeldbusSize_t length = 0;
+#if TURAG_FELDBUS_SLAVE_CONFIG_ADDRESS_LENGTH == 1
+    packet.data[length++] = MY_ADDR;
+#else
+    packet.data[length++] = MY_ADDR & 0xff;
+    packet.data[length++] = MY_ADDR >> 8;
+#endif
+    for (uint8_t byte : payload) {
+        packet.data[length++] = byte;
+    }
+#if (TURAG_FELDBUS_SLAVE_CONFIG_CRC_TYPE == TURAG_FELDBUS_CHECKSUM_XOR)
+    packet.data[length] = TURAG::XOR::calculate(packet.data, length);
+#elif (TURAG_FELDBUS_SLAVE_CONFIG_CRC_TYPE == TURAG_FELDBUS_CHECKSUM_CRC8_ICODE)
+    packet.data[length] = TURAG::CRC8::calculate(packet.data, length);
+#endif
+    packet.length = length + 1;
+    return packet;
+}
+
+uint8_t response[TURAG_FELDBUS_SLAVE_CONFIG_BUFFER_SIZE];
+
+// best of several runs, to filter out the noise of a desktop system
+template<typename F>
+double nanosecondsPerCall(F function) {
+    double best = 0.0;
+    for (unsigned run = 0; run < runs; ++run) {
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned i = 0; i < iterations; ++i) {
+            function();
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        double ns = std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+        if (run == 0 || ns < best) {
+            best = ns;
+        }
+    }
+    return best;
+}
+
+void measure(const char* name, const Packet& packet) {
+    // whole packet including checksum and address handling
+    volatile FeldbusSize_t length = 0;
+    double total = nanosecondsPerCall([&] {
+        length = Base::processPacket(packet.data, packet.length, response);
+    });
+
+    // protocol part only
+    const uint8_t* message = packet.data + TURAG_FELDBUS_SLAVE_CONFIG_ADDRESS_LENGTH;
+    const FeldbusSize_t message_length = packet.length - TURAG_FELDBUS_SLAVE_CONFIG_ADDRESS_LENGTH - 1;
+    double dispatch = nanosecondsPerCall([&] {
+        Stellantriebe::process_feldbus_packet(message, message_length,
+                                              response + TURAG_FELDBUS_SLAVE_CONFIG_ADDRESS_LENGTH);
+    });
+
+    std::printf("%-20s %8.1f ns/packet %8.1f ns/dispatch  (%u bytes response)\n",
+                name, total, dispatch, unsigned(length));
+}
+
+} // namespace
+
+int main() {
+    Stellantriebe::init(commands);
+
+    // x, y and velocity lie next to each other in memory
+    Packet table = makePacket({ TURAG_FELDBUS_STELLANTRIEBE_STRUCTURED_OUTPUT_CONTROL,
+                                TURAG_FELDBUS_STELLANTRIEBE_STRUCTURED_OUTPUT_SET_STRUCTURE,
+                                12, 13, 14, 1, 4, 9, 10, 6 });
+    Base::processPacket(table.data, table.length, response);
+
+    measure("read short", makePacket({ 1 }));
+    measure("read float", makePacket({ 9 }));
+    measure("write short", makePacket({ 2, 0x10, 0x27 }));
+    measure("write float", makePacket({ 6, 0x00, 0x00, 0x80, 0x3f }));
+    measure("command info", makePacket({ 5, TURAG_FELDBUS_STELLANTRIEBE_COMMAND_INFO_GET,
+                                         TURAG_FELDBUS_STELLANTRIEBE_COMMAND_INFO_GET,
+                                         TURAG_FELDBUS_STELLANTRIEBE_COMMAND_INFO_GET }));
+    measure("structured output", makePacket({ TURAG_FELDBUS_STELLANTRIEBE_STRUCTURED_OUTPUT_GET }));
+    measure("multi access", makePacket({ TURAG_FELDBUS_STELLANTRIEBE_MULTI_ACCESS, 2,
+                                         2, 0x10, 0x27,
+                                         3, 2,
+                                         1, 4, 9, 10 }));
+    return 0;
+}
@@ -0,0 +1,12 @@
+#ifndef BENCHMARKS_SLAVE_CONFIG_CONFIG_TINA_H
+#define BENCHMARKS_SLAVE_CONFIG_CONFIG_TINA_H
+
+// TinA configuration of the Feldbus slave benchmark
+
+#define TURAG_CRC_CRC8_ALGORITHM                1
+#define TURAG_CRC_INLINED_CALCULATION           1
+#define TURAG_USE_TURAG_FELDBUS_SLAVE           1
+// tina.pri always builds some of the host sources
+#define TURAG_USE_TURAG_FELDBUS_HOST            1
+
+#endif // BENCHMARKS_SLAVE_CONFIG_CONFIG_TINA_H
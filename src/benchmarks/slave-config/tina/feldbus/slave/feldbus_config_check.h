@@ -0,0 +1,48 @@
+#ifndef BENCHMARKS_SLAVE_CONFIG_FELDBUS_CONFIG_CHECK_H
+#define BENCHMARKS_SLAVE_CONFIG_FELDBUS_CONFIG_CHECK_H
+
+// Slave configuration of the Feldbus slave benchmark. On a device this
+// header is provided by the firmware project, which defines its slave
+// configuration and the types and constants derived from it here.
+
+#include <tina/tina.h>
+#include <tina/feldbus/protocol/turag_feldbus_bus_protokoll.h>
+#include <tina/feldbus/protocol/turag_feldbus_fuer_stellantriebe.h>
+
+
+#define MY_ADDR                                                     0x01
+
+#define TURAG_FELDBUS_DEVICE_PROTOCOL                               TURAG_FELDBUS_DEVICE_PROTOCOL_STELLANTRIEBE
+#define TURAG_FELDBUS_DEVICE_TYPE_ID                                TURAG_FELDBUS_STELLANTRIEBE_DEVICE_TYPE_SERVO
+#define TURAG_FELDBUS_DEVICE_NAME                                   "benchmark"
+#define TURAG_FELDBUS_DEVICE_VERSIONINFO                            "desktop"
+
+#define TURAG_FELDBUS_SLAVE_CONFIG_ADDRESS_LENGTH                   1
+#define TURAG_FELDBUS_SLAVE_CONFIG_CRC_TYPE                         TURAG_FELDBUS_CHECKSUM_XOR
+#define TURAG_FELDBUS_SLAVE_CONFIG_BUFFER_SIZE                      64
+#define TURAG_FELDBUS_SLAVE_BROADCASTS_AVAILABLE                    1
+#define TURAG_FELDBUS_SLAVE_CONFIG_PACKAGE_STATISTICS_AVAILABLE     0
+#define TURAG_FELDBUS_SLAVE_CONFIG_FLASH_LED                        0
+#define TURAG_FELDBUS_SLAVE_CONFIG_DEBUG_ENABLED                    0
+#define TURAG_FELDBUS_SLAVE_DISABLE_BOARD_RESET_BROADCAST           1
+#define TURAG_FELDBUS_STELLANTRIEBE_STRUCTURED_OUTPUT_BUFFER_SIZE   16
+
+
+// the buffer is smaller than 256 bytes
+typedef uint8_t FeldbusSize_t;
+
+// added to address length and checksum this yields a response length of 0
+#define TURAG_FELDBUS_IGNORE_PACKAGE \
+    static_cast<FeldbusSize_t>(-(TURAG_FELDBUS_SLAVE_CONFIG_ADDRESS_LENGTH + 1))
+
+#define TURAG_FELDBUS_SLAVE_COMMAND_DEVICE_NAME                     TURAG_FELDBUS_DEVICE_COMMAND_DEVICE_NAME
+#define TURAG_FELDBUS_SLAVE_COMMAND_UPTIME_COUNTER                  TURAG_FELDBUS_DEVICE_COMMAND_UPTIME_COUNTER
+#define TURAG_FELDBUS_SLAVE_COMMAND_VERSIONINFO                     TURAG_FELDBUS_DEVICE_COMMAND_VERSIONINFO
+#define TURAG_FELDBUS_SLAVE_COMMAND_PACKAGE_COUNT_CORRECT           TURAG_FELDBUS_DEVICE_COMMAND_PACKAGE_COUNT_CORRECT
+#define TURAG_FELDBUS_SLAVE_COMMAND_PACKAGE_COUNT_BUFFEROVERFLOW    TURAG_FELDBUS_DEVICE_COMMAND_PACKAGE_COUNT_BUFFEROVERFLOW
+#define TURAG_FELDBUS_SLAVE_COMMAND_PACKAGE_COUNT_LOST              TURAG_FELDBUS_DEVICE_COMMAND_PACKAGE_COUNT_LOST
+#define TURAG_FELDBUS_SLAVE_COMMAND_PACKAGE_COUNT_CHKSUM_MISMATCH   TURAG_FELDBUS_DEVICE_COMMAND_PACKAGE_COUNT_CHKSUM_MISMATCH
+#define TURAG_FELDBUS_SLAVE_COMMAND_PACKAGE_COUNT_ALL               TURAG_FELDBUS_DEVICE_COMMAND_PACKAGE_COUNT_ALL
+#define TURAG_FELDBUS_SLAVE_COMMAND_RESET_PACKAGE_COUNT             TURAG_FELDBUS_DEVICE_COMMAND_RESET_PACKAGE_COUNT
+
+#endif // BENCHMARKS_SLAVE_CONFIG_FELDBUS_CONFIG_CHECK_H
@@ -123,7 +123,7 @@ bool FeldbusDriver::doTransceive(const uint8_t *transmit, int *transmit_length,
 	}
 
     if (receive && receive_length && *receive_length) {
-        msg_t rx_res = uartReceiveTimeout(uart_driver_, (size_t*)receive_length, receive, rs485_timeout_.value);
+        msg_t rx_res = uartReceiveTimeout(uart_driver_, (size_t*)receive_length, receive, responseTimeout(rs485_timeout_).toTicks());
         recv_ok = (rx_res == MSG_OK);
         if (!recv_ok)
             turag_debugf("%s: UART receive failed for reason %s", name(), msg_to_str(rx_res));
@@ -143,6 +143,22 @@ bool FeldbusDriver::doTransceive(const uint8_t *transmit, int *transmit_length,
 	return (send_ok && recv_ok);
 }
 
+bool FeldbusDriver::doSetBaudRate(unsigned baudRate)
+{
+	if (!uart_driver_ || baudRate == 0) {
+		return false;
+	}
+
+	// the bus is locked, so there is no transmission running
+	uartStop(uart_driver_);
+	uart_config_.speed = baudRate;
+	uartStart(uart_driver_, &uart_config_);
+
+	bus_delay_ = (16 * 1000000 - 1) / baudRate + 1;
+
+	return (uart_driver_->state == UART_READY);
+}
+
 void FeldbusDriver::clearBuffer()
 {
 	while (!isReady()) {
@@ -41,6 +41,7 @@ Driver::Data Driver::data = {
     {0}, {0},
     0,
     false,
+    0,
 };
 
 
@@ -52,7 +53,6 @@ void Driver::init(const HardwareConfig* config_) {
     memset(&uart_config, 0, sizeof(UARTConfig));
     memset(&gpt_config, 0, sizeof(GPTConfig));
 
-    uart_config.speed = config->baudrate;
     uart_config.txend2_cb = txComplete;
     uart_config.rxerr_cb = rxErr;
 
@@ -61,7 +61,6 @@ void Driver::init(const HardwareConfig* config_) {
         uart_config.rxchar_cb = rxChar;
         gpt_config.callback = rxTimeoutSoftware;
         gpt_config.frequency = config->rto_config->gpt_frequency;
-        data.timerTicks = (gpt_config.frequency * 15 + config->baudrate / 2) / config->baudrate;
     } else {
         //hardware receive timeout
         uart_config.timeout_cb = rxTimeoutHardware;
@@ -75,6 +74,7 @@ void Driver::init(const HardwareConfig* config_) {
         if(config->rts_inverted)
             uart_config.cr3 |= USART_CR3_DEP;
     }
+    applyBaudRate(config->baudrate);
 
 #if TURAG_FELDBUS_SLAVE_CONFIG_ADDRESS_LENGTH == 1
     data.txbuf[0] = TURAG_FELDBUS_MASTER_ADDR|MY_ADDR;
@@ -117,6 +117,38 @@ void blinkCallback (virtual_timer_t*, void *t) {
     chSysUnlockFromISR();
 }
 
+void Driver::applyBaudRate(uint32_t baudrate) {
+    data.baudrate = baudrate;
+    uart_config.speed = baudrate;
+    if(config->rto_config) {
+        data.timerTicks = (gpt_config.frequency * 15 + baudrate / 2) / baudrate;
+    }
+}
+
+bool Driver::setBaudRate(uint32_t baudrate) {
+    if (baudrate == 0 || (baudrate != config->baudrate && baudrate > TURAG_FELDBUS_SLAVE_CONFIG_MAX_BAUD_RATE)) {
+        return false;
+    }
+    if (baudrate == data.baudrate) {
+        return true;
+    }
+    // We are called by the worker thread between two packets, so nothing
+    // is sent right now and an incomplete packet would be garbage anyway.
+    uartStop(config->uartd);
+    applyBaudRate(baudrate);
+    uartStart(config->uartd, &uart_config);
+    return true;
+}
+
+// Answers to sync reads are sent in the time slot assigned by the master.
+void Driver::waitForResponseSlot(void) {
+    unsigned frames = Base::responseDelayFrames();
+    if (frames > 0) {
+        // 10 bits per frame
+        chThdSleepMicroseconds(frames * 10000000ULL / data.baudrate);
+    }
+}
+
 void Driver::thread_func() {
     chRegSetThreadName("feldbus slave driver");
 
@@ -137,6 +169,7 @@ void Driver::thread_func() {
             FeldbusSize_t length = Base::processPacket(data.rxbuf, data.rx_size, data.txbuf);
             if (length > 0) {
                 size_t l = length;
+                waitForResponseSlot();
                 enableRts();
                 uartSendFullTimeout(config->uartd, &l, data.txbuf, TIME_INFINITE);
                 disableRts();
@@ -187,6 +220,7 @@ void Driver::thread_func() {
 #if TURAG_FELDBUS_SLAVE_CONFIG_DEBUG_ENABLED
                 chBSemWait(&tx_sem);
 #endif
+                waitForResponseSlot();
                 enableRts();
                 uartStartSend(config->uartd, length, data.txbuf);
             }
@@ -33,8 +33,11 @@ public:
 
 	virtual void clearBuffer(void);
 
+	virtual unsigned baudRate(void) const { return uart_config_.speed; }
+
 private:
 	virtual bool doTransceive(const uint8_t *transmit, int *transmit_length, uint8_t *receive, int *receive_length, bool delay_transmission);
+	virtual bool doSetBaudRate(unsigned baudRate);
 
     ioline_t rts_;
 
@@ -78,6 +78,17 @@ public:
      */
     static void start(ThreadImpl* thread, int prio);
 
+    /**
+     * @brief Stellt die Baudrate um.
+     * @param[in] baudrate Neue Baudrate.
+     * @return False, wenn die Baudrate weder die Standard-Baudrate aus der
+     * Hardware-Konfiguration ist noch höchstens \ref TURAG_FELDBUS_SLAVE_CONFIG_MAX_BAUD_RATE beträgt.
+     * 
+     * Wird von Slave::Base im Arbeitsthread zwischen zwei Paketen aufgerufen.
+     * Nach einem Reset gilt wieder die Standard-Baudrate.
+     */
+    static bool setBaudRate(uint32_t baudrate);
+
     /**
      * @brief Resettet den Mikrocontroller
      * 
@@ -118,6 +129,7 @@ private:
 
         uint32_t timerTicks;
         bool overflow;
+        uint32_t baudrate;
     };
 
     static void enableRts(void) {
@@ -139,6 +151,9 @@ private:
             palClearLine(config->rts);
         }
     }    
+
+    static void waitForResponseSlot(void);
+    static void applyBaudRate(uint32_t baudrate);
     
     static bool packetAdressedToMe(void) {
     #if TURAG_FELDBUS_SLAVE_CONFIG_ADDRESS_LENGTH == 1
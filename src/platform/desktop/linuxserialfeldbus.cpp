@@ -0,0 +1,324 @@
+#define TURAG_DEBUG_LOG_SOURCE "B"
+
+#include <tina++/tina.h>
+
+#if TURAG_USE_TURAG_FELDBUS_HOST && defined(__linux__)
+
+#include <tina++/feldbus/host/linuxserialfeldbus.h>
+#include <tina/debug/print.h>
+
+#include <cerrno>
+#include <cstring>
+#include <thread>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <linux/serial.h>
+
+namespace TURAG {
+namespace Feldbus {
+
+namespace {
+
+speed_t toSpeed(unsigned baudRate) {
+    switch (baudRate) {
+    case 1200: return B1200;
+    case 2400: return B2400;
+    case 4800: return B4800;
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    case 460800: return B460800;
+    case 500000: return B500000;
+    case 576000: return B576000;
+    case 921600: return B921600;
+    case 1000000: return B1000000;
+    case 1152000: return B1152000;
+    case 1500000: return B1500000;
+    case 2000000: return B2000000;
+    case 2500000: return B2500000;
+    case 3000000: return B3000000;
+    case 3500000: return B3500000;
+    case 4000000: return B4000000;
+    default: return B0;
+    }
+}
+
+// waits for the given events on fd, returns false on timeout or error
+bool waitFor(int fd, short events, std::chrono::steady_clock::time_point deadline) {
+    while (true) {
+        const auto remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    deadline - std::chrono::steady_clock::now());
+        if (remaining.count() <= 0) {
+            return false;
+        }
+
+        // ppoll instead of poll, a timeout in milliseconds is much too coarse
+        timespec timeout;
+        timeout.tv_sec = remaining.count() / 1000000000;
+        timeout.tv_nsec = remaining.count() % 1000000000;
+        pollfd pfd = { fd, events, 0 };
+        int result = ::ppoll(&pfd, 1, &timeout, nullptr);
+        if (result > 0) {
+            return true;
+        }
+        if (result < 0 && errno != EINTR) {
+            return false;
+        }
+    }
+}
+
+} // namespace
+
+LinuxSerialFeldbus::LinuxSerialFeldbus(const char* name, bool threadSafe) :
+    FeldbusAbstraction(name, threadSafe),
+    fd_(-1),
+    baudRate_(0),
+    options_(none),
+    responseDelayUs_(2000),
+    busFreeAt_(Clock::now())
+{ }
+
+LinuxSerialFeldbus::~LinuxSerialFeldbus()
+{
+    close();
+}
+
+bool LinuxSerialFeldbus::open(const char* device, unsigned baudRate, unsigned options)
+{
+    close();
+
+    const speed_t speed = toSpeed(baudRate);
+    if (speed == B0) {
+        turag_errorf("%s: unsupported baud rate %u", name(), baudRate);
+        return false;
+    }
+
+    fd_ = ::open(device, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (fd_ < 0) {
+        turag_errorf("%s: can't open %s: %s", name(), device, std::strerror(errno));
+        return false;
+    }
+
+    termios tio;
+    if (::tcgetattr(fd_, &tio) != 0) {
+        turag_errorf("%s: %s is no serial port: %s", name(), device, std::strerror(errno));
+        close();
+        return false;
+    }
+    ::cfmakeraw(&tio);
+    tio.c_cflag &= ~(CSTOPB | PARENB | CRTSCTS);
+    tio.c_cflag |= CS8 | CLOCAL | CREAD;
+    tio.c_iflag &= ~(IXON | IXOFF | IXANY);
+    // we never block in read(), the timeouts are handled with ppoll()
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    ::cfsetispeed(&tio, speed);
+    ::cfsetospeed(&tio, speed);
+    if (::tcsetattr(fd_, TCSANOW, &tio) != 0) {
+        turag_errorf("%s: can't configure %s: %s", name(), device, std::strerror(errno));
+        close();
+        return false;
+    }
+    baudRate_ = baudRate;
+    options_ = options;
+
+    // USB adapters otherwise collect received bytes for several milliseconds
+    serial_struct serial;
+    if (::ioctl(fd_, TIOCGSERIAL, &serial) == 0) {
+        serial.flags |= ASYNC_LOW_LATENCY;
+        if (::ioctl(fd_, TIOCSSERIAL, &serial) != 0) {
+            turag_warningf("%s: can't enable low latency mode: %s", name(), std::strerror(errno));
+        }
+    } else {
+        turag_warningf("%s: low latency mode not supported by %s", name(), device);
+    }
+
+    if (options & rs485) {
+        serial_rs485 rs485conf;
+        std::memset(&rs485conf, 0, sizeof(rs485conf));
+        rs485conf.flags = SER_RS485_ENABLED;
+        if ((options & rs485InvertedRts) == rs485InvertedRts) {
+            rs485conf.flags |= SER_RS485_RTS_AFTER_SEND;
+        } else {
+            rs485conf.flags |= SER_RS485_RTS_ON_SEND;
+        }
+        if (::ioctl(fd_, TIOCSRS485, &rs485conf) != 0) {
+            turag_warningf("%s: kernel RS485 mode not supported by %s: %s", name(), device, std::strerror(errno));
+        }
+    }
+
+    ::tcflush(fd_, TCIOFLUSH);
+    busFreeAt_ = Clock::now();
+    return true;
+}
+
+void LinuxSerialFeldbus::close(void)
+{
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+bool LinuxSerialFeldbus::doSetBaudRate(unsigned baudRate)
+{
+    const speed_t speed = toSpeed(baudRate);
+    if (speed == B0) {
+        turag_errorf("%s: unsupported baud rate %u", name(), baudRate);
+        return false;
+    }
+    if (fd_ >= 0) {
+        termios tio;
+        if (::tcgetattr(fd_, &tio) != 0) {
+            return false;
+        }
+        ::cfsetispeed(&tio, speed);
+        ::cfsetospeed(&tio, speed);
+        // let a running transmission finish with the old baud rate
+        if (::tcsetattr(fd_, TCSADRAIN, &tio) != 0) {
+            turag_errorf("%s: can't set baud rate %u: %s", name(), baudRate, std::strerror(errno));
+            return false;
+        }
+    }
+    baudRate_ = baudRate;
+    return true;
+}
+
+void LinuxSerialFeldbus::clearBuffer(void)
+{
+    if (fd_ >= 0) {
+        ::tcflush(fd_, TCIOFLUSH);
+    }
+}
+
+std::chrono::microseconds LinuxSerialFeldbus::wireTime(int bytes) const
+{
+    // 8N1: 10 bits per byte, rounded up
+    return std::chrono::microseconds((bytes * 10000000ULL + baudRate_ - 1) / baudRate_);
+}
+
+bool LinuxSerialFeldbus::writeAll(const uint8_t* data, int* length, Clock::time_point deadline)
+{
+    int written = 0;
+    while (written < *length) {
+        ssize_t n = ::write(fd_, data + written, *length - written);
+        if (n > 0) {
+            written += n;
+        } else if (n < 0 && errno != EAGAIN && errno != EINTR) {
+            turag_errorf("%s: write error: %s", name(), std::strerror(errno));
+            break;
+        } else if (!waitFor(fd_, POLLOUT, deadline)) {
+            turag_errorf("%s: write timeout", name());
+            break;
+        }
+    }
+    const bool success = written == *length;
+    *length = written;
+    return success;
+}
+
+int LinuxSerialFeldbus::readUntil(uint8_t* data, int length, Clock::time_point deadline, bool accumulate)
+{
+    int received = 0;
+    while (received < length) {
+        ssize_t n = ::read(fd_, data + received, length - received);
+        if (n > 0) {
+            if (accumulate) {
+                // the checksum is calculated while waiting for the rest of the response
+                accumulateReceived(data + received, n);
+            }
+            received += n;
+        } else if (n < 0 && errno != EAGAIN && errno != EINTR) {
+            turag_errorf("%s: read error: %s", name(), std::strerror(errno));
+            break;
+        } else if (!waitFor(fd_, POLLIN, deadline)) {
+            break;
+        }
+    }
+    return received;
+}
+
+bool LinuxSerialFeldbus::doTransceive(const uint8_t* transmit, int* transmit_length, uint8_t* receive, int* receive_length, bool delayTransmission)
+{
+    const int toSend = transmit && transmit_length ? *transmit_length : 0;
+    const int wanted = receive && receive_length ? *receive_length : 0;
+
+    if (fd_ < 0) {
+        turag_errorf("%s: serial port not open", name());
+        if (transmit_length) {
+            *transmit_length = 0;
+        }
+        if (receive_length) {
+            *receive_length = 0;
+        }
+        return false;
+    }
+
+    // Only wait for the part of the bus delay of 1.5 frames that did not
+    // already pass since the end of the last transmission.
+    if (delayTransmission) {
+        std::this_thread::sleep_until(busFreeAt_ + std::chrono::microseconds(15000000ULL / baudRate_));
+    }
+
+    // The slaves may take this long to start their response. Only a timeout
+    // of the caller goes through the system ticks, which would cut the
+    // default off below one tick.
+    const SystemTime callerTimeout = responseTimeout(SystemTime::infinite());
+    const std::chrono::microseconds responseDelay(callerTimeout == SystemTime::infinite() ? responseDelayUs_ : callerTimeout.toUsec());
+
+    const Clock::time_point start = Clock::now();
+    const Clock::time_point transmitEnd = start + wireTime(toSend);
+    if (toSend > 0) {
+        // write() returns as soon as the packet is in the kernel buffer
+        if (!writeAll(transmit, transmit_length, transmitEnd + responseDelay)) {
+            busFreeAt_ = Clock::now();
+            if (receive_length) {
+                *receive_length = 0;
+            }
+            return false;
+        }
+
+        if (options_ & localEcho) {
+            uint8_t echo[64];
+            int remaining = toSend;
+            while (remaining > 0) {
+                const int chunk = remaining < static_cast<int>(sizeof(echo)) ? remaining : static_cast<int>(sizeof(echo));
+                if (readUntil(echo, chunk, transmitEnd + responseDelay) != chunk) {
+                    turag_errorf("%s: local echo missing", name());
+                    busFreeAt_ = Clock::now();
+                    if (receive_length) {
+                        *receive_length = 0;
+                    }
+                    return false;
+                }
+                remaining -= chunk;
+            }
+        }
+    }
+
+    if (wanted == 0) {
+        busFreeAt_ = transmitEnd;
+        if (receive_length) {
+            *receive_length = 0;
+        }
+        return true;
+    }
+
+    const int received = readUntil(receive, wanted, transmitEnd + responseDelay + wireTime(wanted), true);
+    *receive_length = received;
+    busFreeAt_ = Clock::now();
+
+    return received == wanted;
+}
+
+} // namespace Feldbus
+} // namespace TURAG
+
+#endif // TURAG_USE_TURAG_FELDBUS_HOST && __linux__
@@ -0,0 +1,119 @@
+#ifndef PLATFORM_DESKTOP_PUBLIC_TINAPP_FELDBUS_HOST_LINUXSERIALFELDBUS_H
+#define PLATFORM_DESKTOP_PUBLIC_TINAPP_FELDBUS_HOST_LINUXSERIALFELDBUS_H
+
+#include <tina++/tina.h>
+#include <tina++/feldbus/host/feldbusabstraction.h>
+
+#include <chrono>
+
+namespace TURAG {
+namespace Feldbus {
+
+/**
+ * \brief %TURAG-Feldbus an einer seriellen Schnittstelle unter Linux.
+ *
+ * Im Gegensatz zum SerialFieldbus der ROS-Plattform kommt diese Implementierung
+ * ohne boost::asio und ROS aus und benutzt direkt termios und poll():
+ * - Der Port wird im Raw-Modus mit 8N1 und ohne Flusskontrolle betrieben.
+ * - Ist verfügbar, wird \c ASYNC_LOW_LATENCY gesetzt, damit USB-Adapter
+ *   empfangene Bytes sofort und nicht erst nach einigen Millisekunden weitergeben.
+ * - Auf Wunsch schaltet der Kernel die Senderichtung des RS485-Transceivers
+ *   (\c TIOCSRS485), sodass keine Zeit durch Umschalten im Userspace verloren geht.
+ * - Der Timeout einer Übertragung ergibt sich aus der Baudrate, der Länge von
+ *   Anfrage und erwarteter Antwort und der maximalen Antwortverzögerung der Slaves.
+ * - Das Paket-Delay von 1,5 Frames wird nur so weit abgewartet, wie es seit der
+ *   letzten Übertragung noch nicht verstrichen ist.
+ *
+ * Da nur ein Dateideskriptor benutzt wird, kann statt einer echten Schnittstelle
+ * auch eine Seite eines Pseudoterminal-Paares geöffnet werden, an dessen anderer
+ * Seite z.B. eine Slave-Simulation hängt:
+ * \code
+ * LinuxSerialFeldbus bus("rs485");
+ * if (!bus.open("/dev/ttyUSB0", 115200, LinuxSerialFeldbus::rs485)) {
+ *     ...
+ * }
+ * \endcode
+ *
+ * \note Nur unter Linux verfügbar.
+ */
+class LinuxSerialFeldbus : public FeldbusAbstraction
+{
+public:
+    /// Optionen für open().
+    enum Options : unsigned {
+        /// Keine besonderen Optionen.
+        none = 0,
+        /// Senderichtung des RS485-Transceivers vom Kernel über RTS schalten lassen.
+        rs485 = 0x01,
+        /// Wie rs485, aber mit invertiertem RTS-Signal.
+        rs485InvertedRts = 0x03,
+        /// Eigene gesendete Bytes werden empfangen und müssen verworfen werden.
+        localEcho = 0x04
+    };
+
+    /**
+     * \brief Konstruktor.
+     * \param name Name des Busses.
+     * \param threadSafe Siehe FeldbusAbstraction.
+     */
+    explicit LinuxSerialFeldbus(const char* name, bool threadSafe = true);
+    ~LinuxSerialFeldbus();
+
+    LinuxSerialFeldbus(const LinuxSerialFeldbus&) = delete;
+    LinuxSerialFeldbus& operator=(const LinuxSerialFeldbus&) = delete;
+
+    /**
+     * \brief Öffnet die serielle Schnittstelle.
+     * \param device Pfad der Schnittstelle, z.B. /dev/ttyUSB0.
+     * \param baudRate Baudrate.
+     * \param options Kombination von Options.
+     * \return False, wenn die Schnittstelle nicht geöffnet oder konfiguriert werden konnte.
+     *
+     * Können Low-Latency-Modus oder RS485-Modus nicht gesetzt werden (z.B. bei
+     * Pseudoterminals), wird nur eine Warnung ausgegeben.
+     */
+    bool open(const char* device, unsigned baudRate, unsigned options = none);
+
+    /// Schließt die Schnittstelle.
+    void close(void);
+
+    /// Gibt zurück, ob die Schnittstelle geöffnet ist.
+    bool isOpen(void) const { return fd_ >= 0; }
+
+    /// Aktuelle Baudrate.
+    unsigned baudRate(void) const override { return baudRate_; }
+
+    /**
+     * \brief Stellt die maximale Antwortverzögerung der Slaves ein.
+     *
+     * Zusammen mit der Übertragungsdauer der Anfrage und der erwarteten Antwort
+     * ergibt sie den Timeout einer Übertragung, sofern beim Aufruf von
+     * FeldbusAbstraction::transceive() kein eigener Wert angegeben wurde.
+     * Standardwert ist 2 ms.
+     */
+    void setResponseDelay(SystemTime delay) { responseDelayUs_ = delay.toUsec(); }
+
+    void clearBuffer(void) override;
+
+protected:
+    bool doTransceive(const uint8_t* transmit, int* transmit_length, uint8_t* receive, int* receive_length, bool delayTransmission) override;
+    bool doSetBaudRate(unsigned baudRate) override;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    std::chrono::microseconds wireTime(int bytes) const;
+    bool writeAll(const uint8_t* data, int* length, Clock::time_point deadline);
+    int readUntil(uint8_t* data, int length, Clock::time_point deadline, bool accumulate = false);
+
+    int fd_;
+    unsigned baudRate_;
+    unsigned options_;
+    unsigned responseDelayUs_;
+    Clock::time_point busFreeAt_;
+};
+
+} // namespace Feldbus
+} // namespace TURAG
+
+#endif // PLATFORM_DESKTOP_PUBLIC_TINAPP_FELDBUS_HOST_LINUXSERIALFELDBUS_H
@@ -0,0 +1,227 @@
+#ifndef PLATFORM_DESKTOP_PUBLIC_TINAPP_FELDBUS_HOST_VIRTUALFELDBUS_H
+#define PLATFORM_DESKTOP_PUBLIC_TINAPP_FELDBUS_HOST_VIRTUALFELDBUS_H
+
+#include <tina++/tina.h>
+#include <tina++/feldbus/host/feldbusabstraction.h>
+
+#include <array>
+#include <chrono>
+#include <random>
+#include <vector>
+
+namespace TURAG {
+namespace Feldbus {
+
+/**
+ * \brief Simulierter %TURAG-Feldbus, der Pakete an Slave-Implementierungen im
+ * selben Prozess weiterleitet.
+ *
+ * Damit lassen sich Host-Klassen wie Device, ASEBBase, Bootloader oder DeviceLocator
+ * ohne RS485-Hardware testen und profilieren. Simuliert werden:
+ * - die Übertragungsdauer der Bytes bei der eingestellten Baudrate (8N1),
+ * - das Paket-Delay von 1,5 Frames zwischen Übertragungen an verschiedene Geräte,
+ * - die Antwortverzögerung der Slaves,
+ * - Antworten mehrerer Slaves auf einen Broadcast in ihren Zeitschlitzen
+ *   (siehe \ref TURAG_FELDBUS_DEVICE_BROADCAST_SYNC_READ) oder als Kollision,
+ * - der Timeout, wenn kein Slave antwortet,
+ * - verlorene und verfälschte Pakete mit einstellbarer Wahrscheinlichkeit.
+ *
+ * Mit setTimeScale() kann die Simulation gegenüber der Echtzeit beschleunigt werden.
+ * Alle Zeiten werden mit der hochauflösenden Uhr des Systems eingehalten.
+ *
+ * Slaves werden als Instanzen von VirtualFeldbus::Slave registriert. Statische
+ * Paketverarbeitungsfunktionen wie Slave::Base::processPacket() (und damit auch
+ * Stellantriebe::process_feldbus_packet() nach dem Aufruf von Stellantriebe::init())
+ * können mit PacketProcessorSlave eingebunden werden:
+ * \code
+ * VirtualFeldbus bus("virtual", 115200);
+ * Slave::Stellantriebe::init(commands, names, commandCount);
+ * VirtualFeldbus::PacketProcessorSlave<FeldbusSize_t> motor(&Slave::Base::processPacket);
+ * bus.addSlave(MY_ADDR, &motor);
+ * \endcode
+ *
+ * \note Da die Slave-Implementierung statisch ist, kann pro Programm nur ein
+ * Slave auf Basis von Slave::Base existieren. Weitere Geräte lassen sich durch
+ * eigene Subklassen von VirtualFeldbus::Slave nachbilden.
+ */
+class VirtualFeldbus : public FeldbusAbstraction
+{
+public:
+    /**
+     * \brief Schnittstelle eines simulierten Slaves.
+     */
+    class Slave {
+    public:
+        virtual ~Slave() {}
+
+        /**
+         * \brief Verarbeitet ein Paket.
+         * \param[in] message Paket inklusive Adresse und Checksumme.
+         * \param[in] length Länge des Pakets.
+         * \param[out] response Puffer für die Antwort, in dem die Adresse bereits
+         * eingetragen ist.
+         * \return Länge der Antwort inklusive Adresse und Checksumme. Bei 0 wird
+         * nicht geantwortet.
+         *
+         * Entspricht der Schnittstelle von Slave::Base::processPacket(). Broadcasts
+         * werden an alle Slaves weitergeleitet.
+         */
+        virtual int processPacket(const uint8_t* message, int length, uint8_t* response) = 0;
+
+        /**
+         * \brief Verzögerung der Antwort auf das zuletzt verarbeitete Paket.
+         * \return Verzögerung in Byte-Zeiten, siehe Slave::Base::responseDelayFrames().
+         *
+         * Antworten mehrere Slaves auf einen Broadcast, überlagern sie sich nur,
+         * wenn sich ihre Zeitschlitze überschneiden.
+         */
+        virtual unsigned responseDelayFrames(void) { return 0; }
+
+        /**
+         * \brief Baudrate, mit der der Slave gerade empfängt.
+         * \return Baudrate oder 0, wenn der Slave jede Baudrate versteht.
+         *
+         * Slaves, deren Baudrate nicht mit der des Busses übereinstimmt, bekommen
+         * keine Pakete und antworten nicht. Damit lässt sich die Umstellung mit
+         * \ref TURAG_FELDBUS_DEVICE_BROADCAST_SET_BAUD_RATE nachbilden.
+         */
+        virtual unsigned baudRate(void) { return 0; }
+    };
+
+    /**
+     * \brief Bindet eine statische Paketverarbeitungsfunktion als Slave ein.
+     * \tparam SizeType Längentyp der Funktion, üblicherweise FeldbusSize_t.
+     */
+    template<typename SizeType>
+    class PacketProcessorSlave : public Slave {
+    public:
+        typedef SizeType (*Processor)(const uint8_t* message, SizeType length, uint8_t* response);
+        typedef unsigned (*DelayFunction)(void);
+
+        /**
+         * \brief Konstruktor.
+         * \param processor Paketverarbeitungsfunktion.
+         * \param delay Funktion, die die Antwortverzögerung liefert, z.B.
+         * Slave::Base::responseDelayFrames(), oder nullptr.
+         */
+        explicit PacketProcessorSlave(Processor processor, DelayFunction delay = nullptr) :
+            processor_(processor), delay_(delay)
+        { }
+
+        int processPacket(const uint8_t* message, int length, uint8_t* response) override {
+            return processor_(message, static_cast<SizeType>(length), response);
+        }
+
+        unsigned responseDelayFrames(void) override {
+            return delay_ ? delay_() : 0;
+        }
+
+    private:
+        Processor processor_;
+        DelayFunction delay_;
+    };
+
+    /// Statistiken der Simulation.
+    struct Statistics {
+        /// Anzahl der gesendeten Pakete.
+        unsigned long frames;
+        /// Anzahl der gesendeten Broadcasts.
+        unsigned long broadcasts;
+        /// Anzahl der absichtlich verworfenen Pakete.
+        unsigned long lostFrames;
+        /// Anzahl der absichtlich verfälschten Antworten.
+        unsigned long corruptedFrames;
+        /// Anzahl der Pakete, auf die keine (vollständige) Antwort kam.
+        unsigned long unansweredFrames;
+        /// Simulierte Belegungszeit des Busses in Mikrosekunden (ohne Zeitskalierung).
+        unsigned long long busTimeUs;
+    };
+
+    /**
+     * \brief Konstruktor.
+     * \param name Name des Busses.
+     * \param baudRate Simulierte Baudrate.
+     * \param threadSafe Siehe FeldbusAbstraction.
+     */
+    VirtualFeldbus(const char* name, unsigned baudRate = 115200, bool threadSafe = true);
+
+    /**
+     * \brief Registriert einen Slave.
+     * \param address Busadresse des Slaves.
+     * \param slave Slave, der bis zum Entfernen gültig bleiben muss.
+     * \return False, wenn die Adresse ungültig oder bereits belegt ist.
+     */
+    bool addSlave(unsigned address, Slave* slave);
+
+    /// Entfernt den Slave mit der angegebenen Adresse.
+    void removeSlave(unsigned address);
+
+    /// Simulierte Baudrate.
+    unsigned baudRate(void) const override { return baudRate_; }
+
+    /**
+     * \brief Stellt die Zeitskalierung ein.
+     * \param scale 1 entspricht Echtzeit, 0.1 einer zehnfach beschleunigten
+     * Simulation und 0 einer Simulation ohne Wartezeiten.
+     */
+    void setTimeScale(double scale) { timeScale_ = scale; }
+
+    /// Stellt die Zeit zwischen dem Ende einer Anfrage und dem Beginn der Antwort ein.
+    void setTurnaroundDelay(unsigned microseconds) { turnaroundDelayUs_ = microseconds; }
+
+    /// Stellt ein, wie lange bei einer fehlenden Antwort gewartet wird.
+    void setResponseTimeout(unsigned microseconds) { responseTimeoutUs_ = microseconds; }
+
+    /**
+     * \brief Stellt die Fehlerraten ein.
+     * \param lossProbability Wahrscheinlichkeit, dass ein Paket verloren geht.
+     * \param corruptionProbability Wahrscheinlichkeit, dass in einer Antwort ein Bit kippt.
+     * \param seed Startwert des Zufallsgenerators, um Läufe reproduzierbar zu machen.
+     */
+    void setErrorRates(double lossProbability, double corruptionProbability, unsigned seed = 1);
+
+    /// Statistiken der Simulation.
+    const Statistics& statistics(void) const { return statistics_; }
+
+    /// Setzt die Statistiken zurück.
+    void resetStatistics(void);
+
+    void clearBuffer(void) override { }
+
+protected:
+    bool doTransceive(const uint8_t* transmit, int* transmit_length, uint8_t* receive, int* receive_length, bool delayTransmission) override;
+    bool doSetBaudRate(unsigned baudRate) override;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    bool listens(unsigned address) const {
+        return slaves_[address] && (slaves_[address]->baudRate() == 0 || slaves_[address]->baudRate() == baudRate_);
+    }
+
+    Clock::duration scaled(double microseconds) const;
+    double wireTimeUs(int bytes) const;
+    void sleepUntil(Clock::time_point time) const;
+    bool chance(double probability);
+
+    std::array<Slave*, 128> slaves_;
+    std::vector<uint8_t> responseBuffer_;
+    std::vector<uint8_t> collisionBuffer_;
+
+    unsigned baudRate_;
+    double timeScale_;
+    unsigned turnaroundDelayUs_;
+    unsigned responseTimeoutUs_;
+
+    double lossProbability_;
+    double corruptionProbability_;
+    std::mt19937 random_;
+
+    Clock::time_point busFreeAt_;
+    Statistics statistics_;
+};
+
+} // namespace Feldbus
+} // namespace TURAG
+
+#endif // PLATFORM_DESKTOP_PUBLIC_TINAPP_FELDBUS_HOST_VIRTUALFELDBUS_H
@@ -0,0 +1,65 @@
+#ifndef PLATFORM_DESKTOP_PUBLIC_TINAPP_FELDBUS_SLAVE_DRIVER_H
+#define PLATFORM_DESKTOP_PUBLIC_TINAPP_FELDBUS_SLAVE_DRIVER_H
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <tina++/tina.h>
+#include <tina/feldbus/slave/feldbus_config_check.h>
+
+
+namespace TURAG {
+namespace Feldbus {
+namespace Slave {
+
+/**
+ * @brief Feldbus-Slave Treiber für den Desktop.
+ *
+ * Es gibt keine Schnittstelle, Pakete werden direkt an
+ * Slave::Base::processPacket() übergeben. Damit lässt sich der
+ * plattform-unabhängige Teil des Slaves auf dem PC testen und messen.
+ */
+class Driver {
+public:
+    /**
+     * @brief Stellt die Baudrate um.
+     * @return Immer true, es gibt keine Schnittstelle.
+     */
+    static bool setBaudRate(uint32_t) {
+        return true;
+    }
+
+    /**
+     * @brief Beendet das Programm anstelle eines Resets.
+     */
+    static void resetBoard() {
+        std::exit(0);
+    }
+
+    /**
+     * @brief Es gibt keine LED.
+     */
+    static void toggleLed(void) { }
+
+#if TURAG_FELDBUS_SLAVE_CONFIG_DEBUG_ENABLED || defined(__DOXYGEN__)
+    /**
+    * @brief Gibt Debug-Daten auf stdout aus.
+    * @param[in] data Zu sendende Daten.
+    * @param[in] length Länge des Datensatzes.
+    */
+    static void transmitDebugData(const void* data, size_t length) {
+        std::fwrite(data, 1, length, stdout);
+    }
+#endif
+
+private:
+    //prevent instantiation
+    Driver() { }
+};
+
+}
+}
+}
+
+
+#endif // PLATFORM_DESKTOP_PUBLIC_TINAPP_FELDBUS_SLAVE_DRIVER_H
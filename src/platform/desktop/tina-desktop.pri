@@ -10,6 +10,23 @@ HEADERS  += \
     $$PWD/public/tina/thread.h \
     $$PWD/public/tina/time.h \
     $$PWD/public/tina/timetype.h \
-    $$PWD/public/tina++/thread.h
+    $$PWD/public/tina++/thread.h \
+    $$PWD/public/tina++/feldbus_slave_driver.h
+
+contains(TINA, feldbus-host) {
+  SOURCES += \
+      $$PWD/virtualfeldbus.cpp
+
+  HEADERS  += \
+      $$PWD/public/tina++/feldbus/host/virtualfeldbus.h
+
+  linux {
+    SOURCES += \
+        $$PWD/linuxserialfeldbus.cpp
+
+    HEADERS  += \
+        $$PWD/public/tina++/feldbus/host/linuxserialfeldbus.h
+  }
+}
 
 DISTR_FILES += $$PWD/tina-desktop.pri
@@ -0,0 +1,273 @@
+#define TURAG_DEBUG_LOG_SOURCE "B"
+
+#include <tina++/tina.h>
+
+#if TURAG_USE_TURAG_FELDBUS_HOST
+
+#include <tina++/feldbus/host/virtualfeldbus.h>
+#include <tina/debug/print.h>
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+namespace TURAG {
+namespace Feldbus {
+
+namespace {
+
+// large enough for the biggest slave buffer (FeldbusSize_t is at most 16 bit)
+constexpr std::size_t maxPacketSize = 65536;
+
+// sleeping is only precise to roughly this amount, the rest is spent spinning
+constexpr std::chrono::microseconds spinThreshold(100);
+
+} // namespace
+
+VirtualFeldbus::VirtualFeldbus(const char* name, unsigned baudRate, bool threadSafe) :
+    FeldbusAbstraction(name, threadSafe),
+    slaves_(),
+    responseBuffer_(maxPacketSize),
+    collisionBuffer_(maxPacketSize),
+    baudRate_(baudRate ? baudRate : 1),
+    timeScale_(1.0),
+    turnaroundDelayUs_(50),
+    responseTimeoutUs_(5000),
+    lossProbability_(0.0),
+    corruptionProbability_(0.0),
+    random_(1),
+    busFreeAt_(Clock::now()),
+    statistics_()
+{ }
+
+bool VirtualFeldbus::addSlave(unsigned address, Slave* slave)
+{
+    if (address == TURAG_FELDBUS_BROADCAST_ADDR || address >= slaves_.size() || !slave) {
+        turag_errorf("%s: invalid slave address %u", name(), address);
+        return false;
+    }
+    if (slaves_[address]) {
+        turag_errorf("%s: slave address %u already in use", name(), address);
+        return false;
+    }
+    slaves_[address] = slave;
+    return true;
+}
+
+void VirtualFeldbus::removeSlave(unsigned address)
+{
+    if (address < slaves_.size()) {
+        slaves_[address] = nullptr;
+    }
+}
+
+bool VirtualFeldbus::doSetBaudRate(unsigned baudRate)
+{
+    if (baudRate == 0) {
+        return false;
+    }
+    baudRate_ = baudRate;
+    return true;
+}
+
+void VirtualFeldbus::setErrorRates(double lossProbability, double corruptionProbability, unsigned seed)
+{
+    lossProbability_ = lossProbability;
+    corruptionProbability_ = corruptionProbability;
+    random_.seed(seed);
+}
+
+void VirtualFeldbus::resetStatistics(void)
+{
+    statistics_ = Statistics();
+}
+
+VirtualFeldbus::Clock::duration VirtualFeldbus::scaled(double microseconds) const
+{
+    return std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double, std::micro>(microseconds * timeScale_));
+}
+
+double VirtualFeldbus::wireTimeUs(int bytes) const
+{
+    // 8N1: 10 bits per byte
+    return bytes * 10 * 1e6 / baudRate_;
+}
+
+void VirtualFeldbus::sleepUntil(Clock::time_point time) const
+{
+    if (timeScale_ <= 0.0) {
+        return;
+    }
+
+    Clock::time_point now = Clock::now();
+    if (time - now > 2 * spinThreshold) {
+        std::this_thread::sleep_until(time - spinThreshold);
+    }
+    while (Clock::now() < time) {
+        // spin for the last few microseconds
+    }
+}
+
+bool VirtualFeldbus::chance(double probability)
+{
+    if (probability <= 0.0) {
+        return false;
+    }
+    return std::uniform_real_distribution<double>(0.0, 1.0)(random_) < probability;
+}
+
+bool VirtualFeldbus::doTransceive(const uint8_t* transmit, int* transmit_length, uint8_t* receive, int* receive_length, bool delayTransmission)
+{
+    const int wanted = receive && receive_length ? *receive_length : 0;
+    // Only go through the system ticks for a timeout of the caller, as they
+    // would cut the default off below one tick.
+    const SystemTime callerTimeout = responseTimeout(SystemTime::infinite());
+    const double timeoutUs = callerTimeout == SystemTime::infinite() ? responseTimeoutUs_ : callerTimeout.toUsec();
+
+    if (!transmit || !transmit_length || *transmit_length == 0) {
+        // There is nobody to answer if nothing is sent.
+        if (wanted) {
+            sleepUntil(Clock::now() + scaled(timeoutUs));
+            *receive_length = 0;
+            return false;
+        }
+        return true;
+    }
+
+    // The bus delay of 1.5 frames is measured from the end of the last transmission,
+    // exactly like the hardware drivers do it.
+    Clock::time_point start = Clock::now();
+    if (delayTransmission) {
+        start = std::max(start, busFreeAt_ + scaled(16 * 1e6 / baudRate_));
+    }
+    sleepUntil(start);
+
+    const int length = *transmit_length;
+    const unsigned address = transmit[0];
+    const Clock::time_point transmitEnd = start + scaled(wireTimeUs(length));
+    ++statistics_.frames;
+    statistics_.busTimeUs += static_cast<unsigned long long>(wireTimeUs(length));
+
+    // Let the slaves process the packet. This takes the real processing time
+    // of the slave code, which is part of what we want to measure.
+    int responseLength = 0;
+    // time from the end of the request to the end of the response in frames,
+    // which is longer than the response if the slaves answer in separate time slots
+    int responseFrames = 0;
+    if (!chance(lossProbability_)) {
+        if (address == TURAG_FELDBUS_BROADCAST_ADDR) {
+            ++statistics_.broadcasts;
+
+            // Every slave gets the broadcast. If more than one of them answers,
+            // the responses collide on the bus unless they are sent in
+            // separate time slots.
+            struct Reply {
+                unsigned delay;
+                int length;
+                std::size_t offset;
+            };
+            std::vector<Reply> replies;
+            std::size_t collected = 0;
+            for (unsigned i = 1; i < slaves_.size(); ++i) {
+                if (!listens(i)) {
+                    continue;
+                }
+                if (collisionBuffer_.size() < collected + maxPacketSize) {
+                    collisionBuffer_.resize(collected + maxPacketSize);
+                }
+                collisionBuffer_[collected] = static_cast<uint8_t>(i);
+                int slaveResponseLength = slaves_[i]->processPacket(transmit, length, collisionBuffer_.data() + collected);
+                if (slaveResponseLength <= 0) {
+                    continue;
+                }
+                replies.push_back({slaves_[i]->responseDelayFrames(), slaveResponseLength, collected});
+                collected += slaveResponseLength;
+            }
+            if (responseBuffer_.size() < collected) {
+                responseBuffer_.resize(collected);
+            }
+            std::stable_sort(replies.begin(), replies.end(), [](const Reply& a, const Reply& b) {
+                return a.delay < b.delay;
+            });
+
+            int slotStart = 0;
+            int slotOffset = 0;
+            for (const Reply& reply : replies) {
+                const int replyStart = static_cast<int>(reply.delay);
+                const uint8_t* data = collisionBuffer_.data() + reply.offset;
+                if (responseLength == 0 || replyStart >= responseFrames) {
+                    // bus is free again
+                    slotStart = replyStart;
+                    slotOffset = responseLength;
+                    std::memcpy(responseBuffer_.data() + responseLength, data, reply.length);
+                    responseLength += reply.length;
+                } else {
+                    // overlaps the previous answer
+                    const int offset = slotOffset + replyStart - slotStart;
+                    for (int j = 0; j < reply.length; ++j) {
+                        if (offset + j < responseLength) {
+                            responseBuffer_[offset + j] |= data[j];
+                        } else {
+                            responseBuffer_[offset + j] = data[j];
+                        }
+                    }
+                    responseLength = std::max(responseLength, offset + reply.length);
+                }
+                responseFrames = std::max(responseFrames, replyStart + reply.length);
+            }
+        } else if (address < slaves_.size() && listens(address)) {
+            responseBuffer_[0] = static_cast<uint8_t>(address);
+            responseLength = std::max(0, slaves_[address]->processPacket(transmit, length, responseBuffer_.data()));
+            responseFrames = responseLength;
+        }
+    } else {
+        ++statistics_.lostFrames;
+    }
+
+    sleepUntil(transmitEnd);
+
+    if (wanted == 0) {
+        busFreeAt_ = transmitEnd;
+        return true;
+    }
+
+    // the driver gives up if the slave takes longer to answer than the timeout
+    if (responseLength == 0 || turnaroundDelayUs_ >= timeoutUs) {
+        ++statistics_.unansweredFrames;
+        sleepUntil(transmitEnd + scaled(timeoutUs));
+        busFreeAt_ = Clock::now();
+        *receive_length = 0;
+        return false;
+    }
+
+    const int received = std::min(responseLength, wanted);
+    if (chance(corruptionProbability_)) {
+        ++statistics_.corruptedFrames;
+        unsigned bit = std::uniform_int_distribution<unsigned>(0, received * 8 - 1)(random_);
+        responseBuffer_[bit / 8] ^= static_cast<uint8_t>(1 << (bit % 8));
+    }
+
+    double responseTimeUs = turnaroundDelayUs_ + wireTimeUs(responseFrames - (responseLength - received));
+    statistics_.busTimeUs += static_cast<unsigned long long>(responseTimeUs);
+    Clock::time_point receiveEnd = transmitEnd + scaled(responseTimeUs);
+    if (received < wanted) {
+        // the driver waits for the missing bytes until the timeout hits
+        ++statistics_.unansweredFrames;
+        receiveEnd += scaled(timeoutUs);
+    }
+    // a real driver calculates the checksum while the response arrives
+    accumulateReceived(responseBuffer_.data(), received);
+    sleepUntil(receiveEnd);
+
+    std::memcpy(receive, responseBuffer_.data(), received);
+    *receive_length = received;
+    busFreeAt_ = std::max(receiveEnd, Clock::now());
+
+    return received == wanted;
+}
+
+} // namespace Feldbus
+} // namespace TURAG
+
+#endif // TURAG_USE_TURAG_FELDBUS_HOST
@@ -3,36 +3,65 @@
 #include <tina++/tina.h>
 #include <tina++/feldbus/host/feldbusabstraction.h>
 #include <boost/asio.hpp>
+#include <array>
 #include <chrono>
+#include <condition_variable>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 namespace TURAG {
 namespace Feldbus {
 
+/**
+ * \brief %TURAG-Feldbus an einer seriellen Schnittstelle mit boost::asio.
+ *
+ * Die Ein- und Ausgabe läuft in einem eigenen %Thread, der während der gesamten
+ * Lebensdauer des Objekts existiert und ständig einen Lesevorgang ausstehen hat.
+ * Empfangene Bytes werden gepuffert und der in doTransceive() wartende %Thread
+ * geweckt, sobald die erwartete Antwort vollständig ist oder der Timeout abläuft.
+ * Das Paket-Delay von 1,5 Frames wird mit hochauflösenden Timern eingehalten.
+ */
 class SerialFieldbus: public Feldbus::FeldbusAbstraction
 {
 public:
     SerialFieldbus(const std::string& device, unsigned baudrate);
+    ~SerialFieldbus();
     void clearBuffer() override;
+    unsigned baudRate() const override { return baudrate_; }
 protected:
     bool doTransceive(const uint8_t* transmit, int* transmit_length, uint8_t* receive, int* receive_length, bool delayTransmission) override;
+    bool doSetBaudRate(unsigned baudrate) override;
 private:
-    void writeHandler(const boost::system::error_code& ec, std::size_t bytes_transferred);
+    typedef std::chrono::steady_clock Clock;
+
+    void startRead();
     void readHandler(const boost::system::error_code& ec, std::size_t bytes_transferred);
-    void timeoutHandler(const boost::system::error_code& ec);
+    void writeHandler(const boost::system::error_code& ec, std::size_t bytes_transferred);
 
     boost::asio::io_service io_service_;
+    boost::asio::io_service::work work_;
     boost::asio::serial_port port_;
-    boost::asio::deadline_timer timeout_;
-    boost::system::error_code write_error_;
-    boost::system::error_code read_error_;
+    std::thread io_thread_;
+
+    unsigned baudrate_;
+    std::chrono::nanoseconds transmission_delay_;
+    Clock::time_point bus_free_at_;
 
-    SystemTime transmission_delay_;
+    // filled by the I/O thread
+    std::array<uint8_t, 256> read_buffer_;
 
-    size_t bytes_written_, bytes_read_;
-    uint8_t* receive_;
-    size_t transmit_length_, receive_length_;
-    std::chrono::time_point<std::chrono::high_resolution_clock> send_time_;
+    // shared between the I/O thread and doTransceive(), protected by mutex_
+    std::mutex mutex_;
+    std::condition_variable completed_;
+    std::vector<uint8_t> received_;
+    // length of the response of the running transfer, 0 if there is none
+    size_t receive_wanted_;
+    boost::system::error_code write_error_;
+    boost::system::error_code read_error_;
+    size_t bytes_written_;
+    bool write_done_;
 };
 
 } // namespace Feldbus
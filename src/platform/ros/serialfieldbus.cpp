@@ -1,5 +1,7 @@
 #include <tina++/feldbus/host/serialfieldbus.h>
 #include <ros/console.h>
+#include <algorithm>
+#include <cstring>
 
 using namespace boost::asio;
 using namespace std::chrono;
@@ -10,11 +12,15 @@ namespace Feldbus {
 SerialFieldbus::SerialFieldbus(const std::string& device, unsigned baudrate):
     Feldbus::FeldbusAbstraction("SerialFieldbus"),
     io_service_(),
+    work_(io_service_),
     port_(io_service_),
-    timeout_(io_service_)
+    baudrate_(baudrate),
+    transmission_delay_(nanoseconds(15000000000ULL / baudrate)),
+    bus_free_at_(Clock::now()),
+    receive_wanted_(0),
+    bytes_written_(0),
+    write_done_(false)
 {
-    transmission_delay_ = SystemTime::fromSecDouble(15.0 / baudrate);
-
     try {
         port_.open(device);
     } catch(std::exception& ex) {
@@ -33,92 +39,150 @@ SerialFieldbus::SerialFieldbus(const std::string& device, unsigned baudrate):
     } else {
         ROS_INFO("SerialFieldbus: Successfully opened serial port %s with %d baud.", device.c_str(), baudrate);
     }
+
+    // There is always a read pending, so received bytes are handed to us
+    // without waiting for doTransceive() to set up a new read.
+    startRead();
+    io_thread_ = std::thread([this]() { io_service_.run(); });
+}
+
+SerialFieldbus::~SerialFieldbus() {
+    io_service_.stop();
+    if(io_thread_.joinable())
+        io_thread_.join();
+    boost::system::error_code ec;
+    port_.close(ec);
 }
 
 void SerialFieldbus::clearBuffer() {
     ::tcflush(port_.lowest_layer().native_handle(), TCIOFLUSH);
+    std::lock_guard<std::mutex> lock(mutex_);
+    received_.clear();
 }
 
-void SerialFieldbus::writeHandler(const boost::system::error_code& ec, std::size_t bytes_transferred) {
-    ROS_DEBUG("SerialFieldbus: wrote %lu bytes", bytes_transferred);
-    write_error_ = ec;
-    bytes_written_ = bytes_transferred;
-    if(write_error_)
-        return;
-
-    if(receive_ && receive_length_) {
-        ROS_DEBUG("SerialFieldbus: reading %lu bytes", receive_length_);
-        async_read(port_, boost::asio::buffer(receive_, receive_length_), boost::bind(&SerialFieldbus::readHandler, this, _1, _2));
-    } else {
-        timeout_.cancel();
+bool SerialFieldbus::doSetBaudRate(unsigned baudrate) {
+    if(baudrate == 0)
+        return false;
+    boost::system::error_code ec;
+    port_.set_option(serial_port::baud_rate(baudrate), ec);
+    if(ec) {
+        ROS_ERROR("SerialFieldbus: Couldn't set baud rate %u: %s", baudrate, ec.message().c_str());
+        return false;
     }
+    baudrate_ = baudrate;
+    transmission_delay_ = nanoseconds(15000000000ULL / baudrate);
+    return true;
+}
+
+void SerialFieldbus::startRead() {
+    port_.async_read_some(buffer(read_buffer_), [this](const boost::system::error_code& ec, std::size_t bytes_transferred) {
+        readHandler(ec, bytes_transferred);
+    });
 }
 
 void SerialFieldbus::readHandler(const boost::system::error_code &ec, std::size_t bytes_transferred) {
-    ROS_DEBUG("SerialFieldbus: read %lu bytes", bytes_transferred);
-    ROS_DEBUG_STREAM("SerialFieldbus: Duration: " << duration_cast<microseconds>(high_resolution_clock::now() - send_time_).count() << "us");
-    read_error_ = ec;
-    bytes_read_ = bytes_transferred;
-    timeout_.cancel();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(!ec) {
+            const size_t before = received_.size();
+            received_.insert(received_.end(), read_buffer_.begin(), read_buffer_.begin() + bytes_transferred);
+            // the checksum is calculated here while doTransceive() waits for the rest
+            if(before < receive_wanted_)
+                accumulateReceived(read_buffer_.data(), std::min(bytes_transferred, receive_wanted_ - before));
+        } else if(ec != error::operation_aborted) {
+            read_error_ = ec;
+        }
+    }
+    completed_.notify_one();
+
+    // A read is only aborted if a write timed out, so we keep on reading.
+    // Any other error means the port is gone.
+    if(!ec || ec == error::operation_aborted)
+        startRead();
 }
 
-void SerialFieldbus::timeoutHandler(const boost::system::error_code& ec) {
-    if(ec == boost::asio::error::operation_aborted)
-        return;
-    ROS_ERROR_THROTTLE(5.0, "SerialFieldbus: Fieldbus transmission timeout!");
-    port_.cancel();
+void SerialFieldbus::writeHandler(const boost::system::error_code& ec, std::size_t bytes_transferred) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        write_error_ = ec;
+        bytes_written_ = bytes_transferred;
+        write_done_ = true;
+    }
+    completed_.notify_one();
 }
 
 bool SerialFieldbus::doTransceive(const uint8_t* transmit, int* transmit_length,
                                   uint8_t* receive, int* receive_length, bool delay) {
-    if(delay)
-        CurrentThread::delay(transmission_delay_);
-
     if(!port_.is_open()) {
         ROS_ERROR_THROTTLE(5.0, "SerialFieldbus: Transcieve failed: Serial port not open.");
         return false;
     }
-    bytes_written_ = bytes_read_ = 0;
-    read_error_.clear();
-    write_error_.clear();
 
-    receive_ = receive;
+    const size_t transmit_length_ = transmit_length ? *transmit_length : 0;
+    const size_t receive_length_ = receive && receive_length ? *receive_length : 0;
 
-    if(transmit_length)
-        transmit_length_ = *transmit_length;
-    else
-        transmit_length_ = 0;
+    // sleep_until is precise to a few microseconds, so only the part of the
+    // bus delay that didn't pass since the last transfer is spent here.
+    if(delay)
+        std::this_thread::sleep_until(bus_free_at_ + transmission_delay_);
 
-    if(receive_length)
-        receive_length_ = *receive_length;
-    else
-        receive_length_ = 0;
+    const Clock::time_point deadline = Clock::now() + microseconds(responseTimeout(SystemTime::fromMsec(50)).toUsec());
 
-    timeout_.expires_from_now(boost::posix_time::milliseconds(50));
-    timeout_.async_wait(boost::bind(&SerialFieldbus::timeoutHandler, this, _1));
+    std::unique_lock<std::mutex> lock(mutex_);
+    // whatever arrived until now is a late answer to a previous transfer
+    received_.clear();
+    receive_wanted_ = receive_length_;
+    read_error_.clear();
+    write_error_.clear();
+    bytes_written_ = 0;
+    write_done_ = transmit_length_ == 0;
+
+    if(transmit_length_) {
+        io_service_.post([this, transmit, transmit_length_]() {
+            async_write(port_, buffer(transmit, transmit_length_), [this](const boost::system::error_code& ec, std::size_t bytes_transferred) {
+                writeHandler(ec, bytes_transferred);
+            });
+        });
+    }
 
-    io_service_.reset();
-    send_time_ = high_resolution_clock::now();
-    if(transmit_length_)
-        async_write(port_, boost::asio::buffer(transmit,transmit_length_), boost::bind(&SerialFieldbus::writeHandler, this, _1, _2));
-    else if(receive_length_)
-        async_read(port_, boost::asio::buffer(receive,receive_length_), boost::bind(&SerialFieldbus::readHandler, this, _1, _2));
+    completed_.wait_until(lock, deadline, [&]() {
+        return (write_done_ && (write_error_ || received_.size() >= receive_length_)) || read_error_;
+    });
+
+    if(!write_done_) {
+        // the transmit buffer must stay valid until asio is done with it
+        io_service_.post([this]() {
+            boost::system::error_code ec;
+            port_.cancel(ec);
+        });
+        completed_.wait(lock, [&]() { return write_done_; });
+    }
 
-    io_service_.run();
+    const size_t bytes_read = std::min(received_.size(), receive_length_);
+    if(bytes_read)
+        std::memcpy(receive, received_.data(), bytes_read);
+    received_.clear();
+    receive_wanted_ = 0;
 
     if(transmit_length)
         *transmit_length = bytes_written_;
     if(receive_length)
-        *receive_length = bytes_read_;
+        *receive_length = bytes_read;
+
+    bus_free_at_ = Clock::now();
 
-    if(write_error_) {
+    if(write_error_ && write_error_ != error::operation_aborted) {
         ROS_ERROR_THROTTLE(5.0, "SerialFieldbus: Fieldbus write error: %s", write_error_.message().c_str());
         return false;
     }
-    if(read_error_ ) {
+    if(read_error_) {
         ROS_ERROR_THROTTLE(5.0, "SerialFieldbus: Fieldbus read error: %s", read_error_.message().c_str());
         return false;
     }
+    if(bytes_written_ < transmit_length_ || bytes_read < receive_length_) {
+        ROS_ERROR_THROTTLE(5.0, "SerialFieldbus: Fieldbus transmission timeout!");
+        return false;
+    }
     return true;
 }
 
@@ -0,0 +1,187 @@
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#ifdef __linux__
+
+#include <tina++/crc/xor.h>
+#include <tina++/feldbus/host/device.h>
+#include <tina++/feldbus/host/linuxserialfeldbus.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+using namespace TURAG;
+using namespace TURAG::Feldbus;
+
+namespace {
+
+class Probe : public Device {
+public:
+    explicit Probe(FeldbusAbstraction& bus) :
+        Device("probe", 1, bus, ChecksumType::xor_based)
+    { }
+
+    bool query(uint8_t command, uint16_t* value) {
+        Request<uint8_t> request;
+        request.data = command;
+
+        Response<uint16_t> response;
+        if (!transceive(request, &response)) {
+            return false;
+        }
+        *value = response.data;
+        return true;
+    }
+};
+
+// Plays the slave on the master side of a pseudo terminal. Every request
+// of three bytes is answered with its command byte doubled into an uint16_t.
+class PtySlave {
+public:
+    PtySlave() :
+        fd_(posix_openpt(O_RDWR | O_NOCTTY)), silent_(false), echo_(false), stop_(false)
+    {
+        if (fd_ < 0 || grantpt(fd_) != 0 || unlockpt(fd_) != 0) {
+            return;
+        }
+        struct termios options;
+        tcgetattr(fd_, &options);
+        cfmakeraw(&options);
+        tcsetattr(fd_, TCSANOW, &options);
+
+        thread_ = std::thread([this] { run(); });
+    }
+
+    ~PtySlave() {
+        stop_ = true;
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+    }
+
+    const char* device(void) const { return fd_ >= 0 ? ptsname(fd_) : nullptr; }
+    bool isRunning(void) const { return thread_.joinable(); }
+
+    void setSilent(bool silent) { silent_ = silent; }
+
+    // emulates a RS485 transceiver that hears its own transmission
+    void setEcho(bool echo) { echo_ = echo; }
+
+private:
+    void run(void) {
+        uint8_t request[3];
+        int received = 0;
+        while (!stop_) {
+            struct pollfd pfd = { fd_, POLLIN, 0 };
+            if (poll(&pfd, 1, 10) <= 0 || !(pfd.revents & POLLIN)) {
+                continue;
+            }
+            const ssize_t n = ::read(fd_, request + received, sizeof(request) - received);
+            if (n <= 0) {
+                continue;
+            }
+            received += static_cast<int>(n);
+            if (received < static_cast<int>(sizeof(request))) {
+                continue;
+            }
+            received = 0;
+
+            uint8_t packet[sizeof(request) + 4];
+            int length = 0;
+            if (echo_) {
+                for (uint8_t byte : request) {
+                    packet[length++] = byte;
+                }
+            }
+            if (!silent_ && XOR::check(request, 2, request[2])) {
+                uint8_t* response = packet + length;
+                response[0] = request[0];
+                response[1] = request[1];
+                response[2] = request[1];
+                response[3] = XOR::calculate(response, 3);
+                length += 4;
+            }
+            if (length > 0 && ::write(fd_, packet, length) != length) {
+                return;
+            }
+        }
+    }
+
+    int fd_;
+    std::atomic<bool> silent_;
+    std::atomic<bool> echo_;
+    std::atomic<bool> stop_;
+    std::thread thread_;
+};
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(FeldbusLinuxSerialTests)
+
+BOOST_AUTO_TEST_CASE( test_round_trip ) {
+    PtySlave slave;
+    BOOST_REQUIRE(slave.isRunning());
+
+    LinuxSerialFeldbus bus("pty");
+    BOOST_REQUIRE(bus.open(slave.device(), 115200));
+    // leave the slave thread some room for the scheduler
+    bus.setResponseDelay(SystemTime::fromMsec(100));
+
+    Probe probe(bus);
+    uint16_t value = 0;
+    BOOST_CHECK(probe.query(0x12, &value));
+    BOOST_CHECK_EQUAL(value, 0x1212);
+    BOOST_CHECK(probe.query(0x34, &value));
+    BOOST_CHECK_EQUAL(value, 0x3434);
+}
+
+BOOST_AUTO_TEST_CASE( test_timeout ) {
+    PtySlave slave;
+    BOOST_REQUIRE(slave.isRunning());
+    slave.setSilent(true);
+
+    LinuxSerialFeldbus bus("pty");
+    BOOST_REQUIRE(bus.open(slave.device(), 115200));
+    bus.setResponseDelay(SystemTime::fromMsec(20));
+
+    Probe probe(bus);
+    uint16_t value = 0;
+    const auto start = std::chrono::steady_clock::now();
+    BOOST_CHECK(!probe.query(0x12, &value));
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    // all attempts give up after the response delay
+    BOOST_CHECK(elapsed < std::chrono::seconds(1));
+    BOOST_CHECK_EQUAL(value, 0);
+}
+
+BOOST_AUTO_TEST_CASE( test_local_echo_is_stripped ) {
+    PtySlave slave;
+    BOOST_REQUIRE(slave.isRunning());
+    slave.setEcho(true);
+
+    LinuxSerialFeldbus bus("pty");
+    BOOST_REQUIRE(bus.open(slave.device(), 115200, LinuxSerialFeldbus::localEcho));
+    bus.setResponseDelay(SystemTime::fromMsec(100));
+
+    Probe probe(bus);
+    uint16_t value = 0;
+    BOOST_CHECK(probe.query(0x56, &value));
+    BOOST_CHECK_EQUAL(value, 0x5656);
+    BOOST_CHECK(probe.query(0x78, &value));
+    BOOST_CHECK_EQUAL(value, 0x7878);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#endif // __linux__
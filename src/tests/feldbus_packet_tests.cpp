@@ -0,0 +1,64 @@
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <tina++/feldbus/host/feldbus_packet.h>
+
+using namespace TURAG;
+using namespace TURAG::Feldbus;
+
+BOOST_AUTO_TEST_SUITE(FeldbusPacketTests)
+
+BOOST_AUTO_TEST_CASE( test_layout ) {
+    typedef PacketLayout<uint8_t, uint32_t, uint16_t> Layout;
+
+    static_assert(Layout::offset<0>() == 1, "");
+    static_assert(Layout::offset<1>() == 2, "");
+    static_assert(Layout::offset<2>() == 6, "");
+    static_assert(Layout::payloadSize == 7, "");
+    static_assert(Layout::size == 9, "");
+    static_assert(Layout::length(10) == 19, "");
+    static_assert(Layout::checksumOffset() == 8, "");
+    static_assert(Layout::checksumOffset(10) == 18, "");
+
+    typedef PacketLayout<> Empty;
+    static_assert(Empty::size == 2, "");
+    static_assert(Empty::tailOffset == 1, "");
+}
+
+BOOST_AUTO_TEST_CASE( test_fields ) {
+    Packet<PacketLayout<uint8_t, uint32_t, uint16_t>> packet;
+    packet.set<0>(0xA5);
+    packet.set<1>(0x12345678);
+    packet.set<2>(0xBEEF);
+
+    BOOST_CHECK_EQUAL(packet.get<0>(), 0xA5);
+    BOOST_CHECK_EQUAL(packet.get<1>(), 0x12345678u);
+    BOOST_CHECK_EQUAL(packet.get<2>(), 0xBEEF);
+
+    // fields are packed without padding
+    BOOST_CHECK_EQUAL(packet.data()[1], 0xA5);
+    BOOST_CHECK_EQUAL(packet.data()[2], 0x78);
+    BOOST_CHECK_EQUAL(packet.data()[5], 0x12);
+    BOOST_CHECK_EQUAL(packet.data()[6], 0xEF);
+    BOOST_CHECK_EQUAL(packet.data()[7], 0xBE);
+}
+
+BOOST_AUTO_TEST_CASE( test_view ) {
+    typedef PacketLayout<uint8_t, uint16_t> Layout;
+    uint8_t buffer[Layout::length(3)] = { 0 };
+    PacketView<Layout> view(buffer);
+
+    view.set<1>(0x0102);
+    view.tail()[0] = 7;
+    view.tail()[2] = 9;
+
+    BOOST_CHECK_EQUAL(buffer[2], 0x02);
+    BOOST_CHECK_EQUAL(buffer[3], 0x01);
+    BOOST_CHECK_EQUAL(buffer[4], 7);
+    BOOST_CHECK_EQUAL(buffer[6], 9);
+
+    typedef Packet<Layout, 255> BigPacket;
+    BOOST_CHECK_EQUAL(BigPacket::capacity, 260u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,227 @@
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <tina++/crc/xor.h>
+#include <tina++/feldbus/host/stellantriebedevice.h>
+#include <tina++/feldbus/host/legacystellantriebedevice.h>
+#include <tina++/feldbus/host/feldbus_metadatacache.h>
+#include <tina++/feldbus/host/virtualfeldbus.h>
+
+#include <cstring>
+
+using namespace TURAG;
+using namespace TURAG::Feldbus;
+
+namespace {
+
+constexpr StellantriebeDevice::CommandInfo motorCommands[] = {
+    {"setpoint", StellantriebeDevice::WriteAccess::write,
+     StellantriebeDevice::CommandLength::length_short, TURAG_FELDBUS_STELLANTRIEBE_COMMAND_FACTOR_CONTROL_VALUE},
+};
+
+class Motor : public StellantriebeDevice {
+public:
+    explicit Motor(FeldbusAbstraction& bus) :
+        StellantriebeDevice("motor", 1, bus, ChecksumType::xor_based)
+    { }
+
+    Command<int16_t, WriteAccess::write, CommandType::control> setpoint{
+        "setpoint", this, commandKey(motorCommands, "setpoint")};
+};
+
+// Implements just enough of the Stellantriebe protocol for init() and
+// for writing the only command of motorCommands.
+class MotorSlave : public VirtualFeldbus::Slave {
+public:
+    MotorSlave() :
+        offline_(false), packets_(0), writes_(0), setpoint_(0)
+    { }
+
+    int processPacket(const uint8_t* message, int length, uint8_t* response) override {
+        if (offline_ || !XOR::check(message, length - 1, message[length - 1])) {
+            return 0;
+        }
+        ++packets_;
+        const uint8_t* data = message + 1;
+        const int size = length - 2;
+
+        if (size == 1 && data[0] == 0) {
+            // legacy device info: protocol, type, crc, buffer size,
+            // reserved, name and version info length, uptime frequency
+            const uint8_t info[] = { 1, 0x11, 1, 32, 0, 0, 0, 1, 1, 0, 0 };
+            std::memcpy(response + 1, info, sizeof(info));
+            return finish(response, 1 + sizeof(info));
+        }
+        if (size == 2 && data[0] == 0 && data[1] == TURAG_FELDBUS_DEVICE_COMMAND_GET_UUID) {
+            const uint32_t uuid = 42;
+            std::memcpy(response + 1, &uuid, sizeof(uuid));
+            return finish(response, 1 + sizeof(uuid));
+        }
+        if (size == 4 && data[1] == data[2] && data[2] == data[3]) {
+            return commandInfo(data[0], data[1], response);
+        }
+        if (size == 2 && data[0] == TURAG_FELDBUS_STELLANTRIEBE_MULTI_ACCESS && data[1] == 0) {
+            return finish(response, 1);
+        }
+        if (size == 5 && data[0] == TURAG_FELDBUS_STELLANTRIEBE_MULTI_ACCESS && data[1] == 1 && data[2] == 1) {
+            std::memcpy(&setpoint_, data + 3, sizeof(setpoint_));
+            ++writes_;
+            return finish(response, 1);
+        }
+        if (size == 3 && data[0] == 1) {
+            std::memcpy(&setpoint_, data + 1, sizeof(setpoint_));
+            ++writes_;
+            return finish(response, 1);
+        }
+        return 0;
+    }
+
+    void setOffline(bool offline) { offline_ = offline; }
+    unsigned packets(void) const { return packets_; }
+    unsigned writes(void) const { return writes_; }
+    int16_t setpoint(void) const { return setpoint_; }
+
+private:
+    static int finish(uint8_t* response, int length) {
+        response[length] = XOR::calculate(response, length);
+        return length + 1;
+    }
+
+    static int commandInfo(uint8_t key, uint8_t command, uint8_t* response) {
+        const StellantriebeDevice::CommandInfo& info = motorCommands[0];
+        if (command == TURAG_FELDBUS_STELLANTRIEBE_COMMAND_INFO_GET_COMMANDSET_SIZE) {
+            response[1] = 1;
+            return finish(response, 2);
+        }
+        if (command == TURAG_FELDBUS_STELLANTRIEBE_COMMAND_INFO_GET_COMMANDSET_HASH) {
+            const uint32_t hash = StellantriebeDevice::commandSetHash(motorCommands, 1);
+            std::memcpy(response + 1, &hash, sizeof(hash));
+            return finish(response, 1 + sizeof(hash));
+        }
+        if (key != 1) {
+            return 0;
+        }
+        switch (command) {
+        case TURAG_FELDBUS_STELLANTRIEBE_COMMAND_INFO_GET_NAME_LENGTH:
+            response[1] = static_cast<uint8_t>(std::strlen(info.name));
+            return finish(response, 2);
+        case TURAG_FELDBUS_STELLANTRIEBE_COMMAND_INFO_GET_NAME:
+            std::memcpy(response + 1, info.name, std::strlen(info.name));
+            return finish(response, 1 + std::strlen(info.name));
+        case TURAG_FELDBUS_STELLANTRIEBE_COMMAND_INFO_GET:
+            response[1] = static_cast<uint8_t>(info.access);
+            response[2] = static_cast<uint8_t>(info.length);
+            std::memcpy(response + 3, &info.factor, sizeof(info.factor));
+            return finish(response, 3 + sizeof(info.factor));
+        default:
+            return 0;
+        }
+    }
+
+    bool offline_;
+    unsigned packets_;
+    unsigned writes_;
+    int16_t setpoint_;
+};
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(FeldbusStellantriebeTests)
+
+BOOST_AUTO_TEST_CASE( test_write_behind_resends_failed_values ) {
+    VirtualFeldbus bus("virtual", 115200);
+    bus.setTimeScale(0);
+
+    MotorSlave slave;
+    bus.addSlave(1, &slave);
+
+    Motor motor(bus);
+    BOOST_REQUIRE(motor.init(motorCommands));
+    motor.setWriteBehind(true);
+
+    // unchanged values are not sent again
+    BOOST_CHECK(motor.setpoint.setValue(5));
+    BOOST_CHECK(motor.flush());
+    BOOST_CHECK_EQUAL(slave.writes(), 1u);
+    BOOST_CHECK_EQUAL(slave.setpoint(), 5);
+    BOOST_CHECK(motor.setpoint.setValue(5));
+    BOOST_CHECK(motor.flush());
+    BOOST_CHECK_EQUAL(slave.writes(), 1u);
+
+    // a failed flush keeps the value pending
+    slave.setOffline(true);
+    BOOST_CHECK(motor.setpoint.setValue(7));
+    BOOST_CHECK(!motor.flush());
+    BOOST_CHECK(motor.setpoint.dirty());
+    slave.setOffline(false);
+    BOOST_CHECK(motor.flush());
+    BOOST_CHECK_EQUAL(slave.writes(), 2u);
+    BOOST_CHECK_EQUAL(slave.setpoint(), 7);
+    BOOST_CHECK(!motor.setpoint.dirty());
+
+    // a value the device never received must not be deduplicated
+    BOOST_CHECK(motor.setWriteBehind(false));
+    slave.setOffline(true);
+    BOOST_CHECK(!motor.setpoint.setValue(9));
+    slave.setOffline(false);
+    motor.setWriteBehind(true);
+    BOOST_CHECK(motor.setpoint.setValue(9));
+    BOOST_CHECK(motor.flush());
+    BOOST_CHECK_EQUAL(slave.writes(), 3u);
+    BOOST_CHECK_EQUAL(slave.setpoint(), 9);
+}
+
+BOOST_AUTO_TEST_CASE( test_command_set_from_metadata_cache ) {
+    VirtualFeldbus bus("virtual", 115200);
+    bus.setTimeScale(0);
+
+    MotorSlave slave;
+    bus.addSlave(1, &slave);
+
+    MetadataCache cache;
+    Device::setMetadataCache(&cache);
+
+    Motor queried(bus);
+    BOOST_CHECK(queried.init());
+    const unsigned packets = slave.packets();
+
+    Motor cached(bus);
+    BOOST_CHECK(cached.init());
+    Device::setMetadataCache(nullptr);
+
+    // device info, uuid and the size of the command set
+    BOOST_CHECK_EQUAL(slave.packets() - packets, 3u);
+    BOOST_CHECK_EQUAL(cache.hits(), 1u);
+    BOOST_CHECK(cached.setpoint.setValue(3));
+    BOOST_CHECK_EQUAL(slave.setpoint(), 3);
+}
+
+BOOST_AUTO_TEST_CASE( test_legacy_command_set_from_metadata_cache ) {
+    VirtualFeldbus bus("virtual", 115200);
+    bus.setTimeScale(0);
+
+    MotorSlave slave;
+    bus.addSlave(1, &slave);
+
+    MetadataCache cache;
+    Device::setMetadataCache(&cache);
+
+    LegacyStellantriebeDevice queried("legacy", 1, bus, ChecksumType::xor_based);
+    LegacyStellantriebeDevice::Command_t queriedSet[1];
+    BOOST_CHECK(queried.populateCommandSet(queriedSet, 1));
+    const unsigned packets = slave.packets();
+
+    LegacyStellantriebeDevice cached("legacy", 1, bus, ChecksumType::xor_based);
+    LegacyStellantriebeDevice::Command_t cachedSet[1];
+    BOOST_CHECK(cached.populateCommandSet(cachedSet, 1));
+    Device::setMetadataCache(nullptr);
+
+    // device info, uuid and the size of the command set
+    BOOST_CHECK_EQUAL(slave.packets() - packets, 3u);
+    BOOST_CHECK_EQUAL(cache.hits(), 1u);
+    BOOST_CHECK(cachedSet[0].writeAccess == queriedSet[0].writeAccess);
+    BOOST_CHECK(cachedSet[0].length == queriedSet[0].length);
+    BOOST_CHECK_EQUAL(cachedSet[0].factor, queriedSet[0].factor);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
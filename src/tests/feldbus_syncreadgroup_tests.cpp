@@ -0,0 +1,94 @@
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <tina++/crc/xor.h>
+#include <tina++/feldbus/host/feldbus_syncreadgroup.h>
+#include <tina++/feldbus/host/virtualfeldbus.h>
+
+using namespace TURAG;
+using namespace TURAG::Feldbus;
+
+namespace {
+
+// Answers a sync read with four bytes in the slot given by its position
+// in the address list of the broadcast.
+class SyncReadSlave : public VirtualFeldbus::Slave {
+public:
+    explicit SyncReadSlave(uint8_t address) :
+        address_(address), corrupt_(false), delay_(0)
+    { }
+
+    int processPacket(const uint8_t* message, int length, uint8_t* response) override {
+        delay_ = 0;
+        if (!XOR::check(message, length - 1, message[length - 1])) {
+            return 0;
+        }
+        if (length < 6 || message[0] != TURAG_FELDBUS_BROADCAST_ADDR ||
+                message[2] != TURAG_FELDBUS_DEVICE_BROADCAST_SYNC_READ) {
+            return 0;
+        }
+        const unsigned count = message[4];
+        for (unsigned i = 0; i < count; ++i) {
+            if (message[5 + i] == address_) {
+                for (unsigned k = 0; k < 4; ++k) {
+                    response[1 + k] = static_cast<uint8_t>(address_ + k);
+                }
+                response[5] = XOR::calculate(response, 5);
+                if (corrupt_) {
+                    response[5] ^= 0xFF;
+                }
+                delay_ = i * message[3];
+                return 6;
+            }
+        }
+        return 0;
+    }
+
+    unsigned responseDelayFrames(void) override { return delay_; }
+
+    void setCorrupt(bool corrupt) { corrupt_ = corrupt; }
+
+private:
+    uint8_t address_;
+    bool corrupt_;
+    unsigned delay_;
+};
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(FeldbusSyncReadGroupTests)
+
+BOOST_AUTO_TEST_CASE( test_corrupted_response_keeps_alignment ) {
+    VirtualFeldbus bus("virtual", 115200);
+    bus.setTimeScale(0);
+
+    SyncReadSlave slave1(1), slave2(2), slave3(3);
+    bus.addSlave(1, &slave1);
+    bus.addSlave(2, &slave2);
+    bus.addSlave(3, &slave3);
+
+    Device device1("d1", 1, bus, ChecksumType::xor_based);
+    Device device2("d2", 2, bus, ChecksumType::xor_based);
+    Device device3("d3", 3, bus, ChecksumType::xor_based);
+
+    SyncReadGroup group(bus, ChecksumType::xor_based);
+    Device::Response<uint32_t> responses[3];
+    BOOST_REQUIRE(group.addDevice(&device1, &responses[0]));
+    BOOST_REQUIRE(group.addDevice(&device2, &responses[1]));
+    BOOST_REQUIRE(group.addDevice(&device3, &responses[2]));
+
+    const uint8_t key = 0x10;
+    BOOST_CHECK(group.read(key));
+    BOOST_CHECK_EQUAL(group.responses(), 3u);
+
+    // the middle response is lost, the one after it must still be found
+    slave2.setCorrupt(true);
+    BOOST_CHECK(!group.read(key));
+    BOOST_CHECK(group.success(0));
+    BOOST_CHECK(!group.success(1));
+    BOOST_CHECK(group.success(2));
+    BOOST_CHECK_EQUAL(responses[2].address, 3);
+    BOOST_CHECK_EQUAL(responses[2].data, 0x06050403u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
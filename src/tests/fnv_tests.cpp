@@ -0,0 +1,26 @@
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <cstring>
+#include <tina++/crc/fnv.h>
+
+using namespace TURAG;
+
+BOOST_AUTO_TEST_SUITE(FnvTests)
+
+BOOST_AUTO_TEST_CASE( test_reference_values ) {
+    BOOST_CHECK_EQUAL(FNV1a::calculate("", 0), 0x811c9dc5u);
+    BOOST_CHECK_EQUAL(FNV1a::calculate("a", 1), 0xe40c292cu);
+    BOOST_CHECK_EQUAL(FNV1a::calculate("foobar", 6), 0xbf9cf968u);
+}
+
+BOOST_AUTO_TEST_CASE( test_update ) {
+    // hashing in pieces gives the same result as hashing at once
+    const char* text = "foobar";
+    uint32_t hash = FNV1a::update(FNV1a::initialValue, text, 2);
+    hash = FNV1a::update(hash, text + 2, 0);
+    hash = FNV1a::update(hash, text + 2, 4);
+    BOOST_CHECK_EQUAL(hash, FNV1a::calculate(text, strlen(text)));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,77 @@
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <tina++/debug/latencyhistogram.h>
+
+using namespace TURAG;
+using namespace TURAG::Debug;
+
+BOOST_AUTO_TEST_SUITE(LatencyHistogramTests)
+
+BOOST_AUTO_TEST_CASE( test_bucket_index ) {
+    // exact below the first power of two
+    for (unsigned i = 0; i < LatencyHistogram::subBuckets; ++i) {
+        BOOST_CHECK_EQUAL(LatencyHistogram::bucketIndex(i), i);
+    }
+
+    // every bucket starts at its lower bound and ends right before the next one
+    for (unsigned i = 1; i < LatencyHistogram::numberOfBuckets; ++i) {
+        unsigned lower = LatencyHistogram::bucketLowerBound(i);
+        BOOST_CHECK_EQUAL(LatencyHistogram::bucketIndex(lower), i);
+        BOOST_CHECK_EQUAL(LatencyHistogram::bucketIndex(lower - 1), i - 1);
+    }
+
+    // saturation
+    BOOST_CHECK_EQUAL(LatencyHistogram::bucketIndex(~0u), LatencyHistogram::numberOfBuckets - 1);
+}
+
+BOOST_AUTO_TEST_CASE( test_empty ) {
+    LatencyHistogram histogram;
+    BOOST_CHECK_EQUAL(histogram.count(), 0u);
+    BOOST_CHECK_EQUAL(histogram.min(), 0u);
+    BOOST_CHECK_EQUAL(histogram.max(), 0u);
+    BOOST_CHECK_EQUAL(histogram.mean(), 0u);
+    BOOST_CHECK_EQUAL(histogram.percentile(0.5f), 0u);
+}
+
+BOOST_AUTO_TEST_CASE( test_statistics ) {
+    LatencyHistogram histogram;
+    for (unsigned i = 1; i <= 100; ++i) {
+        histogram.add(i * 100);
+    }
+
+    BOOST_CHECK_EQUAL(histogram.count(), 100u);
+    BOOST_CHECK_EQUAL(histogram.min(), 100u);
+    BOOST_CHECK_EQUAL(histogram.max(), 10000u);
+    BOOST_CHECK_EQUAL(histogram.mean(), 5050u);
+
+    // quantiles are never underestimated and at most one bucket (25 %) too high
+    unsigned p50 = histogram.percentile(0.5f);
+    BOOST_CHECK_GE(p50, 5000u);
+    BOOST_CHECK_LE(p50, 6250u);
+    unsigned p99 = histogram.percentile(0.99f);
+    BOOST_CHECK_GE(p99, 9900u);
+    BOOST_CHECK_LE(p99, 10000u);
+    BOOST_CHECK_EQUAL(histogram.percentile(1.0f), 10000u);
+    // 100 lies in the bucket from 96 to 111
+    BOOST_CHECK_EQUAL(histogram.percentile(0.0f), 111u);
+}
+
+BOOST_AUTO_TEST_CASE( test_reset ) {
+    LatencyHistogram histogram;
+    histogram.add(42);
+    histogram.add(4200);
+    histogram.reset();
+
+    BOOST_CHECK_EQUAL(histogram.count(), 0u);
+    BOOST_CHECK_EQUAL(histogram.max(), 0u);
+    for (unsigned i = 0; i < LatencyHistogram::numberOfBuckets; ++i) {
+        BOOST_CHECK_EQUAL(histogram.bucketCount(i), 0u);
+    }
+
+    histogram.add(7);
+    BOOST_CHECK_EQUAL(histogram.min(), 7u);
+    BOOST_CHECK_EQUAL(histogram.percentile(0.5f), 7u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -8,7 +8,7 @@ QT       += testlib
 
 #QT       -= gui
 
-DEFINES += SIM SIMULATION BOT_A TURAG_NO_PROJECT_CONFIG TURAG_DEBUG_ENABLE_BINARY
+DEFINES += SIM SIMULATION BOT_A TURAG_NO_PROJECT_CONFIG TURAG_DEBUG_ENABLE_BINARY TURAG_USE_TURAG_FELDBUS_HOST=1 TURAG_CRC_CRC8_ALGORITHM=1
 
 TARGET = tina-tests
 CONFIG   += console
@@ -37,6 +37,12 @@ SOURCES += \
     circular_buffer_tests.cpp \
     bit_macros_tests.cpp \
     array_buffer_tests.cpp \
+    latencyhistogram_tests.cpp \
+    feldbus_packet_tests.cpp \
+    fnv_tests.cpp \
+    feldbus_syncreadgroup_tests.cpp \
+    feldbus_stellantriebe_tests.cpp \
+    feldbus_linuxserial_tests.cpp \
     helper/variant_class_tests.cpp
 
 HEADERS += \
@@ -45,7 +51,7 @@ HEADERS += \
 
 INCLUDEPATH += \
 
-TINA += debug statemachine geometry base64
+TINA += debug statemachine geometry base64 crc feldbus-host
 
 include(../tina.pri)
 include(../platform/desktop/tina-desktop.pri)
@@ -8,3 +8,4 @@
 
 #include "crc/crc.h"
 #include "crc/xor.h"
+#include "crc/fnv.h"
@@ -20,6 +20,21 @@ namespace TURAG {
 namespace CRC8 {
 
 #if TURAG_CRC_CRC8_ALGORITHM != 0 || defined(__DOXYGEN__)	
+
+/// Start value for update().
+constexpr uint8_t initialValue = TURAG_CRC8_INITIAL_VALUE;
+
+/**
+ * @brief Continues a checksum with more data.
+ * @param[in]	crc		checksum of the preceding data or initialValue
+ * @param[in]	data	pointer to data that is to be included in the calculation
+ * @param[in]	length	length in bytes of the given data pointer
+ * @return checksum of the preceding and the given data
+ */
+TURAG_ALWAYS_INLINE
+uint8_t update(uint8_t crc, const void* data, std::size_t length) {
+  return turag_crc8_update(crc, data, length);
+}
 	
 template <typename T> TURAG_ALWAYS_INLINE
 uint8_t calculate(const T& data) {
@@ -0,0 +1,65 @@
+/**
+ *  @file		tina++/crc/fnv.h
+ *  @brief		Contains the FNV-1a hash function
+ *
+ */
+
+#ifndef TINAPP_CRC_FNV_H
+#define TINAPP_CRC_FNV_H
+
+#include <cstddef>
+
+#include <tina++/tina.h>
+
+
+namespace TURAG {
+
+/**
+ * @addtogroup checksums
+ * @{
+ */
+
+/**
+ * @brief 32 Bit FNV-1a hash
+ *
+ * Not suited for detecting transmission errors, but as a fingerprint of
+ * larger data which is spread over several buffers, e.g. a command table.
+ */
+namespace FNV1a {
+
+/// Start value for update().
+constexpr uint32_t initialValue = 0x811c9dc5;
+
+/// FNV prime.
+constexpr uint32_t prime = 0x01000193;
+
+/**
+ * @brief Continues a hash with more data.
+ * @param[in]	hash	hash of the preceding data or initialValue
+ * @param[in]	data	pointer to data that is to be included in the calculation
+ * @param[in]	length	length in bytes of the given data pointer
+ * @return hash of the preceding and the given data
+ */
+inline
+uint32_t update(uint32_t hash, const void* data, std::size_t length) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  for (std::size_t i = 0; i < length; ++i) {
+    hash = (hash ^ bytes[i]) * prime;
+  }
+  return hash;
+}
+
+TURAG_ALWAYS_INLINE
+uint32_t calculate(const void* data, std::size_t length) {
+  return update(initialValue, data, length);
+}
+
+} // namespace FNV1a
+
+/**
+ * @}
+ */
+
+} // namespace TURAG
+
+#endif // TINAPP_CRC_FNV_H
@@ -0,0 +1,52 @@
+#include "latencyhistogram.h"
+
+#include <cstring>
+
+namespace TURAG {
+namespace Debug {
+
+void LatencyHistogram::reset()
+{
+	std::memset(buckets_, 0, sizeof(buckets_));
+	count_ = 0;
+	min_ = ~0u;
+	max_ = 0;
+	sum_ = 0;
+}
+
+unsigned LatencyHistogram::bucketLowerBound(unsigned index)
+{
+	if (index < subBuckets) {
+		return index;
+	}
+	unsigned exponent = index / subBuckets + subBucketBits - 1;
+	return (subBuckets + index % subBuckets) << (exponent - subBucketBits);
+}
+
+unsigned LatencyHistogram::percentile(float p) const
+{
+	if (count_ == 0) {
+		return 0;
+	}
+
+	// rank of the wanted value, counting from 1
+	unsigned rank = static_cast<unsigned>(p * count_ + 0.5f);
+	if (rank < 1) rank = 1;
+	if (rank > count_) rank = count_;
+
+	unsigned seen = 0;
+	for (unsigned i = 0; i < numberOfBuckets; ++i) {
+		seen += buckets_[i];
+		if (seen >= rank) {
+			if (i + 1 == numberOfBuckets) {
+				return max_;
+			}
+			unsigned upperBound = bucketLowerBound(i + 1) - 1;
+			return upperBound < max_ ? upperBound : max_;
+		}
+	}
+	return max_;
+}
+
+} // namespace Debug
+} // namespace TURAG
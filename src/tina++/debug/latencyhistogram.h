@@ -0,0 +1,107 @@
+#ifndef TINAPP_DEBUG_LATENCYHISTOGRAM_H
+#define TINAPP_DEBUG_LATENCYHISTOGRAM_H
+
+#include <tina++/tina.h>
+#include <tina++/time.h>
+
+namespace TURAG {
+namespace Debug {
+
+/// \ingroup Debug
+/// \brief Histogramm für Latenzen mit logarithmischer Klasseneinteilung.
+///
+/// Die Klasse erfasst Zeitdauern in Mikrosekunden mit festem Speicherbedarf
+/// (etwa 400 Byte). Jede Zweierpotenz ist in vier Klassen
+/// unterteilt, sodass die relative Auflösung unabhängig vom Wertebereich
+/// bei 25 % liegt. Werte unter 4 µs werden exakt erfasst, Werte ab
+/// 2^25 µs (etwa 33,5 s) landen in der letzten Klasse.
+///
+/// Neben Anzahl, Minimum, Maximum und Mittelwert können beliebige Quantile
+/// abgefragt werden, z.B. Median und 99%-Quantil:
+/// \code
+/// LatencyHistogram histogram;
+/// histogram.add(SystemTime::now() - start);
+/// turag_infof("p50 %u us, p99 %u us, max %u us",
+///             histogram.percentile(0.5f), histogram.percentile(0.99f), histogram.max());
+/// \endcode
+///
+/// Die Klasse ist nicht threadsicher. Das Auslesen parallel zum Erfassen
+/// liefert allerdings höchstens leicht inkonsistente Werte.
+class LatencyHistogram
+{
+public:
+	/// Anzahl der Unterteilungen einer Zweierpotenz als Exponent zur Basis 2.
+	static constexpr unsigned subBucketBits = 2;
+	/// Anzahl der Unterteilungen einer Zweierpotenz.
+	static constexpr unsigned subBuckets = 1 << subBucketBits;
+	/// Größte erfasste Zweierpotenz.
+	static constexpr unsigned maxExponent = 24;
+	/// Anzahl der Klassen.
+	static constexpr unsigned numberOfBuckets = (maxExponent - subBucketBits + 2) * subBuckets;
+
+	/// Histogramm erstellen
+	LatencyHistogram() { reset(); }
+
+	/// \brief Wert in Mikrosekunden hinzufügen
+	void add(unsigned us) {
+		++buckets_[bucketIndex(us)];
+		++count_;
+		sum_ += us;
+		if (us > max_) max_ = us;
+		if (us < min_) min_ = us;
+	}
+
+	/// \brief Zeitdauer hinzufügen
+	void add(SystemTime duration) { add(duration.toUsec()); }
+
+	/// \brief Alle Werte verwerfen
+	void reset();
+
+	/// \brief Anzahl der erfassten Werte
+	unsigned count() const { return count_; }
+
+	/// \brief Kleinster erfasster Wert in Mikrosekunden
+	unsigned min() const { return count_ ? min_ : 0; }
+
+	/// \brief Größter erfasster Wert in Mikrosekunden
+	unsigned max() const { return max_; }
+
+	/// \brief Mittelwert in Mikrosekunden
+	unsigned mean() const { return count_ ? static_cast<unsigned>(sum_ / count_) : 0; }
+
+	/// \brief Quantil in Mikrosekunden
+	/// \param p Anteil zwischen 0 und 1, z.B. 0.99 für das 99%-Quantil
+	/// \returns Obergrenze der Klasse, in die das Quantil fällt, höchstens aber
+	/// der größte erfasste Wert. Somit wird das Quantil nie unterschätzt.
+	unsigned percentile(float p) const;
+
+	/// \brief Anzahl der Werte in Klasse \a index
+	unsigned bucketCount(unsigned index) const { return buckets_[index]; }
+
+	/// \brief Kleinster Wert der Klasse \a index in Mikrosekunden
+	static unsigned bucketLowerBound(unsigned index);
+
+	/// \brief Klasse, in die der Wert \a us fällt
+	static unsigned bucketIndex(unsigned us) {
+		if (us < subBuckets) {
+			return us;
+		}
+		unsigned exponent = 31 - __builtin_clz(us);
+		if (exponent > maxExponent) {
+			return numberOfBuckets - 1;
+		}
+		return (exponent - subBucketBits + 1) * subBuckets + ((us >> (exponent - subBucketBits)) & (subBuckets - 1));
+	}
+
+private:
+	unsigned buckets_[numberOfBuckets];
+	unsigned count_;
+	unsigned min_;
+	unsigned max_;
+	uint64_t sum_;
+};
+
+} // namespace Debug
+} // namespace TURAG
+
+#endif // TINAPP_DEBUG_LATENCYHISTOGRAM_H
@@ -49,6 +49,7 @@ Base::Info Base::info = {
 Base::PacketProcessor Base::packetProcessor = nullptr;
 #if TURAG_FELDBUS_SLAVE_BROADCASTS_AVAILABLE
 	Base::BroadcastProcessor Base::broadcastProcessor = nullptr;
+	unsigned Base::responseDelay = 0;
 #endif
 
 
@@ -71,6 +72,10 @@ FeldbusSize_t Base::processPacket(const uint8_t* message, FeldbusSize_t length,
 	// and we can start working on it
 	FeldbusSize_t responseLength;
 
+#if TURAG_FELDBUS_SLAVE_BROADCASTS_AVAILABLE
+	responseDelay = 0;
+#endif
+
 	// Calculate checksum. If it's wrong, ignore packet.
 #if (TURAG_FELDBUS_SLAVE_CONFIG_CRC_TYPE == TURAG_FELDBUS_CHECKSUM_XOR)
 	if (!XOR::check(message, length - 1, message[length - 1]))
@@ -210,6 +215,16 @@ FeldbusSize_t Base::processPacket(const uint8_t* message, FeldbusSize_t length,
 					responseLength = TURAG_FELDBUS_SLAVE_CONFIG_ADDRESS_LENGTH + 1;
 					break;
 				}
+#if TURAG_FELDBUS_SLAVE_CONFIG_MAX_BAUD_RATE && TURAG_FELDBUS_SLAVE_BROADCASTS_AVAILABLE
+				// without broadcasts the baud rate can't be changed, so don't advertise it
+				case TURAG_FELDBUS_DEVICE_COMMAND_GET_MAX_BAUD_RATE: {
+					static_assert(4 + TURAG_FELDBUS_SLAVE_CONFIG_ADDRESS_LENGTH + 1 <= TURAG_FELDBUS_SLAVE_CONFIG_BUFFER_SIZE, "Buffer overflow");
+					const uint32_t maxBaudRate = TURAG_FELDBUS_SLAVE_CONFIG_MAX_BAUD_RATE;
+					std::memcpy(response + TURAG_FELDBUS_SLAVE_CONFIG_ADDRESS_LENGTH, &maxBaudRate, sizeof(maxBaudRate));
+					responseLength = sizeof(maxBaudRate) + TURAG_FELDBUS_SLAVE_CONFIG_ADDRESS_LENGTH + 1;
+					break;
+				}
+#endif
 				default:
 					// unhandled reserved packet with length == 3 + TURAG_FELDBUS_SLAVE_CONFIG_ADDRESS_LENGTH
 					return 0;
@@ -256,6 +271,23 @@ FeldbusSize_t Base::processPacket(const uint8_t* message, FeldbusSize_t length,
 				Driver::resetBoard();
 		}
 #endif		
+#if TURAG_FELDBUS_SLAVE_CONFIG_MAX_BAUD_RATE
+		// address, 0x00, command, baud rate, checksum
+		if (length == 7 + TURAG_FELDBUS_SLAVE_CONFIG_ADDRESS_LENGTH &&
+				message[TURAG_FELDBUS_SLAVE_CONFIG_ADDRESS_LENGTH] == TURAG_FELDBUS_BROADCAST_TO_ALL_DEVICES &&
+				message[1 + TURAG_FELDBUS_SLAVE_CONFIG_ADDRESS_LENGTH] == TURAG_FELDBUS_DEVICE_BROADCAST_SET_BAUD_RATE) {
+			uint32_t baudRate;
+			std::memcpy(&baudRate, message + 2 + TURAG_FELDBUS_SLAVE_CONFIG_ADDRESS_LENGTH, sizeof(baudRate));
+			// devices that can't use the requested rate keep theirs
+			Driver::setBaudRate(baudRate);
+			return 0;
+		}
+#endif
+		if (length > 4 + TURAG_FELDBUS_SLAVE_CONFIG_ADDRESS_LENGTH &&
+				message[TURAG_FELDBUS_SLAVE_CONFIG_ADDRESS_LENGTH] == TURAG_FELDBUS_BROADCAST_TO_ALL_DEVICES &&
+				message[1 + TURAG_FELDBUS_SLAVE_CONFIG_ADDRESS_LENGTH] == TURAG_FELDBUS_DEVICE_BROADCAST_SYNC_READ) {
+			return processSyncRead(message, length, response);
+		}
 		if (broadcastProcessor) {
 			if (length == 1 + TURAG_FELDBUS_SLAVE_CONFIG_ADDRESS_LENGTH) {
 				// compatibility mode to support deprecated Broadcasts without protocol-ID
@@ -274,6 +306,53 @@ FeldbusSize_t Base::processPacket(const uint8_t* message, FeldbusSize_t length,
 #endif
 }
 
+#if TURAG_FELDBUS_SLAVE_BROADCASTS_AVAILABLE
+FeldbusSize_t Base::processSyncRead(const uint8_t* message, FeldbusSize_t length, uint8_t* response) {
+	// address, 0x00, command, slot length, device count, addresses, payload, checksum
+	const unsigned slotLength = message[2 + TURAG_FELDBUS_SLAVE_CONFIG_ADDRESS_LENGTH];
+	const unsigned count = message[3 + TURAG_FELDBUS_SLAVE_CONFIG_ADDRESS_LENGTH];
+	const uint8_t* addresses = message + 4 + TURAG_FELDBUS_SLAVE_CONFIG_ADDRESS_LENGTH;
+	const unsigned payloadOffset = 4 + TURAG_FELDBUS_SLAVE_CONFIG_ADDRESS_LENGTH + count * TURAG_FELDBUS_SLAVE_CONFIG_ADDRESS_LENGTH;
+
+	// we need at least one byte of payload
+	if (!packetProcessor || payloadOffset + 1 >= static_cast<unsigned>(length)) {
+		return 0;
+	}
+
+	// our position in the list defines our time slot
+	unsigned slot = 0;
+	for (; slot < count; ++slot) {
+# if TURAG_FELDBUS_SLAVE_CONFIG_ADDRESS_LENGTH == 1
+		if (addresses[slot] == MY_ADDR) {
+# elif TURAG_FELDBUS_SLAVE_CONFIG_ADDRESS_LENGTH == 2
+		if (addresses[2 * slot] == (MY_ADDR & 0xff) && addresses[2 * slot + 1] == (MY_ADDR >> 8)) {
+# endif
+			break;
+		}
+	}
+	if (slot == count) {
+		return 0;
+	}
+
+	FeldbusSize_t responseLength = packetProcessor(
+			message + payloadOffset,
+			length - (payloadOffset + 1),
+			response + TURAG_FELDBUS_SLAVE_CONFIG_ADDRESS_LENGTH)
+		+ TURAG_FELDBUS_SLAVE_CONFIG_ADDRESS_LENGTH + 1;
+	if (responseLength == 0) {
+		return 0;
+	}
+
+#if TURAG_FELDBUS_SLAVE_CONFIG_CRC_TYPE == TURAG_FELDBUS_CHECKSUM_XOR
+	response[responseLength-1] = XOR::calculate(response, responseLength-1);
+#elif TURAG_FELDBUS_SLAVE_CONFIG_CRC_TYPE == TURAG_FELDBUS_CHECKSUM_CRC8_ICODE
+	response[responseLength-1] = CRC8::calculate(response, responseLength-1);
+#endif
+	responseDelay = slot * slotLength;
+	return responseLength;
+}
+#endif
+
 #if TURAG_FELDBUS_SLAVE_CONFIG_FLASH_LED
 void Base::doLedPattern(unsigned frequency) {
 	if (frequency >= 12) {
@@ -48,6 +48,22 @@
 #include <tina/feldbus/slave/feldbus_config_check.h>
 
 
+/**
+ * @brief Höchste Baudrate, auf die der Master das Gerät umstellen darf.
+ * @ingroup feldbus-slave-base
+ *
+ * Bei 0 bleibt das Gerät immer bei der in der Hardware-Konfiguration angegebenen
+ * Baudrate und beantwortet \ref TURAG_FELDBUS_DEVICE_COMMAND_GET_MAX_BAUD_RATE nicht.
+ * Ansonsten wird die Baudrate bei \ref TURAG_FELDBUS_DEVICE_BROADCAST_SET_BAUD_RATE
+ * mit TURAG::Feldbus::Slave::Driver::setBaudRate() umgestellt. Da dies nur über
+ * einen Broadcast möglich ist, wird die Einstellung ohne
+ * TURAG_FELDBUS_SLAVE_BROADCASTS_AVAILABLE ignoriert.
+ */
+#if !defined(TURAG_FELDBUS_SLAVE_CONFIG_MAX_BAUD_RATE) || defined(__DOXYGEN__)
+# define TURAG_FELDBUS_SLAVE_CONFIG_MAX_BAUD_RATE 0
+#endif
+
+
 namespace TURAG {
 namespace Feldbus {
     
@@ -118,6 +134,24 @@ public:
 	 */
 	static FeldbusSize_t processPacket(const uint8_t* message, FeldbusSize_t message_length, uint8_t* response);
 
+	/**
+	 * @brief Gibt zurück, um wie viele Byte-Zeiten die von processPacket()
+	 * zurückgegebene Antwort verzögert werden muss.
+	 * @return Verzögerung ab dem Ende des empfangenen Pakets in Byte-Zeiten (10 Bit).
+	 *
+	 * Bei einem Sync-Read-Broadcast (\ref TURAG_FELDBUS_DEVICE_BROADCAST_SYNC_READ)
+	 * antworten mehrere Slaves nacheinander in festen Zeitschlitzen. Der plattformabhängige
+	 * Teil des Slave-Treibers muss vor dem Senden der Antwort entsprechend lange warten.
+	 * Bei allen anderen Paketen ist die Verzögerung 0.
+	 */
+	static unsigned responseDelayFrames(void) {
+#if TURAG_FELDBUS_SLAVE_BROADCASTS_AVAILABLE
+		return responseDelay;
+#else
+		return 0;
+#endif
+	}
+
 #if TURAG_FELDBUS_SLAVE_CONFIG_FLASH_LED || defined(__DOXYGEN__)
 	/**
 	 * @brief Erzeugt das charakteristische Feldbus-Blinkmuster.
@@ -173,6 +207,9 @@ private:
 	static PacketProcessor packetProcessor;
 	#if TURAG_FELDBUS_SLAVE_BROADCASTS_AVAILABLE
 		static BroadcastProcessor broadcastProcessor;
+		static unsigned responseDelay;
+
+		static FeldbusSize_t processSyncRead(const uint8_t* message, FeldbusSize_t message_length, uint8_t* response);
 	#endif
 
 	static Info info;
@@ -1,5 +1,6 @@
 #include <cstring>
 #include <algorithm>
+#include <tina++/crc/fnv.h>
 #include "feldbus_slave_stellantriebe.h"
 
 #if (TURAG_FELDBUS_DEVICE_PROTOCOL==TURAG_FELDBUS_DEVICE_PROTOCOL_STELLANTRIEBE) || defined(__DOXYGEN__)
@@ -11,7 +12,9 @@ namespace Slave {
 Base::PacketProcessor Stellantriebe::backup_packet_processor_ = nullptr;
 const Stellantriebe::Command* Stellantriebe::command_set_ = nullptr;
 size_t Stellantriebe::command_set_size_ = 0;
-std::array<const Stellantriebe::Command*, TURAG_FELDBUS_STELLANTRIEBE_STRUCTURED_OUTPUT_BUFFER_SIZE> Stellantriebe::structured_output_table_;
+uint32_t Stellantriebe::command_set_hash_ = 0;
+const Stellantriebe::DispatchEntry* Stellantriebe::dispatch_table_ = nullptr;
+std::array<Stellantriebe::OutputSegment, TURAG_FELDBUS_STELLANTRIEBE_STRUCTURED_OUTPUT_BUFFER_SIZE> Stellantriebe::structured_output_table_;
 size_t Stellantriebe::structured_output_table_size_;
 Stellantriebe::CommandUpdateHandler Stellantriebe::command_update_handler_ = nullptr;
 
@@ -24,67 +27,47 @@ FeldbusSize_t Stellantriebe::process_feldbus_packet(const uint8_t* message, Feld
 
     if (index < command_set_size_)
     {
-        const Command &command = command_set_[index];
+        const DispatchEntry &entry = dispatch_table_[index];
 
         if (message_length == 1)
         {
             // read request
-            switch (command.info.type)
-            {
-            case CommandType::CHAR:
-            {
-                int8_t tmp = *static_cast<int8_t*>(command.value);
-                memcpy(response, &tmp, get_command_length(CommandType::CHAR));
-                return get_command_length(CommandType::CHAR);
-            }
-            case CommandType::SHORT:
-            {
-                int16_t tmp = *static_cast<int16_t*>(command.value);
-                memcpy(response, &tmp, get_command_length(CommandType::SHORT));
-                return get_command_length(CommandType::SHORT);
-            }
-            case CommandType::LONG:
-            {
-                int32_t tmp = *static_cast<int32_t*>(command.value);
-                memcpy(response, &tmp, get_command_length(CommandType::LONG));
-                return get_command_length(CommandType::LONG);
-            }
-            case CommandType::FLOAT:
-            {
-                float tmp = *static_cast<float*>(command.value);
-                memcpy(response, &tmp, get_command_length(CommandType::FLOAT));
-                return get_command_length(CommandType::FLOAT);
-            }
-            default:
+            if (!entry.length)
                 return TURAG_FELDBUS_IGNORE_PACKAGE;
-            }
+
+            memcpy(response, entry.value, entry.length);
+            return entry.length;
         }
         else if (message_length != 4)
         {
             // write request
-
-            if (command.info.access != Stellantriebe::Access::WRITE
-                || command.info.type == Stellantriebe::CommandType::NONE
-                || command.info.type == Stellantriebe::CommandType::NONE_TEXT)
-            {
+            if (!entry.writable)
                 return TURAG_FELDBUS_IGNORE_PACKAGE;
-            }
 
-            memset(command.value, 0, get_command_length(command.info.type));
-            size_t data_len = std::min<size_t>(message_length - 1, get_command_length(command.info.type));
-            memcpy(command.value, &message[1], data_len);
+            memset(entry.value, 0, entry.length);
+            size_t data_len = std::min<size_t>(message_length - 1, entry.length);
+            memcpy(entry.value, &message[1], data_len);
             if (command_update_handler_)
-                command_update_handler_(command);
+                command_update_handler_(command_set_[index]);
             return 0;
         }
         else
         {
+            // command info requests are only used during initialisation
+            const Command &command = command_set_[index];
+
             if (message[1] == TURAG_FELDBUS_STELLANTRIEBE_COMMAND_INFO_GET_COMMANDSET_SIZE)
             {
                 // return length of command set
                 response[0] = command_set_size_;
                 return 1;
             }
+            else if (message[1] == TURAG_FELDBUS_STELLANTRIEBE_COMMAND_INFO_GET_COMMANDSET_HASH)
+            {
+                // return fingerprint of command set
+                memcpy(response, &command_set_hash_, sizeof(command_set_hash_));
+                return sizeof(command_set_hash_);
+            }
             else if (message[1] == TURAG_FELDBUS_STELLANTRIEBE_COMMAND_INFO_GET)
             {
                 // command info request
@@ -122,6 +105,61 @@ FeldbusSize_t Stellantriebe::process_feldbus_packet(const uint8_t* message, Feld
             }
         }
     }
+    else if (message[0] == TURAG_FELDBUS_STELLANTRIEBE_MULTI_ACCESS && message_length >= 2)
+    {
+        // The whole request is checked before anything is written, so an
+        // invalid request does not leave half of its values applied.
+        const size_t write_count = message[1];
+        size_t pos = 2;
+        for (size_t i = 0; i < write_count; ++i)
+        {
+            if (pos >= message_length)
+                return TURAG_FELDBUS_IGNORE_PACKAGE;
+
+            uint8_t value_index = message[pos] - 1;
+            if (value_index >= command_set_size_ || !dispatch_table_[value_index].writable)
+                return TURAG_FELDBUS_IGNORE_PACKAGE;
+
+            pos += 1 + dispatch_table_[value_index].length;
+        }
+        if (pos > message_length)
+            return TURAG_FELDBUS_IGNORE_PACKAGE;
+
+        const size_t reads_start = pos;
+        size_t response_length = 0;
+        for (; pos < message_length; ++pos)
+        {
+            uint8_t value_index = message[pos] - 1;
+            if (value_index >= command_set_size_)
+                return TURAG_FELDBUS_IGNORE_PACKAGE;
+
+            size_t length = dispatch_table_[value_index].length;
+            response_length += length;
+            if (!length || response_length > TURAG_FELDBUS_SLAVE_CONFIG_BUFFER_SIZE - (TURAG_FELDBUS_SLAVE_CONFIG_ADDRESS_LENGTH + 1))
+                return TURAG_FELDBUS_IGNORE_PACKAGE;
+        }
+
+        // apply writes
+        pos = 2;
+        for (size_t i = 0; i < write_count; ++i)
+        {
+            const DispatchEntry &entry = dispatch_table_[message[pos] - 1];
+            memcpy(entry.value, &message[pos + 1], entry.length);
+            if (command_update_handler_)
+                command_update_handler_(command_set_[message[pos] - 1]);
+            pos += 1 + entry.length;
+        }
+
+        // reads
+        uint8_t *out = response;
+        for (pos = reads_start; pos < message_length; ++pos)
+        {
+            const DispatchEntry &entry = dispatch_table_[message[pos] - 1];
+            memcpy(out, entry.value, entry.length);
+            out += entry.length;
+        }
+        return out - response;
+    }
     else if (message[0] == TURAG_FELDBUS_STELLANTRIEBE_STRUCTURED_OUTPUT_GET)
     {
         if (message_length == 1)
@@ -136,10 +174,10 @@ FeldbusSize_t Stellantriebe::process_feldbus_packet(const uint8_t* message, Feld
             // into the bufer, so there is no check required either.
             for (size_t i = 0; i < structured_output_table_size_; ++i)
             {
-                const Command &command = *structured_output_table_[i];
+                const OutputSegment &segment = structured_output_table_[i];
 
-                memcpy(out, command.value, get_command_length(command.info.type));
-                out += get_command_length(command.info.type);
+                memcpy(out, segment.value, segment.length);
+                out += segment.length;
             }
             return out - response;
         }
@@ -148,9 +186,11 @@ FeldbusSize_t Stellantriebe::process_feldbus_packet(const uint8_t* message, Feld
             if (message[1] == TURAG_FELDBUS_STELLANTRIEBE_STRUCTURED_OUTPUT_SET_STRUCTURE)
             {
                 // update structure table
+                // Values which lie next to each other in memory are merged
+                // into one segment, so they are copied with a single memcpy().
                 int8_t i, error = 0;
                 uint8_t size_sum = 0, value_index;
-                //feldbus_stellantriebe_command_t *command;
+                size_t segments = 0;
 
                 // cancel if the request is too long
                 if (message_length - 2 > TURAG_FELDBUS_STELLANTRIEBE_STRUCTURED_OUTPUT_BUFFER_SIZE)
@@ -169,17 +209,27 @@ FeldbusSize_t Stellantriebe::process_feldbus_packet(const uint8_t* message, Feld
                         error = 1;
                         break;
                     }
-                    const Command &command = command_set_[value_index];
+                    const DispatchEntry &entry = dispatch_table_[value_index];
 
                     // cancel if the host demands a non-supported key
-                    if (!get_command_length(command.info.type))
+                    if (!entry.length)
                     {
                         error = 1;
                         break;
                     }
 
-                    structured_output_table_[i - 2] = &command;
-                    size_sum += get_command_length(command.info.type);
+                    if (segments > 0 &&
+                        structured_output_table_[segments - 1].value + structured_output_table_[segments - 1].length == entry.value)
+                    {
+                        structured_output_table_[segments - 1].length += entry.length;
+                    }
+                    else
+                    {
+                        structured_output_table_[segments].value = entry.value;
+                        structured_output_table_[segments].length = entry.length;
+                        ++segments;
+                    }
+                    size_sum += entry.length;
 
                     // cancel if whole package would not fit into buffer
                     if (size_sum >= TURAG_FELDBUS_SLAVE_CONFIG_BUFFER_SIZE)
@@ -197,7 +247,7 @@ FeldbusSize_t Stellantriebe::process_feldbus_packet(const uint8_t* message, Feld
                 }
                 else
                 {
-                    structured_output_table_size_ = message_length - 2;
+                    structured_output_table_size_ = segments;
                     response[0] = TURAG_FELDBUS_STELLANTRIEBE_STRUCTURED_OUTPUT_TABLE_OK;
                     return 1;
                 }
@@ -222,6 +272,22 @@ FeldbusSize_t Stellantriebe::process_feldbus_packet(const uint8_t* message, Feld
     }
 }
 
+uint32_t Stellantriebe::calculate_command_set_hash(void)
+{
+    static_assert(sizeof(CommandInfo) == 6, "CommandInfo must be 6 bytes long!");
+
+    uint32_t hash = FNV1a::initialValue;
+    for (size_t i = 0; i < command_set_size_; ++i)
+    {
+        const Command &command = command_set_[i];
+        const char *name = command.name ? command.name : "";
+
+        hash = FNV1a::update(hash, &command.info, sizeof(CommandInfo));
+        hash = FNV1a::update(hash, name, strlen(name) + 1);
+    }
+    return hash;
+}
+
 } // namespace Slave
 } // namespace Feldbus
 } // namespace TURAG
@@ -172,11 +172,22 @@ public:
             Base::PacketProcessor packetProcessor = nullptr,
             Base::BroadcastProcessor broadcastProcessor = nullptr)
     {
+        // one dispatch table per command set size
+        static DispatchEntry dispatch_table[N];
+
         Base::init(&Stellantriebe::process_feldbus_packet, broadcastProcessor);
         backup_packet_processor_ = packetProcessor;
         command_update_handler_ = commandUpdateHandler;
         command_set_ = commands;
         command_set_size_ = N;
+        command_set_hash_ = calculate_command_set_hash();
+
+        for (size_t i = 0; i < N; ++i)
+        {
+            dispatch_table[i] = make_dispatch_entry(commands[i]);
+        }
+        dispatch_table_ = dispatch_table;
+        structured_output_table_size_ = 0;
     }
 
     /**
@@ -193,16 +204,44 @@ public:
 private:
     Stellantriebe();
 
+    // Command resolved for processing packets, indexed by key - 1.
+    struct DispatchEntry
+    {
+        uint8_t *value;
+        uint8_t length;     // 0 if the command has no value
+        bool writable;
+    };
+
+    // Adjacent values of the structured output are copied at once.
+    struct OutputSegment
+    {
+        const uint8_t *value;
+        uint16_t length;
+    };
+
+    static DispatchEntry make_dispatch_entry(const Command &command)
+    {
+        DispatchEntry entry;
+        entry.value = static_cast<uint8_t*>(command.value);
+        entry.length = get_command_length(command.info.type);
+        entry.writable = command.info.access == Access::WRITE && entry.length;
+        return entry;
+    }
+
+    static uint32_t calculate_command_set_hash(void);
+
     static Base::PacketProcessor backup_packet_processor_;
     static CommandUpdateHandler command_update_handler_;
 
     static const Command* command_set_;
+    static const DispatchEntry* dispatch_table_;
     static std::array<
-        const Command*,
+        OutputSegment,
         TURAG_FELDBUS_STELLANTRIEBE_STRUCTURED_OUTPUT_BUFFER_SIZE
     > structured_output_table_;
 
     static size_t command_set_size_;
+    static uint32_t command_set_hash_;
     static size_t structured_output_table_size_;
 };
 
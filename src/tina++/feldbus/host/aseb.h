@@ -322,6 +322,7 @@ public:
 
 	
 private:
+	void storeMetadataInCache(void);
 	bool initDigitalOutputBuffer(void);
 	bool initPwmOutputBuffer(void);
 
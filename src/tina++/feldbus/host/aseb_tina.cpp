@@ -12,9 +12,11 @@
 #if TURAG_USE_TURAG_FELDBUS_HOST
 
 #include "aseb.h"
+#include "feldbus_metadatacache.h"
 
 #include <tina/debug.h>
 #include <cmath>
+#include <cstring>
 
 
 namespace TURAG {
@@ -51,6 +53,24 @@ struct AsebGetPwmFrequency {
     uint32_t frequency;
 } TURAG_PACKED;
 
+// Layout of the metadata in the MetadataCache. The sizes are followed
+// by the analog factors and the max value and frequency of each pwm output.
+struct AsebCachedSizes {
+    uint8_t digitalInputs;
+    uint8_t digitalOutputs;
+    // 0xFF if not read during the initialization
+    uint8_t analogInputs;
+    uint8_t pwmOutputs;
+    uint8_t sync;
+} TURAG_PACKED;
+
+struct AsebCachedPwm {
+    uint16_t maxValue;
+    uint32_t frequency;
+} TURAG_PACKED;
+
+constexpr uint8_t asebNotCached = 0xFF;
+
 
 bool ASEBBase::initialize(uint8_t* sync_buffer, unsigned sync_buffer_size,
                       Analog_t* analogInputs, unsigned analogInputSize,
@@ -60,6 +80,47 @@ bool ASEBBase::initialize(uint8_t* sync_buffer, unsigned sync_buffer_size,
 	// at least one once the initialization was successfully completed.
     syncSize_ = 0;
 
+    // Everything but the current output values can be taken
+    // from the metadata cache if the device is known.
+    uint8_t cache[TURAG_FELDBUS_METADATACACHE_MAX_DATA];
+    const AsebCachedSizes* cachedSizes = nullptr;
+    const uint8_t* cachedAnalog = nullptr;
+    const uint8_t* cachedPwm = nullptr;
+    int cachedLength = loadCachedMetadata(cache, sizeof(cache));
+    if (cachedLength >= static_cast<int>(sizeof(AsebCachedSizes))) {
+        cachedSizes = reinterpret_cast<const AsebCachedSizes*>(cache);
+        const bool hasAnalog = cachedSizes->analogInputs != asebNotCached;
+        const bool hasPwm = cachedSizes->pwmOutputs != asebNotCached;
+        const int expectedLength = sizeof(AsebCachedSizes) +
+                (hasAnalog ? cachedSizes->analogInputs * sizeof(float) : 0) +
+                (hasPwm ? cachedSizes->pwmOutputs * sizeof(AsebCachedPwm) : 0);
+
+        if (cachedLength != expectedLength || (analogInputs && !hasAnalog) || (pwmOutputs && !hasPwm)) {
+            cachedSizes = nullptr;
+        } else {
+            // The fingerprint of the cache does not cover the channel configuration
+            // of the firmware. The sync size depends on all of it, so one request
+            // is enough to detect a firmware that changed behind its back.
+            int syncSize = 0;
+            if (!getSyncSize(&syncSize)) return false;
+            // keep signaling an unfinished initialization
+            syncSize_ = 0;
+
+            if (syncSize != cachedSizes->sync) {
+                turag_warningf("%s: sync size changed (%d != %d), cached metadata discarded",
+                               name(), syncSize, cachedSizes->sync);
+                cachedSizes = nullptr;
+            } else {
+                digitalInputSize_ = cachedSizes->digitalInputs;
+                digitalOutputSize_ = cachedSizes->digitalOutputs;
+                if (hasAnalog) analogInputSize_ = cachedSizes->analogInputs;
+                if (hasPwm) pwmOutputSize_ = cachedSizes->pwmOutputs;
+                cachedAnalog = cache + sizeof(AsebCachedSizes);
+                cachedPwm = cachedAnalog + (hasAnalog ? cachedSizes->analogInputs * sizeof(float) : 0);
+            }
+        }
+    }
+
     int sizeBuffer = 0;
     if (!getDigitalInputSize(&sizeBuffer)) return false;
     if (!getDigitalOutputSize(&sizeBuffer)) return false;
@@ -84,6 +145,12 @@ bool ASEBBase::initialize(uint8_t* sync_buffer, unsigned sync_buffer_size,
         Response<AsebGetAnalogFactor> response;
 
         for (int i = 0; i < analogInputSize_; ++i) {
+            if (cachedSizes) {
+                memcpy(&analogInputs_[i].factor, cachedAnalog, sizeof(float));
+                cachedAnalog += sizeof(float);
+                continue;
+            }
+
             request.data.index = i + TURAG_FELDBUS_ASEB_INDEX_START_ANALOG_INPUT;
 
             if (!transceive(request, &response)) return false;
@@ -114,6 +181,15 @@ bool ASEBBase::initialize(uint8_t* sync_buffer, unsigned sync_buffer_size,
         Response<AsebGetPwmFrequency> frequency_response;
 
         for (int i = 0; i < pwmOutputSize_; ++i) {
+            if (cachedSizes) {
+                AsebCachedPwm pwm;
+                memcpy(&pwm, cachedPwm, sizeof(pwm));
+                cachedPwm += sizeof(pwm);
+                pwmOutputs_[i].max_value = pwm.maxValue;
+                pwmOutputs_[i].frequency = pwm.frequency;
+                continue;
+            }
+
             request.data.index = i + TURAG_FELDBUS_ASEB_INDEX_START_PWM_OUTPUT;
 
             request.data.command = TURAG_FELDBUS_ASEB_PWM_OUTPUT_MAX_VALUE;
@@ -135,7 +211,11 @@ bool ASEBBase::initialize(uint8_t* sync_buffer, unsigned sync_buffer_size,
 		turag_errorf("%s: sync_buffer is null", name());
 		return false;
     }
-    if (!getSyncSize(&sizeBuffer)) return false;
+    if (cachedSizes) {
+        sizeBuffer = cachedSizes->sync;
+    } else if (!getSyncSize(&sizeBuffer)) {
+        return false;
+    }
     if (static_cast<int>(sync_buffer_size) < sizeBuffer) {
         turag_errorf("%s: sync buffer size must be %d (is %d)", name(), sizeBuffer, sync_buffer_size);
         return false;
@@ -144,6 +224,11 @@ bool ASEBBase::initialize(uint8_t* sync_buffer, unsigned sync_buffer_size,
 		turag_warningf("%s: sync buffer larger than required (%d > %d)", name(), sync_buffer_size, sizeBuffer);
     }
     syncBuffer_ = sync_buffer;
+    syncSize_ = sizeBuffer;
+
+    if (!cachedSizes) {
+        storeMetadataInCache();
+    }
 
     if (!initDigitalOutputBuffer()) return false;
     if (!initPwmOutputBuffer()) return false;
@@ -152,6 +237,41 @@ bool ASEBBase::initialize(uint8_t* sync_buffer, unsigned sync_buffer_size,
 }
 	
 
+void ASEBBase::storeMetadataInCache(void) {
+    uint8_t cache[TURAG_FELDBUS_METADATACACHE_MAX_DATA];
+
+    AsebCachedSizes sizes;
+    sizes.digitalInputs = static_cast<uint8_t>(digitalInputSize_);
+    sizes.digitalOutputs = static_cast<uint8_t>(digitalOutputSize_);
+    sizes.analogInputs = analogInputs_ ? static_cast<uint8_t>(analogInputSize_) : asebNotCached;
+    sizes.pwmOutputs = pwmOutputs_ ? static_cast<uint8_t>(pwmOutputSize_) : asebNotCached;
+    sizes.sync = static_cast<uint8_t>(syncSize_);
+
+    const unsigned length = sizeof(sizes) +
+            (analogInputs_ ? analogInputSize_ * sizeof(float) : 0) +
+            (pwmOutputs_ ? pwmOutputSize_ * sizeof(AsebCachedPwm) : 0);
+    if (length > sizeof(cache)) {
+        return;
+    }
+
+    uint8_t* data = cache;
+    memcpy(data, &sizes, sizeof(sizes));
+    data += sizeof(sizes);
+    for (int i = 0; analogInputs_ && i < analogInputSize_; ++i) {
+        memcpy(data, &analogInputs_[i].factor, sizeof(float));
+        data += sizeof(float);
+    }
+    for (int i = 0; pwmOutputs_ && i < pwmOutputSize_; ++i) {
+        AsebCachedPwm pwm;
+        pwm.maxValue = pwmOutputs_[i].max_value;
+        pwm.frequency = pwmOutputs_[i].frequency;
+        memcpy(data, &pwm, sizeof(pwm));
+        data += sizeof(pwm);
+    }
+
+    storeCachedMetadata(cache, length);
+}
+
 bool ASEBBase::getDigitalOutputSize(int* size) {
     if (digitalOutputSize_ == -1) {
         Request<uint8_t> request;
@@ -243,7 +363,7 @@ bool ASEBBase::sync(void) {
         uint8_t request[myAddressLength + 1 + 1];
         request[myAddressLength] = TURAG_FELDBUS_ASEB_SYNC;
 
-        if (!transceive(request,
+        if (!coalescedTransceive(request,
                         sizeof(request),
 						syncBuffer_,
                         syncSize_)) {
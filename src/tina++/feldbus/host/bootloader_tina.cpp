@@ -99,24 +99,17 @@ bool Bootloader::receiveString(uint8_t command, uint8_t stringLength, char* out_
         return false;
     }
 
-    // because we receive a packet including address and checksum
-    // we need a slightly bigger array.
-    char recvBuffer[stringLength + myAddressLength + 1];
+    Packet<PacketLayout<uint8_t>> request;
+    request.set<0>(command);
 
+    // the string is the variable length part of the response
+    Packet<PacketLayout<>, 255> response;
 
-    uint8_t request[myAddressLength + 1 + 1];
-    request[myAddressLength] = command;
-
-    if (!transceive(request,
-                      sizeof(request),
-                      reinterpret_cast<uint8_t*>(recvBuffer),
-                      stringLength + myAddressLength + 1)) {
+    if (!transceive(request, response, 0, stringLength)) {
         return false;
     }
 
-    for (int i = 0; i < stringLength; ++i) {
-        out_string[i] = recvBuffer[i + myAddressLength];
-    }
+    std::memcpy(out_string, response.tail(), stringLength);
     out_string[stringLength] = 0;
 
     return true;
@@ -229,35 +222,35 @@ BootloaderAvrBase::ErrorCode BootloaderAvrBase::writeFlash(uint32_t byteAddress,
 		++pages;
 	}
 	
-    uint8_t request[myAddressLength + 1 + 4 + myPageSize + 1];
-    request[myAddressLength] = TURAG_FELDBUS_BOOTLOADER_AVR_PAGE_WRITE;
-	
-    uint8_t response[myAddressLength + 1 + 1];
+    // command, target address and the page as variable length part
+    typedef PacketLayout<uint8_t, uint32_t> PageWriteRequest;
+    uint8_t requestBuffer[PageWriteRequest::length(myPageSize)];
+    PacketView<PageWriteRequest> request(requestBuffer);
+    request.set<0>(TURAG_FELDBUS_BOOTLOADER_AVR_PAGE_WRITE);
+
+    Packet<PacketLayout<uint8_t>> response;
 	
     byteAddress |= getFlashBaseAddress();
 	uint32_t targetAddress = byteAddress;
 	
-	struct uint32_t_packed {
-		uint32_t value;
-	} TURAG_PACKED;
-	
 	for (unsigned i = 0; i < pages; ++i) {
-        reinterpret_cast<uint32_t_packed*>(request + myAddressLength + 1)->value = targetAddress;
+        request.set<1>(targetAddress);
 
 		uint16_t currentPageSize = std::min(myPageSize, static_cast<uint16_t>(byteAddress + length - targetAddress));
-        memcpy(request + myAddressLength + 5, data, currentPageSize);
+        memcpy(request.tail(), data, currentPageSize);
 		
 		unsigned k = 0;
 		for (k = 0; k < maxTriesForWriting; ++k) {
-            if (!transceive(request, sizeof(request), response, sizeof(response))) {
+            if (!transceive(request, response, myPageSize)) {
 				return ErrorCode::transceive_error;
 			}
-            if (response[myAddressLength] == TURAG_FELDBUS_BOOTLOADER_AVR_RESPONSE_SUCCESS) {
+            const uint8_t result = response.get<0>();
+            if (result == TURAG_FELDBUS_BOOTLOADER_AVR_RESPONSE_SUCCESS) {
 				break;
-            } else if (response[myAddressLength] == TURAG_FELDBUS_BOOTLOADER_AVR_RESPONSE_FAIL_CONTENT) {
+            } else if (result == TURAG_FELDBUS_BOOTLOADER_AVR_RESPONSE_FAIL_CONTENT) {
 				continue;
 			} else {
-                return static_cast<ErrorCode>(response[myAddressLength]);
+                return static_cast<ErrorCode>(result);
 			}
 		}
 		// we give up after a few tries.
@@ -290,42 +283,40 @@ BootloaderAvrBase::ErrorCode BootloaderAvrBase::readFlash(uint32_t byteAddress,
 		return ErrorCode::invalid_args;
 	}
 	
-    uint32_t packetSize = myExtendedDeviceInfo.bufferSize() - myAddressLength - 1 - 1;
+    // command and the data as variable length part
+    typedef PacketLayout<uint8_t> DataReadResponse;
+    uint32_t packetSize = myExtendedDeviceInfo.bufferSize() - DataReadResponse::size;
 	
 	unsigned packets = length / packetSize;
 	if (length % packetSize) {
 		++packets;
 	}
 
-    uint8_t request[myAddressLength + 1 + 4 + 2 + 1];
-    request[myAddressLength] = TURAG_FELDBUS_BOOTLOADER_AVR_DATA_READ;
+    // command, target address, size
+    Packet<PacketLayout<uint8_t, uint32_t, uint16_t>> request;
+    request.set<0>(TURAG_FELDBUS_BOOTLOADER_AVR_DATA_READ);
 	
     byteAddress |= getFlashBaseAddress();
     uint32_t targetAddress = byteAddress;
-	
-	struct header_packed {
-		uint32_t targetAddress;
-		uint16_t currentPacketSize;
-	} TURAG_PACKED;
 
 	for (unsigned i = 0; i < packets; ++i) {
 		uint16_t currentPacketSize = std::min(packetSize, byteAddress + length - targetAddress);
-		
 
-        reinterpret_cast<header_packed*>(request + myAddressLength + 1)->targetAddress = targetAddress;
-        reinterpret_cast<header_packed*>(request + myAddressLength + 1)->currentPacketSize = currentPacketSize;
+        request.set<1>(targetAddress);
+        request.set<2>(currentPacketSize);
 
-        uint8_t response[myAddressLength + 1 + currentPacketSize + 1];
+        uint8_t responseBuffer[DataReadResponse::length(currentPacketSize)];
+        PacketView<DataReadResponse> response(responseBuffer);
 		
-        if (!transceive(request, sizeof(request), response, sizeof(response))) {
+        if (!transceive(request, response, 0, currentPacketSize)) {
 			return ErrorCode::transceive_error;
 		}
 		// this shouldn't happen
-        if (response[myAddressLength] == TURAG_FELDBUS_BOOTLOADER_AVR_RESPONSE_FAIL_ADDRESS) {
+        if (response.get<0>() == TURAG_FELDBUS_BOOTLOADER_AVR_RESPONSE_FAIL_ADDRESS) {
 			return ErrorCode::invalid_address;
 		}
 		
-        memcpy(buffer, response + myAddressLength + 1, currentPacketSize);
+        memcpy(buffer, response.tail(), currentPacketSize);
 		
 		targetAddress += currentPacketSize;
 		buffer += currentPacketSize;
@@ -17,6 +17,7 @@
 #include <tina++/tina.h>
 #include <tina/feldbus/protocol/turag_feldbus_bus_protokoll.h>
 #include "feldbus_basedevice.h"
+#include "feldbus_packet.h"
 
 
 #if !TURAG_USE_TURAG_FELDBUS_HOST
@@ -113,6 +114,10 @@ namespace TURAG {
  */
 namespace Feldbus {
 
+class MetadataCache;
+class RequestCoalescer;
+class HealthMonitor;
+
 
 /**
  * \brief Basis-Klasse aller Feldbus-Geräte.
@@ -144,6 +149,10 @@ class Device : public BaseDevice {
     Device(const Device&) = delete;
     Device& operator=(const Device&) = delete;
 
+    friend class RequestCoalescer;
+    // walks the device list under listMutex
+    friend class HealthMonitor;
+
 public:
     /*!
      * \brief Speichert das Device-Info-Paket eines Slave-Gerätes.
@@ -252,10 +261,37 @@ public:
 	 * werden (auch dann, wenn forceUpdate benutzt wird!). Gibt diese Funktion false zurück
 	 * obwohl das Gerät funktionieren sollte, so kann entweder mit clearTransmissionCounters()
 	 * der interne Fehler-Counter zurückgesetzt oder versucht werden, mit sendPing()
-	 * das Gerät zu erreichen.
+	 * das Gerät zu erreichen. Letzteres übernimmt ein HealthMonitor automatisch.
+	 *
+	 * \see availability()
 	 */
     bool isAvailable(bool forceUpdate = false);
 
+    /// Verfügbarkeitszustand eines Gerätes.
+    enum class Availability : uint8_t {
+        /// Es wurde noch keine Übertragung mit Antwort durchgeführt.
+        unknown,
+        /// Das Gerät hat geantwortet und ist nicht dysfunktional.
+        available,
+        /// Das Gerät ist dysfunktional.
+        unavailable
+    };
+
+    /**
+     * \brief Gibt den Verfügbarkeitszustand des Gerätes zurück.
+     *
+     * Im Gegensatz zu isAvailable() verursacht diese Funktion nie Buslast und
+     * blockiert nicht. Zusammen mit einem HealthMonitor, der unbekannte Geräte prüft
+     * und dysfunktionale Geräte im Hintergrund zurückholt, kann damit auf blockierende
+     * Aufrufe von isAvailable() beim Start verzichtet werden.
+     */
+    Availability availability(void) const {
+        if (isDysfunctional()) {
+            return Availability::unavailable;
+        }
+        return hasCheckedAvailabilityYet ? Availability::available : Availability::unknown;
+    }
+
     /**
 	 * @brief Gibt den Namen des Gerätes zurück.
 	 * @return Name des Gerätes.
@@ -380,6 +416,17 @@ public:
 	 */
     bool receiveAllSlaveErrorCount(uint32_t* counts);
 
+    /**
+	 * \brief Fragt die höchste Baudrate ab, auf die das Gerät umgestellt werden kann.
+	 * \param[out] baudRate Puffer in dem der Wert gespeichert wird.
+	 * \return True bei Erfolg, ansonsten false.
+	 *
+	 * Ältere Geräte und Geräte, die ihre Baudrate nicht wechseln können,
+	 * antworten nicht, sodass die Abfrage fehlschlägt.
+	 * \see BaudRateNegotiator
+	 */
+    bool receiveMaxBaudRate(uint32_t* baudRate);
+
     /**
 	 * \brief Weist das Gerät an, seine internen Paketstatistiken zurückzusetzen.
 	 * \return True bei Erfolg, anonsten false.
@@ -443,6 +490,16 @@ public:
 	 */
     unsigned int getTotalTransmissions(void) const { return myTotalTransmissions; }
 
+    /**
+	 * \brief Gibt die Anzahl der Übertragungen zurück, die wegen einer abgelaufenen
+	 * Deadline verworfen wurden.
+	 * \return Anzahl der verworfenen Übertragungen.
+	 *
+	 * Verworfene Übertragungen zählen nicht als Fehler des Gerätes.
+	 * \see BaseDevice::setTransmissionPriority()
+	 */
+    unsigned int getDeadlineMisses(void) const { return myTotalDeadlineMisses; }
+
     /**
 	 * \brief Setzt die Error-Counter und den Übertragungs-Counter auf null zurück.
 	 * 
@@ -458,10 +515,14 @@ public:
         myTotalNoAnswerErrors = 0;
         myTotalMissingDataErrors = 0;
         myTotalTransmitErrors = 0;
+        myTotalDeadlineMisses = 0;
         myTotalTransmissions = 0;
         myCurrentErrorCounter = 0;
         hasCheckedAvailabilityYet = false;
         dysFunctionalLog_.resetAll();
+#if TURAG_FELDBUS_DEVICE_CONFIG_LATENCY_STATISTICS
+        resetLatencyStatistics();
+#endif
     }
 
 
@@ -552,6 +613,31 @@ public:
         return myNextDevice;
     }
 
+    /**
+     * \brief Setzt den Cache für Gerätemetadaten aller Geräte.
+     * \param cache Cache oder nullptr, um keinen Cache zu benutzen.
+     *
+     * Muss vor der Initialisierung der Geräte aufgerufen werden.
+     * \see MetadataCache
+     */
+    static void setMetadataCache(MetadataCache* cache) {
+        metadataCache = cache;
+    }
+
+    /**
+     * \brief Fasst identische Leseanfragen dieses Gerätes zusammen.
+     * \param coalescer Coalescer oder nullptr, um jede Anfrage einzeln zu senden.
+     *
+     * Darf nicht geändert werden, während Übertragungen des Gerätes laufen.
+     * \see RequestCoalescer
+     */
+    void setRequestCoalescer(RequestCoalescer* coalescer) {
+        requestCoalescer_ = coalescer;
+    }
+
+    /// Coalescer des Gerätes oder nullptr.
+    RequestCoalescer* requestCoalescer(void) const { return requestCoalescer_; }
+
 
 protected:
     /*!
@@ -578,6 +664,58 @@ protected:
      */
     bool transceive(uint8_t *transmit, int transmit_length, uint8_t *receive, int receive_length, bool ignoreDysfunctional = false, bool transmitBroadcast = false);
 
+    /*!
+     * \brief Sendet eine Anfrage, die den Zustand des Gerätes nicht ändert.
+     * \param[in] transmit Puffer der zu übertragenden Daten.
+     * \param[in] transmit_length Länge des Puffers.
+     * \param[out] receive Puffer für die Empfangsdaten.
+     * \param[in] receive_length Länge des Empfangspuffers/der erwarteten Daten.
+     * \return True bei erfolgreicher Übertragung.
+     *
+     * Verhält sich wie transceive(), teilt die Antwort aber über den mit
+     * setRequestCoalescer() gesetzten RequestCoalescer mit anderen Aufrufern,
+     * die gleichzeitig dieselbe Anfrage stellen. Ohne Coalescer wird
+     * transceive() aufgerufen.
+     *
+     * \warning Darf nur für Anfragen benutzt werden, die nur lesen, weil
+     * identische Anfragen unter Umständen nicht gesendet werden.
+     */
+    bool coalescedTransceive(uint8_t *transmit, int transmit_length, uint8_t *receive, int receive_length);
+
+    /*!
+     * \brief Sendet eine Anfrage, die den Zustand des Gerätes nicht ändert.
+     * \param[in] transmit Zu sendende Daten, verpackt in einer Request-Struktur.
+     * \param[out] receive Pointer auf eine Response-Struktur, die nach dem Aufruf die
+     * Antwortdaten enthält.
+     * \return True bei erfolgreicher Übertragung.
+     * \see coalescedTransceive(uint8_t*, int, uint8_t*, int)
+     */
+    template <typename T, typename U>
+    TURAG_ALWAYS_INLINE bool coalescedTransceive(Request<T>& transmit, Response<U>* receive) {
+        return coalescedTransceive(
+                    reinterpret_cast<uint8_t*>(&(transmit)), sizeof(Request<T>),
+                    reinterpret_cast<uint8_t*>(receive), sizeof(Response<U>));
+    }
+
+    /*!
+     * \brief Sendet ein Paket und empfängt die Antwort an Ort und Stelle.
+     * \param[in] transmit Anfrage, z.B. ein Packet.
+     * \param[out] receive Puffer für die Antwort, z.B. ein Packet.
+     * \param[in] transmitTail Länge des Datenblocks variabler Länge der Anfrage.
+     * \param[in] receiveTail Länge des Datenblocks variabler Länge der Antwort.
+     * \return True bei erfolgreicher Übertragung.
+     *
+     * Die Längen ergeben sich aus den PacketLayout-Beschreibungen, Adresse und
+     * Checksumme werden wie bei transceive() direkt im Puffer eingetragen.
+     */
+    template<typename RequestLayout, typename ResponseLayout>
+    TURAG_ALWAYS_INLINE bool transceive(PacketView<RequestLayout> transmit, PacketView<ResponseLayout> receive,
+                                        std::size_t transmitTail = 0, std::size_t receiveTail = 0) {
+        return transceive(
+                    transmit.data(), static_cast<int>(RequestLayout::length(transmitTail)),
+                    receive.data(), static_cast<int>(ResponseLayout::length(receiveTail)));
+    }
+
     /**
 	 * \brief Gibt zurück, ob das Gerät als dysfunktional betrachtet wird.
 	 * \return Wenn das Gerät dysfunktional ist true, ansonsten false.
@@ -597,10 +735,33 @@ protected:
 	 */
     bool isDysfunctional(void) const { return myCurrentErrorCounter >= maxTransmissionErrors; }
 
+    /**
+     * \brief Lädt gerätespezifische Metadaten aus dem MetadataCache.
+     * \param[out] data Puffer für die Metadaten.
+     * \param[in] size Größe des Puffers.
+     * \return Länge der Metadaten oder -1, wenn kein passender Eintrag vorhanden ist.
+     *
+     * Ist ein Cache gesetzt, wird dazu falls nötig die Device-Info abgefragt,
+     * um UUID und Firmware-Fingerabdruck zu prüfen. Ohne Cache verursacht die
+     * Funktion keine Buslast.
+     */
+    int loadCachedMetadata(void* data, unsigned size);
+
+    /**
+     * \brief Speichert gerätespezifische Metadaten im MetadataCache.
+     * \param[in] data Metadaten.
+     * \param[in] size Länge der Metadaten.
+     *
+     * Ist kein Cache gesetzt oder die Device-Info noch unbekannt, passiert nichts.
+     */
+    void storeCachedMetadata(const void* data, unsigned size);
+
 
 private:
+    bool transfer(uint8_t *transmit, int transmit_length, uint8_t *receive, int receive_length, bool ignoreDysfunctional = false, bool transmitBroadcast = false);
     bool receiveString(uint8_t command, uint8_t stringLength, char* out_string);
-    bool receiveErrorCount(uint8_t command, uint32_t* buffer);
+    // sends a reserved command answered with a single uint32_t
+    bool receiveUint32(uint8_t command, uint32_t* buffer);
 
 
     // data is ordered to prevent the insertion
@@ -623,6 +784,12 @@ private:
     static Device* firstDevice;
     static Mutex listMutex;
 
+    static MetadataCache* metadataCache;
+    // index of the entry in metadataCache or -1
+    int metadataIndex_;
+
+    RequestCoalescer* requestCoalescer_;
+
     const char* name_;
 
 
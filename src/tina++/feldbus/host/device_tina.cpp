@@ -21,6 +21,8 @@
 #include <cstring>
 
 #include "device.h"
+#include "feldbus_metadatacache.h"
+#include "feldbus_requestcoalescer.h"
 
 
 namespace TURAG {
@@ -71,6 +73,7 @@ struct TURAG_PACKED PackedUint32 {
 
 Mutex Device::listMutex;
 Device* Device::firstDevice(nullptr);
+MetadataCache* Device::metadataCache(nullptr);
 
 
 Device::Device(const char* name, unsigned address, FeldbusAbstraction& feldbus, ChecksumType type,
@@ -79,6 +82,8 @@ Device::Device(const char* name, unsigned address, FeldbusAbstraction& feldbus,
     BaseDevice(feldbus, type, max_transmission_attempts),
 	dysFunctionalLog_(SystemTime::fromSec(5)),
 	myNextDevice(nullptr),
+	metadataIndex_(-1),
+	requestCoalescer_(nullptr),
 	name_(name),
 	maxTransmissionErrors(max_transmission_errors),
 	myCurrentErrorCounter(0),
@@ -102,6 +107,23 @@ Device::Device(const char* name, unsigned address, FeldbusAbstraction& feldbus,
 
  
 bool Device::transceive(uint8_t *transmit, int transmit_length, uint8_t *receive, int receive_length, bool ignoreDysfunctional, bool transmitBroadcast)
+{
+	// anything but a coalesced read might change what the device answers
+	if (requestCoalescer_) {
+		requestCoalescer_->invalidate(*this);
+	}
+	return transfer(transmit, transmit_length, receive, receive_length, ignoreDysfunctional, transmitBroadcast);
+}
+
+bool Device::coalescedTransceive(uint8_t *transmit, int transmit_length, uint8_t *receive, int receive_length)
+{
+	if (!requestCoalescer_ || !receive || !receive_length) {
+		return transceive(transmit, transmit_length, receive, receive_length);
+	}
+	return requestCoalescer_->transceive(*this, transmit, transmit_length, receive, receive_length);
+}
+
+bool Device::transfer(uint8_t *transmit, int transmit_length, uint8_t *receive, int receive_length, bool ignoreDysfunctional, bool transmitBroadcast)
 {
 	bool bailOutBecauseDysfunctional = isDysfunctional() && !ignoreDysfunctional;
 
@@ -157,6 +179,11 @@ bool Device::transceive(uint8_t *transmit, int transmit_length, uint8_t *receive
         turag_warningf("%s: rs485 transceive failed: Checksum error", name_);
         myCurrentErrorCounter += 1;
         return false;
+    case FeldbusAbstraction::ResultStatus::DeadlineMissed:
+        // the package was dropped before it was sent, which
+        // says nothing about the state of the device
+        turag_debugf("%s: rs485 transceive dropped: Deadline missed", name_);
+        return false;
     default:
         // C++ specifies that the range of enums (and enum classes) is the same
         // as the range of the underlying type. So without this default case
@@ -172,11 +199,19 @@ bool Device::sendPing(void) {
 	Request<> request;
 	Response<> response;
 
-	return transceive(request, &response, true);
+	if (!transceive(request, &response, true)) {
+		return false;
+	}
+	hasCheckedAvailabilityYet = true;
+	return true;
 }
 
 bool Device::isAvailable(bool forceUpdate) {
 	if (!hasCheckedAvailabilityYet || forceUpdate) {
+		// Dropped pings don't count as errors, so without
+		// a deadline this loop is guaranteed to terminate.
+		PriorityOverride noDeadline(*this, transmissionPriority());
+
 		while (!isDysfunctional()) {
 			if (sendPing()) {
 				break;
@@ -224,6 +259,25 @@ bool Device::getDeviceInfo(DeviceInfo* device_info) {
         myDeviceInfo.crcDataField_ = response.data.crcDataField;
         myDeviceInfo.uptimeFrequency_ = response.data.uptimeFrequency;
 
+        // The device info is the one request needed to validate the cache.
+        // Everything else can be taken from there if the firmware is unchanged.
+        if (metadataCache) {
+            metadataIndex_ = metadataCache->acquire(myDeviceInfo.uuid(), MetadataCache::fingerprint(myDeviceInfo));
+            if (metadataIndex_ >= 0) {
+                if (myDeviceInfo.legacyDeviceInfoPacket()) {
+                    metadataCache->setExtendedInfo(metadataIndex_,
+                                                   myExtendedDeviceInfo.nameLength_,
+                                                   myExtendedDeviceInfo.versioninfoLength_,
+                                                   myExtendedDeviceInfo.bufferSize_);
+                } else {
+                    metadataCache->getExtendedInfo(metadataIndex_,
+                                                   &myExtendedDeviceInfo.nameLength_,
+                                                   &myExtendedDeviceInfo.versioninfoLength_,
+                                                   &myExtendedDeviceInfo.bufferSize_);
+                }
+            }
+        }
+
     }
     if (device_info) *device_info = myDeviceInfo;
     return true;
@@ -253,6 +307,13 @@ bool Device::getExtendedDeviceInfo(ExtendedDeviceInfo *extended_device_info) {
         myExtendedDeviceInfo.nameLength_ = recvBuffer[myAddressLength + 1];
         myExtendedDeviceInfo.versioninfoLength_ = recvBuffer[myAddressLength + 2];
         memcpy(&myExtendedDeviceInfo.bufferSize_, recvBuffer + myAddressLength + 3, 2);
+
+        if (metadataCache && metadataIndex_ >= 0) {
+            metadataCache->setExtendedInfo(metadataIndex_,
+                                           myExtendedDeviceInfo.nameLength_,
+                                           myExtendedDeviceInfo.versioninfoLength_,
+                                           myExtendedDeviceInfo.bufferSize_);
+        }
     }
 
     if (extended_device_info) *extended_device_info = myExtendedDeviceInfo;
@@ -268,10 +329,24 @@ bool Device::receiveDeviceRealName(char* out_string) {
         return false;
     }
 
-    return receiveString(
+    if (!out_string) {
+        return false;
+    }
+    if (metadataCache && metadataIndex_ >= 0 && metadataCache->getString(metadataIndex_, false, out_string)) {
+        return true;
+    }
+
+    if (!receiveString(
         TURAG_FELDBUS_DEVICE_COMMAND_DEVICE_NAME,
         myExtendedDeviceInfo.nameLength(),
-		out_string);
+		out_string)) {
+        return false;
+    }
+
+    if (metadataCache && metadataIndex_ >= 0) {
+        metadataCache->setString(metadataIndex_, false, out_string, myExtendedDeviceInfo.nameLength());
+    }
+    return true;
 }
 
 bool Device::receiveVersionInfo(char* out_string) {
@@ -283,10 +358,37 @@ bool Device::receiveVersionInfo(char* out_string) {
         return false;
     }
 
-    return receiveString(
+    if (!out_string) {
+        return false;
+    }
+    if (metadataCache && metadataIndex_ >= 0 && metadataCache->getString(metadataIndex_, true, out_string)) {
+        return true;
+    }
+
+    if (!receiveString(
         TURAG_FELDBUS_DEVICE_COMMAND_VERSIONINFO,
         myExtendedDeviceInfo.versionInfoLength(),
-		out_string);
+		out_string)) {
+        return false;
+    }
+
+    if (metadataCache && metadataIndex_ >= 0) {
+        metadataCache->setString(metadataIndex_, true, out_string, myExtendedDeviceInfo.versionInfoLength());
+    }
+    return true;
+}
+
+int Device::loadCachedMetadata(void* data, unsigned size) {
+    if (!metadataCache || !getDeviceInfo(nullptr) || metadataIndex_ < 0) {
+        return -1;
+    }
+    return metadataCache->getData(metadataIndex_, data, size);
+}
+
+void Device::storeCachedMetadata(const void* data, unsigned size) {
+    if (metadataCache && metadataIndex_ >= 0) {
+        metadataCache->setData(metadataIndex_, data, size);
+    }
 }
 
 bool Device::receiveString(uint8_t command, uint8_t stringLength, char* out_string) {
@@ -334,7 +436,7 @@ bool Device::receiveUptime(float* uptime) {
 	
 	uint32_t count = 0;
 	
-    if (!receiveErrorCount(TURAG_FELDBUS_DEVICE_COMMAND_UPTIME_COUNTER, &count)) {
+    if (!receiveUint32(TURAG_FELDBUS_DEVICE_COMMAND_UPTIME_COUNTER, &count)) {
 		return false;
 	}
 
@@ -343,22 +445,26 @@ bool Device::receiveUptime(float* uptime) {
 }
 
 bool Device::receiveNumberOfAcceptedPackages(uint32_t* packageCount) {
-    return receiveErrorCount(TURAG_FELDBUS_DEVICE_COMMAND_PACKAGE_COUNT_CORRECT, packageCount);
+    return receiveUint32(TURAG_FELDBUS_DEVICE_COMMAND_PACKAGE_COUNT_CORRECT, packageCount);
 }
 
 bool Device::receiveNumberOfOverflows(uint32_t* overflowCount) {
-    return receiveErrorCount(TURAG_FELDBUS_DEVICE_COMMAND_PACKAGE_COUNT_BUFFEROVERFLOW, overflowCount);
+    return receiveUint32(TURAG_FELDBUS_DEVICE_COMMAND_PACKAGE_COUNT_BUFFEROVERFLOW, overflowCount);
 }
 
 bool Device::receiveNumberOfLostPackages(uint32_t* lostPackagesCount) {
-    return receiveErrorCount(TURAG_FELDBUS_DEVICE_COMMAND_PACKAGE_COUNT_LOST, lostPackagesCount);
+    return receiveUint32(TURAG_FELDBUS_DEVICE_COMMAND_PACKAGE_COUNT_LOST, lostPackagesCount);
 }
 
 bool Device::receiveNumberOfChecksumErrors(uint32_t* checksumErrorCount) {
-    return receiveErrorCount(TURAG_FELDBUS_DEVICE_COMMAND_PACKAGE_COUNT_CHKSUM_MISMATCH, checksumErrorCount);
+    return receiveUint32(TURAG_FELDBUS_DEVICE_COMMAND_PACKAGE_COUNT_CHKSUM_MISMATCH, checksumErrorCount);
+}
+
+bool Device::receiveMaxBaudRate(uint32_t* baudRate) {
+    return receiveUint32(TURAG_FELDBUS_DEVICE_COMMAND_GET_MAX_BAUD_RATE, baudRate);
 }
 
-bool Device::receiveErrorCount(uint8_t command, uint32_t* buffer) {
+bool Device::receiveUint32(uint8_t command, uint32_t* buffer) {
 	if (!buffer) {
 		return false;
 	}
@@ -3,9 +3,24 @@
 #include <tina++/crc/xor.h>
 #include <tina++/crc/crc.h>
 
+#include <algorithm>
+#include <cstring>
+
 namespace TURAG {
 namespace Feldbus {
 
+namespace {
+
+// devices whose transmissions keep failing completely are limited to a single
+// attempt for a period that doubles with every failure within these bounds
+constexpr unsigned minBackoffMs = 10;
+constexpr unsigned maxBackoffMs = 1000;
+
+// weight of a new attempt in the smoothed success ratio
+constexpr float successRatioGain = 0.1f;
+
+} // namespace
+
 
 
 FeldbusAbstraction::ResultStatus BaseDevice::transceive(uint8_t address, uint8_t *transmit, int transmit_length, uint8_t *receive, int receive_length, unsigned maxAttempts)
@@ -41,6 +56,15 @@ FeldbusAbstraction::ResultStatus BaseDevice::transceive(uint8_t address, uint8_t
     if (maxAttempts == 0) {
         maxAttempts = maxTransmissionAttempts;
     }
+    if (myAdaptiveTimeout) {
+        maxAttempts = adaptiveAttempts(maxAttempts);
+    }
+
+    // the deadline is relative to the start of the first attempt,
+    // unless it is inherited from a PriorityOverride
+    const SystemTime start = SystemTime::now();
+    const TransmissionPriority priority = transmissionPriority();
+    const SystemTime deadline = absoluteDeadline(start);
 
 
     // we try to transmit until either
@@ -52,7 +76,26 @@ FeldbusAbstraction::ResultStatus BaseDevice::transceive(uint8_t address, uint8_t
 
         // clear buffer from any previous failed transmissions, then send
         bus_.clearBuffer();
-        status = bus_.transceive(transmit, &transmit_length_copy, receive, &receive_length_copy, address, myChecksumType);
+        SystemTime duration;
+        const FeldbusAbstraction::ResultStatus result =
+                bus_.transceive(transmit, &transmit_length_copy, receive, &receive_length_copy, address, myChecksumType, priority, deadline,
+                                attempt + 1, responseTimeout(), &duration);
+
+        if (result == FeldbusAbstraction::ResultStatus::DeadlineMissed) {
+            if (attempt == 0) {
+                // the request never made it to the bus
+                ++myTotalDeadlineMisses;
+                return result;
+            }
+            // No time left for another attempt. The caller needs to know
+            // what went wrong on the bus rather than that it was busy.
+            break;
+        }
+        status = result;
+
+        if (myAdaptiveTimeout) {
+            updateAdaptiveTimeout(status, duration, receive ? receive_length_copy : 0);
+        }
 
 
         switch (status) {
@@ -70,6 +113,7 @@ FeldbusAbstraction::ResultStatus BaseDevice::transceive(uint8_t address, uint8_t
             ++myTotalChecksumErrors;
             break;
 
+        case FeldbusAbstraction::ResultStatus::DeadlineMissed:
         case FeldbusAbstraction::ResultStatus::Success:
             break;
         }
@@ -78,6 +122,17 @@ FeldbusAbstraction::ResultStatus BaseDevice::transceive(uint8_t address, uint8_t
     }
     myTotalTransmissions += attempt;
 
+    if (myAdaptiveTimeout) {
+        updateBackoff(status == FeldbusAbstraction::ResultStatus::Success);
+    }
+
+#if TURAG_FELDBUS_DEVICE_CONFIG_LATENCY_STATISTICS
+    myLatencyHistogram.add(SystemTime::now() - start);
+    if (status == FeldbusAbstraction::ResultStatus::Success) {
+        ++myAttemptsHistogram[attempt < attemptsHistogramSize ? attempt - 1 : attemptsHistogramSize - 1];
+    }
+#endif
+
 
 //            turag_infof("%s: transceive rx success(%x|%x) [", name, success, checksum_correct);
 //            for (int j = 0; j < receive_length; ++j) {
@@ -88,5 +143,149 @@ FeldbusAbstraction::ResultStatus BaseDevice::transceive(uint8_t address, uint8_t
     return status;
 }
 
+void BaseDevice::setAdaptiveTimeout(SystemTime minimum, SystemTime maximum)
+{
+    myMinTimeout = minimum.toUsec();
+    myMaxTimeout = maximum.toUsec() > myMinTimeout ? maximum.toUsec() : myMinTimeout;
+
+    // start conservatively until we have measured the device
+    mySmoothedRtt = 0;
+    myRttVariance = 0;
+    myResponseTimeout = myMaxTimeout;
+    mySuccessRatio = 1.0f;
+    myConsecutiveFailures = 0;
+    myBackoffUntil = SystemTime(0);
+    myAdaptiveTimeout = true;
+}
+
+SystemTime BaseDevice::responseTimeout(void) const
+{
+    if (!myAdaptiveTimeout) {
+        return SystemTime::infinite();
+    }
+    SystemTime timeout = SystemTime::fromUsec(myResponseTimeout);
+    if (timeout.toUsec() < myResponseTimeout) {
+        timeout += SystemTime(1);
+    }
+    return timeout;
+}
+
+thread_local BaseDevice::PriorityOverride* BaseDevice::PriorityOverride::current_ = nullptr;
+
+const BaseDevice::PriorityOverride* BaseDevice::activeOverride(void) const
+{
+    for (const PriorityOverride* priority = PriorityOverride::current_; priority; priority = priority->previous_) {
+        if (&priority->device_ == this) {
+            return priority;
+        }
+    }
+    return nullptr;
+}
+
+SystemTime BaseDevice::absoluteDeadline(SystemTime now) const
+{
+    const PriorityOverride* priority = activeOverride();
+    if (priority) {
+        return priority->deadline_;
+    }
+    return myDeadline == SystemTime::infinite() ? myDeadline : now + myDeadline;
+}
+
+SystemTime BaseDevice::transmissionDeadline(void) const
+{
+    const SystemTime now = SystemTime::now();
+    const SystemTime deadline = absoluteDeadline(now);
+    if (deadline == SystemTime::infinite()) {
+        return deadline;
+    }
+    return deadline > now ? deadline - now : SystemTime(0);
+}
+
+unsigned BaseDevice::adaptiveAttempts(unsigned maxAttempts) const
+{
+    // Retrying a device that fails most of the time only eats bus time.
+    if (mySuccessRatio < 0.5f || SystemTime::now() < myBackoffUntil) {
+        return 1;
+    }
+
+    // number of attempts that gives a 99.9 % chance of success
+    const float failureRatio = 1.0f - mySuccessRatio;
+    float failureProbability = failureRatio;
+    unsigned attempts = 1;
+    while (failureProbability > 0.001f && attempts < maxAttempts) {
+        failureProbability *= failureRatio;
+        ++attempts;
+    }
+    return attempts;
+}
+
+void BaseDevice::updateAdaptiveTimeout(FeldbusAbstraction::ResultStatus status, SystemTime duration, int received)
+{
+    switch (status) {
+    case FeldbusAbstraction::ResultStatus::Success:
+        mySuccessRatio += successRatioGain * (1.0f - mySuccessRatio);
+
+        // Only transmissions with an answer tell us something about the response time.
+        if (received > 0) {
+            // RFC 6298: smoothed round trip time and its mean deviation
+            const unsigned sample = duration.toUsec();
+            if (mySmoothedRtt == 0) {
+                mySmoothedRtt = sample ? sample : 1;
+                myRttVariance = sample / 2;
+            } else {
+                const unsigned deviation = sample > mySmoothedRtt ? sample - mySmoothedRtt : mySmoothedRtt - sample;
+                myRttVariance = (3 * myRttVariance + deviation) / 4;
+                mySmoothedRtt = (7 * mySmoothedRtt + sample) / 8;
+            }
+
+            const unsigned timeout = mySmoothedRtt + 4 * myRttVariance;
+            myResponseTimeout = timeout < myMinTimeout ? myMinTimeout : (timeout > myMaxTimeout ? myMaxTimeout : timeout);
+        }
+        break;
+
+    case FeldbusAbstraction::ResultStatus::TransmissionError:
+        mySuccessRatio -= successRatioGain * mySuccessRatio;
+
+        // The device did not answer in time. It may just be slower than we
+        // think, so give it more time on the next attempt.
+        if (received == 0) {
+            myResponseTimeout = 2 * myResponseTimeout < myMaxTimeout ? 2 * myResponseTimeout : myMaxTimeout;
+        }
+        break;
+
+    case FeldbusAbstraction::ResultStatus::ChecksumError:
+        mySuccessRatio -= successRatioGain * mySuccessRatio;
+        break;
+
+    case FeldbusAbstraction::ResultStatus::DeadlineMissed:
+        // not the fault of the device
+        break;
+    }
+}
+
+void BaseDevice::updateBackoff(bool success)
+{
+    if (success) {
+        myConsecutiveFailures = 0;
+        myBackoffUntil = SystemTime(0);
+        return;
+    }
+
+    ++myConsecutiveFailures;
+    unsigned backoffMs = maxBackoffMs;
+    if (myConsecutiveFailures <= 7) {
+        backoffMs = std::min(minBackoffMs << (myConsecutiveFailures - 1), maxBackoffMs);
+    }
+    myBackoffUntil = SystemTime::now() + SystemTime::fromMsec(backoffMs);
+}
+
+#if TURAG_FELDBUS_DEVICE_CONFIG_LATENCY_STATISTICS
+void BaseDevice::resetLatencyStatistics(void)
+{
+    myLatencyHistogram.reset();
+    std::memset(myAttemptsHistogram, 0, sizeof(myAttemptsHistogram));
+}
+#endif
+
 } // namespace Feldbus
 } // namespace TURAG
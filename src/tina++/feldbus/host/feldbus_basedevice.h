@@ -13,6 +13,7 @@
 #include <tina++/tina.h>
 #include <tina/feldbus/protocol/turag_feldbus_bus_protokoll.h>
 #include <tina++/feldbus/host/feldbusabstraction.h>
+#include <tina++/debug/latencyhistogram.h>
 
 
 #if !TURAG_USE_TURAG_FELDBUS_HOST
@@ -32,6 +33,12 @@
 # define TURAG_FELDBUS_DEVICE_CONFIG_STANDARD_CHECKSUM_TYPE			TURAG::Feldbus::ChecksumType::crc8
 #endif
 
+/// Legt fest, ob für jedes Gerät ein Histogramm der Übertragungsdauer und
+/// der benötigten Übertragungsversuche geführt wird. Kostet etwa 450 Byte pro Gerät.
+#if !defined(TURAG_FELDBUS_DEVICE_CONFIG_LATENCY_STATISTICS) || defined(__DOXYGEN__)
+# define TURAG_FELDBUS_DEVICE_CONFIG_LATENCY_STATISTICS				1
+#endif
+
 
 /*!
  * @}
@@ -106,8 +113,16 @@ public:
         myTotalNoAnswerErrors(0),
         myTotalMissingDataErrors(0),
         myTotalTransmitErrors(0),
-        bus_(feldbus), maxTransmissionAttempts(max_transmission_attempts), myChecksumType(type)
+        myTotalDeadlineMisses(0),
+        bus_(feldbus), maxTransmissionAttempts(max_transmission_attempts), myChecksumType(type),
+        myPriority(TransmissionPriority::control), myDeadline(SystemTime::infinite()),
+        myAdaptiveTimeout(false), myMinTimeout(0), myMaxTimeout(0),
+        mySmoothedRtt(0), myRttVariance(0), myResponseTimeout(0),
+        mySuccessRatio(1.0f), myConsecutiveFailures(0), myBackoffUntil(0)
     {
+#if TURAG_FELDBUS_DEVICE_CONFIG_LATENCY_STATISTICS
+        resetLatencyStatistics();
+#endif
     }
 
 #if TURAG_USE_LIBSUPCPP_RUNTIME_SUPPORT
@@ -121,6 +136,154 @@ public:
      */
     FeldbusAbstraction& bus(void) const { return bus_; }
 
+    /**
+     * @brief Legt Priorität und Deadline für alle Übertragungen des Gerätes fest.
+     * @param priority Prioritätsklasse, mit der der Bus angefordert wird.
+     * @param deadline Maximale Zeit ab Beginn einer Übertragung, bis der Bus
+     * zugeteilt sein muss. Wird sie überschritten, so wird die Übertragung
+     * verworfen und nicht wiederholt. Standardmäßig unbegrenzt.
+     *
+     * Für einzelne Aufrufe können die Einstellungen mit PriorityOverride
+     * vorübergehend für den aufrufenden Thread geändert werden.
+     */
+    void setTransmissionPriority(TransmissionPriority priority, SystemTime deadline = SystemTime::infinite()) {
+        myPriority = priority;
+        myDeadline = deadline;
+    }
+
+    /// Prioritätsklasse der Übertragungen des Gerätes im aufrufenden Thread.
+    TransmissionPriority transmissionPriority(void) const {
+        const PriorityOverride* priority = activeOverride();
+        return priority ? priority->priority_ : myPriority;
+    }
+
+    /// Relative Deadline der Übertragungen des Gerätes im aufrufenden Thread.
+    /// Bei einer PriorityOverride ist es die bis zu ihrer Deadline verbleibende Zeit.
+    SystemTime transmissionDeadline(void) const;
+
+    /**
+     * @brief Aktiviert den adaptiven Timeout und die adaptive Wiederholungsstrategie.
+     * @param minimum Kleinster zulässiger Timeout.
+     * @param maximum Größter zulässiger Timeout. Wird verwendet, bis die erste
+     * Antwort gemessen wurde.
+     *
+     * Aus der gemessenen Antwortzeit erfolgreicher Übertragungen, also ohne
+     * Paket-Delay und die Übertragungszeit von Anfrage und Antwort (siehe
+     * FeldbusAbstraction::transceive()), werden wie bei TCP
+     * (RFC 6298) ein geglätteter Mittelwert und die mittlere Abweichung bestimmt.
+     * Der Timeout ergibt sich zu Mittelwert plus vierfacher Abweichung und wird
+     * nach jeder unbeantworteten Anfrage verdoppelt. Schnelle Geräte verschwenden
+     * so bei verlorenen Paketen kein festes Timeout-Fenster mehr, während langsame
+     * Geräte (z.B. Bootloader beim Schreiben einer Seite) mehr Zeit bekommen.
+     *
+     * Außerdem wird die Anzahl der Versuche an die geglättete Erfolgsquote
+     * angepasst: Es wird höchstens so oft wiederholt, wie für eine Erfolgswahrscheinlichkeit
+     * von 99,9 % nötig ist. Liegt die Erfolgsquote unter 50 % oder schlagen Übertragungen
+     * wiederholt komplett fehl, so bekommt das Gerät für eine exponentiell wachsende
+     * Zeit nur noch einen Versuch pro Übertragung, damit ein gestörtes Gerät
+     * nicht den Bus blockiert.
+     *
+     * Die Subklasse von FeldbusAbstraction muss FeldbusAbstraction::responseTimeout()
+     * unterstützen, damit der Timeout wirksam wird.
+     */
+    void setAdaptiveTimeout(SystemTime minimum, SystemTime maximum);
+
+    /// Deaktiviert den adaptiven Timeout. Es gilt wieder der Timeout des Busses.
+    void disableAdaptiveTimeout(void) { myAdaptiveTimeout = false; }
+
+    /// Gibt zurück, ob der adaptive Timeout aktiv ist.
+    bool hasAdaptiveTimeout(void) const { return myAdaptiveTimeout; }
+
+    /**
+     * @brief Aktueller Timeout des Gerätes.
+     * @return Timeout, aufgerundet auf ganze Ticks des Systemtakts, oder
+     * SystemTime::infinite(), falls der adaptive Timeout nicht aktiv ist.
+     */
+    SystemTime responseTimeout(void) const;
+
+    /// Geglättete Antwortzeit erfolgreicher Übertragungen.
+    SystemTime smoothedRoundTripTime(void) const { return SystemTime::fromUsec(mySmoothedRtt); }
+
+    /// Geglättete Erfolgsquote einzelner Übertragungsversuche zwischen 0 und 1.
+    float recentSuccessRatio(void) const { return mySuccessRatio; }
+
+#if TURAG_FELDBUS_DEVICE_CONFIG_LATENCY_STATISTICS || defined(__DOXYGEN__)
+    /// Größte Anzahl an Versuchen, die getrennt erfasst wird.
+    static constexpr unsigned attemptsHistogramSize = 8;
+
+    /**
+     * @brief Histogramm der Dauer von Übertragungen des Gerätes.
+     *
+     * Erfasst wird die Zeit vom Aufruf bis zur Rückkehr von transceive(),
+     * also inklusive Warten auf den Bus und aller Wiederholungen. Übertragungen,
+     * die wegen einer Deadline verworfen wurden, werden nicht erfasst. Die reine
+     * Dauer der einzelnen Pakete erfasst FeldbusAbstraction::latencyHistogram().
+     *
+     * \note Die Auflösung hängt vom Systemtakt der Plattform ab.
+     */
+    const Debug::LatencyHistogram& latencyHistogram(void) const { return myLatencyHistogram; }
+
+    /**
+     * @brief Anzahl der erfolgreichen Übertragungen, die \a attempts Versuche benötigten.
+     * @param attempts Anzahl der Versuche ab 1. Für attemptsHistogramSize werden
+     * alle Übertragungen mit mindestens so vielen Versuchen zurückgegeben.
+     */
+    unsigned successesAfterAttempts(unsigned attempts) const {
+        return attempts >= 1 && attempts <= attemptsHistogramSize ? myAttemptsHistogram[attempts - 1] : 0;
+    }
+
+    /// Setzt das Latenz-Histogramm und die Verteilung der Versuche zurück.
+    void resetLatencyStatistics(void);
+#endif
+
+    /**
+     * @brief Ändert Priorität und Deadline eines Gerätes für die Dauer eines Gültigkeitsbereichs.
+     *
+     * Die Änderung gilt nur für Übertragungen aus dem Thread, der das Objekt
+     * angelegt hat. Andere Threads benutzen das Gerät weiter mit den Einstellungen
+     * von setTransmissionPriority(). Damit lassen sich die Einstellungen für
+     * einzelne Aufrufe überschreiben:
+     * \code
+     * {
+     *     BaseDevice::PriorityOverride realtime(motor, TransmissionPriority::realtime, SystemTime::fromMsec(1));
+     *     motor.setValue(key, setpoint);
+     * }
+     * \endcode
+     *
+     * Die Deadline wird ab dem Anlegen des Objekts gemessen und gilt für alle
+     * Übertragungen im Gültigkeitsbereich gemeinsam. Besteht ein Aufruf aus
+     * mehreren Paketen, bekommen spätere Pakete nur noch die verbleibende Zeit.
+     */
+    class PriorityOverride {
+        PriorityOverride(const PriorityOverride&) = delete;
+        PriorityOverride& operator=(const PriorityOverride&) = delete;
+
+    public:
+        PriorityOverride(BaseDevice& device, TransmissionPriority priority, SystemTime deadline = SystemTime::infinite()) :
+            device_(device), priority_(priority),
+            deadline_(deadline == SystemTime::infinite() ? deadline : SystemTime::now() + deadline),
+            previous_(current_)
+        {
+            current_ = this;
+        }
+
+        ~PriorityOverride() {
+            current_ = previous_;
+        }
+
+    private:
+        friend class BaseDevice;
+
+        const BaseDevice& device_;
+        TransmissionPriority priority_;
+        // absolute
+        SystemTime deadline_;
+
+        // overrides of the calling thread, innermost first
+        PriorityOverride* previous_;
+        static thread_local PriorityOverride* current_;
+    };
+
 protected:
     /*!
      * \brief Sendet Daten zum Slave und empfängt eine Antwort.
@@ -141,6 +304,11 @@ protected:
      * Adresse (je nach Adresslänge) und den Ende des Puffers mit der Checksumme.
      * Die Nutzdaten müssen also dazwischen platziert werden.
      *
+     * Der Bus wird mit der Priorität und Deadline des Gerätes angefordert
+     * (siehe setTransmissionPriority()). Wird die Deadline verpasst, so wird
+     * die Übertragung nicht wiederholt. Geschieht das erst bei einer Wiederholung,
+     * wird der Fehler des letzten Versuchs zurückgegeben und nicht als verpasste
+     * Deadline gezählt.
      */
     FeldbusAbstraction::ResultStatus transceive(uint8_t address, uint8_t *transmit, int transmit_length, uint8_t *receive, int receive_length, unsigned maxAttempts = 0);
 
@@ -216,6 +384,7 @@ protected:
     unsigned int myTotalNoAnswerErrors;
     unsigned int myTotalMissingDataErrors;
     unsigned int myTotalTransmitErrors;
+    unsigned int myTotalDeadlineMisses;
 
 
 private:
@@ -223,6 +392,31 @@ private:
 
     const unsigned int maxTransmissionAttempts;
     ChecksumType myChecksumType;
+
+    TransmissionPriority myPriority;
+    SystemTime myDeadline;
+
+    const PriorityOverride* activeOverride(void) const;
+    SystemTime absoluteDeadline(SystemTime now) const;
+    unsigned adaptiveAttempts(unsigned maxAttempts) const;
+    void updateAdaptiveTimeout(FeldbusAbstraction::ResultStatus status, SystemTime duration, int received);
+    void updateBackoff(bool success);
+
+    // adaptive timeout, all times in us
+    bool myAdaptiveTimeout;
+    unsigned myMinTimeout;
+    unsigned myMaxTimeout;
+    unsigned mySmoothedRtt;
+    unsigned myRttVariance;
+    unsigned myResponseTimeout;
+    float mySuccessRatio;
+    unsigned myConsecutiveFailures;
+    SystemTime myBackoffUntil;
+
+#if TURAG_FELDBUS_DEVICE_CONFIG_LATENCY_STATISTICS
+    Debug::LatencyHistogram myLatencyHistogram;
+    unsigned myAttemptsHistogram[attemptsHistogramSize];
+#endif
 };
 
 
@@ -0,0 +1,174 @@
+#define TURAG_DEBUG_LOG_SOURCE "B"
+
+#include <tina++/tina.h>
+
+#if TURAG_USE_TURAG_FELDBUS_HOST
+
+#include <tina/debug/print.h>
+#include <tina++/thread.h>
+#include <tina++/crc/xor.h>
+#include <tina++/crc/crc.h>
+
+#include "feldbus_baudratenegotiator.h"
+#include "feldbus_packet.h"
+
+
+namespace TURAG {
+namespace Feldbus {
+
+namespace {
+
+// 0x00, command, baud rate
+typedef PacketLayout<uint8_t, uint8_t, uint32_t> SetBaudRateBroadcast;
+
+} // namespace
+
+
+bool BaudRateNegotiator::addDevice(Device* device)
+{
+    if (!device) {
+        turag_errorf("BaudRateNegotiator: invalid device");
+        return false;
+    }
+    if (&device->bus() != &bus_) {
+        turag_errorf("%s: not connected to bus %s", device->name(), bus_.name());
+        return false;
+    }
+    if (entries_.size() == entries_.max_size()) {
+        turag_errorf("%s: baud rate negotiator is full", device->name());
+        return false;
+    }
+
+    entries_.push_back({device, 0});
+    return true;
+}
+
+bool BaudRateNegotiator::negotiate(unsigned hostMaximum)
+{
+    // Devices might still run with the rate of an earlier negotiation.
+    if (rate_ != baseRate_) {
+        broadcast(baseRate_);
+        rate_ = baseRate_;
+    }
+    if (!switchBus(baseRate_)) {
+        return false;
+    }
+
+    // Devices which don't answer at all are left out, otherwise a single
+    // missing device would keep the whole bus slow. Old devices answer the
+    // ping but not the query and limit the bus to the base rate.
+    unsigned target = hostMaximum;
+    for (Entry& entry : entries_) {
+        uint32_t maxRate = 0;
+        if (!entry.device->sendPing()) {
+            entry.maxRate = 0;
+            continue;
+        }
+        if (!entry.device->receiveMaxBaudRate(&maxRate) || maxRate < baseRate_) {
+            maxRate = baseRate_;
+        }
+        entry.maxRate = maxRate;
+        if (maxRate < target) {
+            target = maxRate;
+        }
+    }
+
+    if (target <= baseRate_) {
+        turag_infof("%s: staying at %u baud", bus_.name(), baseRate_);
+        return true;
+    }
+
+    broadcast(target);
+    if (!switchBus(target)) {
+        broadcast(baseRate_);
+        return false;
+    }
+    rate_ = target;
+
+    if (!verify()) {
+        turag_warningf("%s: devices lost at %u baud, falling back to %u baud", bus_.name(), target, baseRate_);
+        broadcast(baseRate_);
+        switchBus(baseRate_);
+        rate_ = baseRate_;
+        return false;
+    }
+
+    turag_infof("%s: switched to %u baud", bus_.name(), rate_);
+    return true;
+}
+
+bool BaudRateNegotiator::resync(void)
+{
+    if (rate_ == baseRate_) {
+        return verify();
+    }
+
+    // Only devices which were reset are listening at the base rate, the
+    // others don't even see this broadcast.
+    if (!switchBus(baseRate_)) {
+        return false;
+    }
+    broadcast(rate_);
+    if (!switchBus(rate_)) {
+        return false;
+    }
+
+    for (Entry& entry : entries_) {
+        if (entry.maxRate == 0 && entry.device->sendPing()) {
+            entry.maxRate = rate_;
+        }
+    }
+    return verify();
+}
+
+bool BaudRateNegotiator::broadcast(unsigned rate)
+{
+    Packet<SetBaudRateBroadcast> packet;
+    packet.data()[0] = TURAG_FELDBUS_BROADCAST_ADDR;
+    packet.set<0>(TURAG_FELDBUS_BROADCAST_TO_ALL_DEVICES);
+    packet.set<1>(TURAG_FELDBUS_DEVICE_BROADCAST_SET_BAUD_RATE);
+    packet.set<2>(static_cast<uint32_t>(rate));
+
+    uint8_t* checksum = packet.data() + SetBaudRateBroadcast::checksumOffset();
+    switch (checksumType_) {
+    case ChecksumType::xor_based:
+        *checksum = XOR::calculate(packet.data(), SetBaudRateBroadcast::checksumOffset());
+        break;
+    case ChecksumType::crc8:
+        *checksum = CRC8::calculate(packet.data(), SetBaudRateBroadcast::checksumOffset());
+        break;
+    case ChecksumType::none:
+        break;
+    }
+
+    int length = SetBaudRateBroadcast::length();
+    return bus_.transceive(packet.data(), &length, nullptr, nullptr, TURAG_FELDBUS_BROADCAST_ADDR,
+                           checksumType_, TransmissionPriority::realtime) == FeldbusAbstraction::ResultStatus::Success;
+}
+
+bool BaudRateNegotiator::switchBus(unsigned rate)
+{
+    if (bus_.baudRate() != rate && !bus_.setBaudRate(rate)) {
+        return false;
+    }
+    // the slaves restart their UART after processing the broadcast
+    CurrentThread::delay(TURAG_FELDBUS_BAUDRATE_SETTLE_TIME);
+    return true;
+}
+
+bool BaudRateNegotiator::verify(void)
+{
+    bool success = true;
+    for (Entry& entry : entries_) {
+        if (entry.maxRate != 0 && !entry.device->sendPing()) {
+            success = false;
+        }
+    }
+    return success;
+}
+
+
+} // namespace Feldbus
+} // namespace TURAG
+
+#endif // TURAG_USE_TURAG_FELDBUS_HOST
@@ -0,0 +1,153 @@
+#ifndef TINAPP_FELDBUS_HOST_FELDBUS_BAUDRATENEGOTIATOR_H
+#define TINAPP_FELDBUS_HOST_FELDBUS_BAUDRATENEGOTIATOR_H
+
+#include <tina++/tina.h>
+#include <tina++/time.h>
+#include <tina++/container/array_buffer.h>
+#include "device.h"
+
+
+#if !TURAG_USE_TURAG_FELDBUS_HOST
+# warning TURAG_USE_TURAG_FELDBUS_HOST must be defined to 1
+#endif
+
+
+/// \addtogroup feldbus-host
+/// \{
+
+/// Maximale Anzahl an Geräten eines BaudRateNegotiator.
+#if !defined(TURAG_FELDBUS_BAUDRATE_MAX_DEVICES) || defined(__DOXYGEN__)
+# define TURAG_FELDBUS_BAUDRATE_MAX_DEVICES		16
+#endif
+
+/// Zeit, die den Slaves nach dem Umstellen der Baudrate gelassen wird,
+/// bevor das nächste Paket gesendet wird.
+#if !defined(TURAG_FELDBUS_BAUDRATE_SETTLE_TIME) || defined(__DOXYGEN__)
+# define TURAG_FELDBUS_BAUDRATE_SETTLE_TIME		SystemTime::fromMsec(2)
+#endif
+
+/// \}
+
+
+namespace TURAG {
+namespace Feldbus {
+
+
+/**
+ * \brief Stellt alle Geräte eines Busses auf die höchste gemeinsame Baudrate um.
+ *
+ * Alle Geräte starten mit der Basis-Baudrate, die sich nach dem langsamsten Gerät
+ * richtet. negotiate() fragt bei jedem Gerät mit
+ * \ref TURAG_FELDBUS_DEVICE_COMMAND_GET_MAX_BAUD_RATE ab, wie schnell es werden kann,
+ * stellt alle Geräte mit dem Broadcast \ref TURAG_FELDBUS_DEVICE_BROADCAST_SET_BAUD_RATE
+ * gleichzeitig auf die höchste von allen unterstützte Baudrate um und zieht dann
+ * den Bus nach:
+ * \code
+ * BaudRateNegotiator negotiator(bus, 115200);
+ * negotiator.addDevice(&motor1);
+ * negotiator.addDevice(&motor2);
+ * negotiator.negotiate(2000000);
+ * \endcode
+ *
+ * Antwortet danach eines der Geräte nicht, werden alle Geräte wieder auf die
+ * Basis-Baudrate zurückgestellt.
+ *
+ * Nach einem Reset läuft ein Gerät wieder mit der Basis-Baudrate und ist für den
+ * Host nicht mehr erreichbar. resync() sendet den Broadcast deshalb noch einmal mit
+ * der Basis-Baudrate und kann z.B. aufgerufen werden, wenn Device::availability()
+ * eines Geräts nicht mehr Device::Availability::available ist.
+ *
+ * Ältere Geräte beantworten die Abfrage nicht und ignorieren den Broadcast. Sie
+ * zählen mit der Basis-Baudrate, sodass ein Bus mit einem solchen Gerät langsam
+ * bleibt. Sollen schnelle und langsame Geräte gemischt werden, müssen sie an
+ * verschiedenen Bussegmenten hängen, die z.B. über FeldbusRouter angesprochen
+ * werden, und jedes Segment bekommt seinen eigenen BaudRateNegotiator.
+ *
+ * Die Geräte müssen 1 Byte lange Adressen haben und den Checksummentyp des
+ * Negotiators benutzen.
+ *
+ * \note Die Klasse ist nicht thread-safe. Während negotiate() und resync()
+ * sollten keine anderen Übertragungen auf dem Bus laufen.
+ */
+class BaudRateNegotiator {
+public:
+    /**
+     * \brief Konstruktor.
+     * \param bus Bus, an dem alle Geräte hängen.
+     * \param baseRate Basis-Baudrate, mit der alle Geräte nach einem Reset laufen.
+     * \param type Checksummentyp der Geräte.
+     */
+    BaudRateNegotiator(FeldbusAbstraction& bus, unsigned baseRate,
+                       ChecksumType type = TURAG_FELDBUS_DEVICE_CONFIG_STANDARD_CHECKSUM_TYPE) :
+        bus_(bus), checksumType_(type), baseRate_(baseRate), rate_(baseRate)
+    { }
+
+    /**
+     * \brief Fügt ein Gerät hinzu.
+     * \param device Gerät, das am Bus des Negotiators hängen muss.
+     * \return False, wenn kein Platz mehr ist oder das Gerät nicht passt.
+     */
+    bool addDevice(Device* device);
+
+    /**
+     * \brief Stellt Bus und Geräte auf die höchste gemeinsame Baudrate um.
+     * \param hostMaximum Höchste Baudrate, die die Schnittstelle des Hosts beherrscht.
+     * \return False, wenn die Umstellung fehlgeschlagen ist. Bus und Geräte laufen
+     * dann mit der Basis-Baudrate.
+     *
+     * Die Geräte werden vorher auf die Basis-Baudrate zurückgestellt, sodass
+     * negotiate() auch nach einem Teil-Reset wiederholt werden kann. Geräte, die
+     * nicht einmal auf einen Ping antworten, werden nicht berücksichtigt und
+     * können später mit resync() nachgeholt werden.
+     */
+    bool negotiate(unsigned hostMaximum);
+
+    /**
+     * \brief Holt Geräte zurück, die nach einem Reset mit der Basis-Baudrate laufen.
+     * \return False, wenn danach nicht alle bekannten Geräte antworten.
+     *
+     * Geräte, die bei negotiate() nicht geantwortet haben und jetzt mit der
+     * aktuellen Baudrate erreichbar sind, werden wieder berücksichtigt.
+     */
+    bool resync(void);
+
+    /// Baudrate, mit der der Bus gerade läuft.
+    unsigned rate(void) const { return rate_; }
+
+    /// Basis-Baudrate.
+    unsigned baseRate(void) const { return baseRate_; }
+
+    /**
+     * \brief Höchste Baudrate des i-ten Geräts.
+     *
+     * Ergebnis der letzten Abfrage in negotiate(). Bei Geräten, die die Abfrage
+     * nicht beantworten, ist es die Basis-Baudrate, bei Geräten, die gar nicht
+     * antworten, 0.
+     */
+    unsigned maxRate(unsigned i) const { return i < entries_.size() ? entries_[i].maxRate : 0; }
+
+    /// Anzahl der Geräte.
+    unsigned size(void) const { return entries_.size(); }
+
+private:
+    struct Entry {
+        Device* device;
+        unsigned maxRate;
+    };
+
+    bool broadcast(unsigned rate);
+    bool switchBus(unsigned rate);
+    bool verify(void);
+
+    FeldbusAbstraction& bus_;
+    const ChecksumType checksumType_;
+    const unsigned baseRate_;
+    unsigned rate_;
+    ArrayBuffer<Entry, TURAG_FELDBUS_BAUDRATE_MAX_DEVICES> entries_;
+};
+
+
+} // namespace Feldbus
+} // namespace TURAG
+
+#endif // TINAPP_FELDBUS_HOST_FELDBUS_BAUDRATENEGOTIATOR_H
@@ -0,0 +1,230 @@
+#define TURAG_DEBUG_LOG_SOURCE "B"
+
+#include <tina++/tina.h>
+
+#if TURAG_USE_TURAG_FELDBUS_HOST
+
+#include <tina/debug/print.h>
+#include <algorithm>
+#include <cstdio>
+
+#include "feldbus_bringupcoordinator.h"
+
+
+namespace TURAG {
+namespace Feldbus {
+
+namespace {
+
+const char* const stepNames[BringUpCoordinator::numberOfSteps] = {
+    "ping", "info", "extinfo", "name", "version", "init"
+};
+
+} // namespace
+
+
+bool BringUpCoordinator::addDevice(Device* device, InitFunction init, void* context)
+{
+    if (!device) {
+        return false;
+    }
+    if (entries_.size() == entries_.max_size()) {
+        turag_errorf("BringUpCoordinator: too many devices, %s is not initialized", device->name());
+        return false;
+    }
+
+    Entry entry;
+    entry.timeline.device = device;
+    entry.timeline.start = SystemTime(0);
+    entry.timeline.end = SystemTime(0);
+    for (SystemTime& duration : entry.timeline.stepDuration) {
+        duration = SystemTime(0);
+    }
+    entry.timeline.failedStep = numberOfSteps;
+    entry.timeline.finished = false;
+    entry.init = init;
+    entry.context = context;
+    entries_.push_back(entry);
+    return true;
+}
+
+unsigned BringUpCoordinator::addAllDevices(FeldbusAbstraction* bus)
+{
+    unsigned added = 0;
+    for (Device* device = Device::getFirstDevice(); device; device = device->getNextDevice()) {
+        if (bus && &device->bus() != bus) {
+            continue;
+        }
+        if (addDevice(device)) {
+            ++added;
+        }
+    }
+    return added;
+}
+
+bool BringUpCoordinator::executeStep(Entry& entry, Step step)
+{
+    Device* device = entry.timeline.device;
+
+    // holds the longest possible string plus terminating zero
+    char buffer[256];
+
+    switch (step) {
+    case ping:
+        return device->sendPing();
+
+    case deviceInfo:
+        return device->getDeviceInfo(nullptr);
+
+    case extendedDeviceInfo:
+        return device->getExtendedDeviceInfo(nullptr);
+
+    case realName:
+        if (!device->receiveDeviceRealName(buffer)) {
+            return false;
+        }
+        turag_infof("%s: device name \"%s\"", device->name(), buffer);
+        return true;
+
+    case versionInfo:
+        if (!device->receiveVersionInfo(buffer)) {
+            return false;
+        }
+        turag_infof("%s: version \"%s\"", device->name(), buffer);
+        return true;
+
+    case initialize:
+        return entry.init(device, entry.context);
+
+    case numberOfSteps:
+        break;
+    }
+    return false;
+}
+
+bool BringUpCoordinator::processBus(FeldbusAbstraction& bus)
+{
+    // Devices are processed by address. All steps of one device are run
+    // back to back, so consecutive packets share the target address and
+    // FeldbusAbstraction leaves out the delay between them, as it does for
+    // every packet following a successful one to the same slave.
+    ArrayBuffer<uint8_t, TURAG_FELDBUS_BRINGUP_MAX_DEVICES> order;
+    for (unsigned i = 0; i < entries_.size(); ++i) {
+        if (&entries_[i].timeline.device->bus() == &bus) {
+            order.push_back(static_cast<uint8_t>(i));
+        }
+    }
+    std::stable_sort(order.begin(), order.end(), [this](uint8_t a, uint8_t b) {
+        return entries_[a].timeline.device->address() < entries_[b].timeline.device->address();
+    });
+
+    bool success = true;
+    for (uint8_t index : order) {
+        Entry& entry = entries_[index];
+        Timeline& timeline = entry.timeline;
+
+        timeline.start = SystemTime::now();
+        SystemTime stepStart = timeline.start;
+
+        for (unsigned i = 0; i < numberOfSteps; ++i) {
+            const Step step = static_cast<Step>(i);
+            if (!isEnabled(entry, step)) {
+                continue;
+            }
+
+            bool stepSuccess = executeStep(entry, step);
+            SystemTime now = SystemTime::now();
+            timeline.stepDuration[i] = now - stepStart;
+            stepStart = now;
+
+            if (!stepSuccess) {
+                // A device that does not answer the ping would only
+                // produce timeouts for all the other steps as well.
+                turag_warningf("%s: bring-up failed at step %s", timeline.device->name(), stepNames[i]);
+                timeline.failedStep = step;
+                success = false;
+                break;
+            }
+        }
+
+        timeline.end = stepStart;
+        timeline.finished = true;
+    }
+
+    return success;
+}
+
+bool BringUpCoordinator::run(void)
+{
+    bool success = true;
+
+    // Every bus once, in the order of first appearance. Running them
+    // concurrently needs a thread per bus, which is up to the caller.
+    for (unsigned i = 0; i < entries_.size(); ++i) {
+        FeldbusAbstraction& bus = entries_[i].timeline.device->bus();
+        bool seen = false;
+        for (unsigned j = 0; j < i; ++j) {
+            if (&entries_[j].timeline.device->bus() == &bus) {
+                seen = true;
+                break;
+            }
+        }
+        if (!seen && !processBus(bus)) {
+            success = false;
+        }
+    }
+
+    return success;
+}
+
+void BringUpCoordinator::printTimeline(void) const
+{
+    SystemTime origin = SystemTime::infinite();
+    SystemTime last = SystemTime(0);
+    for (const Entry& entry : entries_) {
+        if (entry.timeline.finished) {
+            origin = std::min(origin, entry.timeline.start);
+            last = std::max(last, entry.timeline.end);
+        }
+    }
+    if (origin == SystemTime::infinite()) {
+        turag_info("bring-up: no device processed yet");
+        return;
+    }
+
+    for (const Entry& entry : entries_) {
+        const Timeline& timeline = entry.timeline;
+        if (!timeline.finished) {
+            turag_infof("%s: not processed", timeline.device->name());
+            continue;
+        }
+
+        char steps[128];
+        int length = 0;
+        steps[0] = '\0';
+        for (unsigned i = 0; i < numberOfSteps && length < static_cast<int>(sizeof(steps)); ++i) {
+            const Step step = static_cast<Step>(i);
+            if (!isEnabled(entry, step)) {
+                continue;
+            }
+            if (step > timeline.failedStep) {
+                break;
+            }
+            length += snprintf(steps + length, sizeof(steps) - length, " %s %u",
+                               stepNames[i], timeline.stepDuration[i].toUsec());
+        }
+
+        turag_infof("%s (%s:%u): start %u us, total %u us,%s -> %s%s",
+                    timeline.device->name(), timeline.device->bus().name(), timeline.device->address(),
+                    (timeline.start - origin).toUsec(), (timeline.end - timeline.start).toUsec(),
+                    steps, timeline.success() ? "ok" : "FAILED at ",
+                    timeline.success() ? "" : stepNames[timeline.failedStep]);
+    }
+    turag_infof("bring-up finished after %u us", (last - origin).toUsec());
+}
+
+
+} // namespace Feldbus
+} // namespace TURAG
+
+#endif // TURAG_USE_TURAG_FELDBUS_HOST
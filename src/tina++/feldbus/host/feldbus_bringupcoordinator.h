@@ -0,0 +1,187 @@
+#ifndef TINAPP_FELDBUS_HOST_FELDBUS_BRINGUPCOORDINATOR_H
+#define TINAPP_FELDBUS_HOST_FELDBUS_BRINGUPCOORDINATOR_H
+
+#include <tina++/tina.h>
+#include <tina++/time.h>
+#include <tina++/container/array_buffer.h>
+#include <tina++/feldbus/host/feldbusabstraction.h>
+#include "device.h"
+
+
+#if !TURAG_USE_TURAG_FELDBUS_HOST
+# warning TURAG_USE_TURAG_FELDBUS_HOST must be defined to 1
+#endif
+
+
+/// \addtogroup feldbus-host
+/// \{
+
+/// Maximale Anzahl an Geräten, die ein BringUpCoordinator initialisiert.
+#if !defined(TURAG_FELDBUS_BRINGUP_MAX_DEVICES) || defined(__DOXYGEN__)
+# define TURAG_FELDBUS_BRINGUP_MAX_DEVICES		64
+#endif
+
+/// \}
+
+
+namespace TURAG {
+namespace Feldbus {
+
+
+/**
+ * \brief Initialisiert alle Geräte beim Start möglichst schnell.
+ *
+ * Für jedes registrierte Gerät werden nacheinander die ausgewählten Schritte
+ * ausgeführt: Ping, Device-Info, Extended-Device-Info, Name, Versionsinfo und
+ * eine optionale gerätespezifische Initialisierung (z.B. ASEBBase::initialize()).
+ *
+ * Geräte an verschiedenen Bussen sind voneinander unabhängig. Parallel
+ * initialisiert werden sie aber nur, wenn der Aufrufer für jeden Bus einen
+ * eigenen %Thread startet, der processBus() aufruft. Die Klasse legt selbst
+ * keine Threads an, da Stackgröße und Priorität Sache der Anwendung sind.
+ * run() bearbeitet alle Busse nacheinander im aufrufenden %Thread.
+ *
+ * Auf einem Bus werden alle Schritte eines Gerätes direkt nacheinander ohne
+ * Pausen ausgeführt. Da die FeldbusAbstraction das Paket-Delay weglässt, wenn
+ * das vorige Paket erfolgreich an dieselbe Adresse ging, entfällt es zwischen
+ * den Schritten eines Gerätes. Antwortet ein Gerät nicht auf den Ping, werden
+ * seine übrigen Schritte übersprungen, sodass fehlende Platinen nur einmal
+ * Timeouts kosten.
+ *
+ * \code
+ * static BringUpCoordinator bringUp;
+ * static Thread<1024> bus2Thread;
+ *
+ * bringUp.addAllDevices();
+ * bus2Thread.start(priority, [] { bringUp.processBus(bus2); });
+ * bringUp.processBus(bus1);
+ * // wait for bus2Thread, e.g. with a semaphore it signals
+ * bringUp.printTimeline();
+ * \endcode
+ *
+ * Für jedes Gerät wird ein Zeitverlauf mit Start, Ende und Dauer jedes Schrittes
+ * erfasst, der mit printTimeline() ausgegeben werden kann.
+ */
+class BringUpCoordinator {
+    BringUpCoordinator(const BringUpCoordinator&) = delete;
+    BringUpCoordinator& operator=(const BringUpCoordinator&) = delete;
+
+public:
+    /// Schritte der Initialisierung eines Gerätes.
+    enum Step : uint8_t {
+        ping,               ///< Device::sendPing()
+        deviceInfo,         ///< Device::getDeviceInfo()
+        extendedDeviceInfo, ///< Device::getExtendedDeviceInfo()
+        realName,           ///< Device::receiveDeviceRealName()
+        versionInfo,        ///< Device::receiveVersionInfo()
+        initialize,         ///< gerätespezifische Initialisierung
+        numberOfSteps
+    };
+
+    /// Bitmaske für einen Schritt.
+    static constexpr unsigned stepMask(Step step) { return 1u << step; }
+
+    /// Standardmäßig ausgeführte Schritte (alle).
+    static constexpr unsigned allSteps = (1u << numberOfSteps) - 1;
+
+    /**
+     * \brief Gerätespezifische Initialisierung.
+     * \return True bei Erfolg.
+     */
+    typedef bool (*InitFunction)(Device* device, void* context);
+
+    /// Zeitverlauf der Initialisierung eines Gerätes.
+    struct Timeline {
+        /// Gerät.
+        Device* device;
+        /// Beginn des ersten Schrittes.
+        SystemTime start;
+        /// Ende des letzten Schrittes.
+        SystemTime end;
+        /// Dauer der einzelnen Schritte, 0 für nicht ausgeführte Schritte.
+        SystemTime stepDuration[numberOfSteps];
+        /// Fehlgeschlagener Schritt oder numberOfSteps bei Erfolg.
+        Step failedStep;
+        /// Gibt an, ob das Gerät bereits bearbeitet wurde.
+        bool finished;
+
+        /// Gibt an, ob alle Schritte erfolgreich waren.
+        bool success(void) const { return finished && failedStep == numberOfSteps; }
+    };
+
+    /**
+     * \brief Konstruktor.
+     * \param steps Bitmaske der auszuführenden Schritte, siehe stepMask().
+     */
+    explicit BringUpCoordinator(unsigned steps = allSteps) :
+        steps_(steps)
+    { }
+
+    /**
+     * \brief Registriert ein Gerät.
+     * \param device Gerät.
+     * \param init Gerätespezifische Initialisierung oder nullptr.
+     * \param context Beliebiger Zeiger, der \a init übergeben wird.
+     * \return False, wenn zu viele Geräte registriert sind.
+     */
+    bool addDevice(Device* device, InitFunction init = nullptr, void* context = nullptr);
+
+    /**
+     * \brief Registriert alle Geräte der globalen Geräteliste.
+     * \param bus Nur Geräte an diesem Bus registrieren oder nullptr für alle.
+     * \return Anzahl der registrierten Geräte.
+     *
+     * Für Geräte mit gerätespezifischer Initialisierung sollte stattdessen
+     * addDevice() benutzt werden.
+     */
+    unsigned addAllDevices(FeldbusAbstraction* bus = nullptr);
+
+    /**
+     * \brief Initialisiert alle registrierten Geräte an einem Bus.
+     * \return True, wenn alle Geräte erfolgreich initialisiert wurden.
+     *
+     * Kann für verschiedene Busse gleichzeitig aus verschiedenen Threads aufgerufen werden.
+     * Die Geräte werden nach Adresse sortiert abgearbeitet.
+     */
+    bool processBus(FeldbusAbstraction& bus);
+
+    /**
+     * \brief Initialisiert alle registrierten Geräte im aufrufenden %Thread.
+     * \return True, wenn alle Geräte erfolgreich initialisiert wurden.
+     *
+     * Die Busse werden nacheinander bearbeitet. Für eine parallele
+     * Initialisierung muss processBus() aus je einem %Thread pro Bus
+     * aufgerufen werden.
+     */
+    bool run(void);
+
+    /// Anzahl der registrierten Geräte.
+    unsigned size(void) const { return entries_.size(); }
+
+    /// Zeitverlauf des Gerätes \a index.
+    const Timeline& timeline(unsigned index) const { return entries_[index].timeline; }
+
+    /// Gibt den Zeitverlauf aller Geräte relativ zum frühesten Start aus.
+    void printTimeline(void) const;
+
+private:
+    struct Entry {
+        Timeline timeline;
+        InitFunction init;
+        void* context;
+    };
+
+    bool isEnabled(const Entry& entry, Step step) const {
+        return (steps_ & stepMask(step)) && (step != initialize || entry.init);
+    }
+    bool executeStep(Entry& entry, Step step);
+
+    unsigned steps_;
+    ArrayBuffer<Entry, TURAG_FELDBUS_BRINGUP_MAX_DEVICES> entries_;
+};
+
+
+} // namespace Feldbus
+} // namespace TURAG
+
+#endif // TINAPP_FELDBUS_HOST_FELDBUS_BRINGUPCOORDINATOR_H
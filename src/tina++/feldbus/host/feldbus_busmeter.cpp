@@ -0,0 +1,184 @@
+#define TURAG_DEBUG_LOG_SOURCE "B"
+
+#include <tina++/tina.h>
+
+#if TURAG_USE_TURAG_FELDBUS_HOST
+
+#include <tina/debug/print.h>
+#include <cstring>
+
+#include "feldbus_busmeter.h"
+
+
+namespace TURAG {
+namespace Feldbus {
+
+namespace {
+
+// prints a percentage with one decimal without relying on float support of the debug output
+void splitPercent(float percent, unsigned* integral, unsigned* decimal) {
+    const unsigned permille = static_cast<unsigned>(percent * 10.0f + 0.5f);
+    *integral = permille / 10;
+    *decimal = permille % 10;
+}
+
+} // namespace
+
+
+BusMeter::BusMeter(unsigned baudRate, SystemTime window) :
+    baudRate_(baudRate), window_(window)
+{
+    reset();
+}
+
+void BusMeter::reset(void)
+{
+    windowStart_ = SystemTime::now();
+    std::memset(&current_, 0, sizeof(current_));
+    std::memset(&previous_, 0, sizeof(previous_));
+    totalFrames_ = 0;
+    totalBytes_ = 0;
+    totalWireTimeUs_ = 0;
+    lastEnd_ = SystemTime(0);
+    idleGaps_.reset();
+    std::memset(deviceIndex_, untracked, sizeof(deviceIndex_));
+    numberOfDevices_ = 0;
+}
+
+BusMeter::DeviceStatistics* BusMeter::deviceStatistics(unsigned address)
+{
+    if (address >= numberOfAddresses) {
+        return nullptr;
+    }
+    if (deviceIndex_[address] != untracked) {
+        return &devices_[deviceIndex_[address]];
+    }
+    if (numberOfDevices_ == TURAG_FELDBUS_BUSMETER_MAX_DEVICES) {
+        return nullptr;
+    }
+
+    DeviceStatistics* device = &devices_[numberOfDevices_];
+    device->address = address;
+    device->frames = 0;
+    device->bytes = 0;
+    device->wireTimeUs = 0;
+    device->idleGaps.reset();
+    device->lastEnd = SystemTime(0);
+    // publish the index only after the entry is initialised
+    deviceIndex_[address] = static_cast<uint8_t>(numberOfDevices_);
+    ++numberOfDevices_;
+    return device;
+}
+
+const BusMeter::DeviceStatistics* BusMeter::findDevice(unsigned address) const
+{
+    if (address >= numberOfAddresses || deviceIndex_[address] == untracked) {
+        return nullptr;
+    }
+    return &devices_[deviceIndex_[address]];
+}
+
+void BusMeter::account(SystemTime start, SystemTime end, unsigned address, int transmitted, int received, bool delayed)
+{
+    const unsigned bytes = static_cast<unsigned>(transmitted + received);
+    const unsigned long long wireTimeUs = BusMeter::wireTimeUs(bytes, delayed, baudRate_);
+
+    if (end >= windowStart_ + window_) {
+        if (end < windowStart_ + window_ + window_) {
+            previous_ = current_;
+            windowStart_ = windowStart_ + window_;
+        } else {
+            // the bus was idle for at least a whole window
+            std::memset(&previous_, 0, sizeof(previous_));
+            windowStart_ = end;
+        }
+        std::memset(&current_, 0, sizeof(current_));
+    }
+    ++current_.frames;
+    current_.bytes += bytes;
+    current_.wireTimeUs += wireTimeUs;
+    current_.busyUs += (end - start).toUsec();
+
+    ++totalFrames_;
+    totalBytes_ += bytes;
+    totalWireTimeUs_ += wireTimeUs;
+    if (lastEnd_ != SystemTime(0) && start >= lastEnd_) {
+        idleGaps_.add(start - lastEnd_);
+    }
+    lastEnd_ = end;
+
+    DeviceStatistics* device = deviceStatistics(address);
+    if (device) {
+        ++device->frames;
+        device->bytes += bytes;
+        device->wireTimeUs += wireTimeUs;
+        if (device->lastEnd != SystemTime(0) && start >= device->lastEnd) {
+            device->idleGaps.add(start - device->lastEnd);
+        }
+        device->lastEnd = end;
+    }
+}
+
+const BusMeter::Window* BusMeter::lastWindow(void) const
+{
+    static const Window emptyWindow = { 0, 0, 0, 0 };
+
+    const SystemTime now = SystemTime::now();
+    if (now < windowStart_ + window_) {
+        return &previous_;
+    }
+    if (now < windowStart_ + window_ + window_) {
+        // no transfer closed the current window yet
+        return &current_;
+    }
+    return &emptyWindow;
+}
+
+float BusMeter::utilisation(void) const
+{
+    return 100.0f * lastWindow()->wireTimeUs / window_.toUsec();
+}
+
+float BusMeter::occupancy(void) const
+{
+    return 100.0f * lastWindow()->busyUs / window_.toUsec();
+}
+
+float BusMeter::framesPerSecond(void) const
+{
+    return 1000000.0f * lastWindow()->frames / window_.toUsec();
+}
+
+float BusMeter::bytesPerSecond(void) const
+{
+    return 1000000.0f * lastWindow()->bytes / window_.toUsec();
+}
+
+void BusMeter::print(const char* name) const
+{
+    unsigned utilisationIntegral, utilisationDecimal, occupancyIntegral, occupancyDecimal;
+    splitPercent(utilisation(), &utilisationIntegral, &utilisationDecimal);
+    splitPercent(occupancy(), &occupancyIntegral, &occupancyDecimal);
+
+    turag_infof("%s: %u.%u %% utilisation (%u.%u %% occupied), %u frames/s, %u bytes/s at %u baud",
+                name, utilisationIntegral, utilisationDecimal, occupancyIntegral, occupancyDecimal,
+                static_cast<unsigned>(framesPerSecond()), static_cast<unsigned>(bytesPerSecond()), baudRate_);
+    turag_infof("%s: idle gaps p50 %u us, p99 %u us, max %u us",
+                name, idleGaps_.percentile(0.5f), idleGaps_.percentile(0.99f), idleGaps_.max());
+
+    for (unsigned i = 0; i < numberOfDevices_; ++i) {
+        const DeviceStatistics& device = devices_[i];
+        unsigned shareIntegral, shareDecimal;
+        splitPercent(totalWireTimeUs_ ? 100.0f * device.wireTimeUs / totalWireTimeUs_ : 0.0f,
+                     &shareIntegral, &shareDecimal);
+        turag_infof("%s: device %u: %u frames, %u.%u %% of wire time, gaps p50 %u us, p99 %u us",
+                    name, device.address, static_cast<unsigned>(device.frames), shareIntegral, shareDecimal,
+                    device.idleGaps.percentile(0.5f), device.idleGaps.percentile(0.99f));
+    }
+}
+
+
+} // namespace Feldbus
+} // namespace TURAG
+
+#endif // TURAG_USE_TURAG_FELDBUS_HOST
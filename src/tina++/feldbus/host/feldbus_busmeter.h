@@ -0,0 +1,211 @@
+#ifndef TINAPP_FELDBUS_HOST_FELDBUS_BUSMETER_H
+#define TINAPP_FELDBUS_HOST_FELDBUS_BUSMETER_H
+
+#include <tina++/tina.h>
+#include <tina++/time.h>
+#include <tina++/debug/latencyhistogram.h>
+
+
+#if !TURAG_USE_TURAG_FELDBUS_HOST
+# warning TURAG_USE_TURAG_FELDBUS_HOST must be defined to 1
+#endif
+
+
+/// \addtogroup feldbus-host
+/// \{
+
+/// Maximale Anzahl an Geräten, für die ein BusMeter eigene Statistiken führt.
+/// Jedes Gerät kostet etwa 450 Byte.
+#if !defined(TURAG_FELDBUS_BUSMETER_MAX_DEVICES) || defined(__DOXYGEN__)
+# define TURAG_FELDBUS_BUSMETER_MAX_DEVICES		16
+#endif
+
+/// \}
+
+
+namespace TURAG {
+namespace Feldbus {
+
+
+/**
+ * \brief Misst Auslastung und Durchsatz eines Busses.
+ *
+ * Ein BusMeter wird mit FeldbusAbstraction::setBusMeter() an einen Bus gehängt.
+ * Für jedes Paket wird aus der Anzahl gesendeter und empfangener Bytes, der
+ * Baudrate und dem Paket-Delay die Zeit berechnet, die es die Leitung belegt
+ * (8N1, also 10 Bit pro Byte, und 1,5 Frames Delay). Zusätzlich wird die
+ * gemessene Dauer der Übertragung erfasst, die auch die Antwortzeit der Slaves
+ * und Timeouts enthält.
+ *
+ * Auslastung, Pakete und Bytes pro Sekunde beziehen sich auf das letzte
+ * abgeschlossene Messfenster, sind also nie älter als zwei Fensterlängen:
+ * \code
+ * BusMeter meter(1000000);
+ * bus.setBusMeter(&meter);
+ * ...
+ * if (meter.utilisation() > 80.0f) {
+ *     meter.print(bus.name());
+ * }
+ * \endcode
+ *
+ * Außerdem werden die Pausen zwischen zwei Paketen auf dem Bus sowie für die ersten
+ * \ref TURAG_FELDBUS_BUSMETER_MAX_DEVICES angesprochenen Geräte die Pausen zwischen
+ * zwei Paketen an dasselbe Gerät in Histogrammen erfasst.
+ *
+ * \note Ein BusMeter darf nur an einem Bus hängen. Erfasst wird mit belegtem Bus,
+ * das Auslesen aus anderen Threads liefert höchstens leicht inkonsistente Werte.
+ */
+class BusMeter {
+    BusMeter(const BusMeter&) = delete;
+    BusMeter& operator=(const BusMeter&) = delete;
+
+public:
+    /// Statistiken eines Gerätes.
+    struct DeviceStatistics {
+        /// Adresse des Gerätes.
+        unsigned address;
+        /// Anzahl der Pakete an das Gerät.
+        unsigned long frames;
+        /// Anzahl der gesendeten und empfangenen Bytes.
+        unsigned long long bytes;
+        /// Berechnete Zeit in Mikrosekunden, die die Pakete des Gerätes den Bus belegt haben.
+        unsigned long long wireTimeUs;
+        /// Pausen zwischen dem Ende eines Pakets an das Gerät und dem Beginn des nächsten.
+        Debug::LatencyHistogram idleGaps;
+        // end of the last transfer, 0 if there was none
+        SystemTime lastEnd;
+    };
+
+    /**
+     * \brief Konstruktor.
+     * \param baudRate Baudrate des Busses.
+     * \param window Länge des Messfensters für Auslastung und Durchsatz.
+     */
+    explicit BusMeter(unsigned baudRate, SystemTime window = SystemTime::fromSec(1));
+
+    /**
+     * \brief Setzt die Baudrate, mit der die Zeit auf der Leitung berechnet wird.
+     *
+     * Muss aufgerufen werden, wenn sich die Baudrate des Busses ändert.
+     */
+    void setBaudRate(unsigned baudRate) { baudRate_ = baudRate; }
+
+    /// Baudrate, mit der die Zeit auf der Leitung berechnet wird.
+    unsigned baudRate(void) const { return baudRate_; }
+
+    /**
+     * \brief Berechnet die Zeit, die Bytes auf der Leitung benötigen.
+     * \param bytes Anzahl der Bytes.
+     * \param delayed Gibt an, ob das Paket-Delay eingerechnet wird.
+     * \param baudRate Baudrate des Busses.
+     * \return Dauer in Mikrosekunden oder 0, wenn die Baudrate unbekannt ist.
+     */
+    static unsigned long long wireTimeUs(unsigned bytes, bool delayed, unsigned baudRate) {
+        // 8N1 is 10 bits per byte, the bus delay is 1.5 frames
+        const unsigned bits = bytes * 10 + (delayed ? 15 : 0);
+        return baudRate ? bits * 1000000ULL / baudRate : 0;
+    }
+
+    /**
+     * \brief Erfasst ein Paket.
+     * \param start Beginn der Übertragung.
+     * \param end Ende der Übertragung.
+     * \param address Zieladresse.
+     * \param transmitted Anzahl gesendeter Bytes.
+     * \param received Anzahl empfangener Bytes.
+     * \param delayed Gibt an, ob vor dem Paket das Paket-Delay eingehalten wurde.
+     *
+     * Wird von FeldbusAbstraction aufgerufen.
+     */
+    void account(SystemTime start, SystemTime end, unsigned address, int transmitted, int received, bool delayed);
+
+    /**
+     * \brief Auslastung des Busses.
+     * \return Anteil der berechneten Zeit auf der Leitung am letzten Messfenster in Prozent.
+     */
+    float utilisation(void) const;
+
+    /**
+     * \brief Belegung des Busses.
+     * \return Anteil der gemessenen Dauer aller Übertragungen am letzten Messfenster in Prozent.
+     *
+     * Der Unterschied zu utilisation() ist die Zeit, die der Bus auf Antworten wartet.
+     */
+    float occupancy(void) const;
+
+    /// Pakete pro Sekunde im letzten Messfenster.
+    float framesPerSecond(void) const;
+
+    /// Gesendete und empfangene Bytes pro Sekunde im letzten Messfenster.
+    float bytesPerSecond(void) const;
+
+    /// Anzahl aller erfassten Pakete.
+    unsigned long totalFrames(void) const { return totalFrames_; }
+
+    /// Anzahl aller gesendeten und empfangenen Bytes.
+    unsigned long long totalBytes(void) const { return totalBytes_; }
+
+    /// Berechnete Zeit aller Pakete auf der Leitung in Mikrosekunden.
+    unsigned long long totalWireTimeUs(void) const { return totalWireTimeUs_; }
+
+    /// Pausen zwischen dem Ende eines Pakets und dem Beginn des nächsten.
+    const Debug::LatencyHistogram& idleGaps(void) const { return idleGaps_; }
+
+    /// Anzahl der Geräte mit eigenen Statistiken.
+    unsigned devices(void) const { return numberOfDevices_; }
+
+    /// Statistiken des Gerätes mit dem Index \a index.
+    const DeviceStatistics& device(unsigned index) const { return devices_[index]; }
+
+    /**
+     * \brief Sucht die Statistiken eines Gerätes.
+     * \return Statistiken oder nullptr, wenn das Gerät nicht erfasst wird.
+     */
+    const DeviceStatistics* findDevice(unsigned address) const;
+
+    /// Verwirft alle Messwerte.
+    void reset(void);
+
+    /**
+     * \brief Gibt alle Messwerte über die Debug-Ausgabe aus.
+     * \param name Name des Busses für die Ausgabe.
+     */
+    void print(const char* name) const;
+
+private:
+    static constexpr unsigned numberOfAddresses = 128;
+    static constexpr uint8_t untracked = 0xFF;
+
+    struct Window {
+        unsigned long frames;
+        unsigned long bytes;
+        unsigned long long wireTimeUs;
+        unsigned long long busyUs;
+    };
+
+    const Window* lastWindow(void) const;
+    DeviceStatistics* deviceStatistics(unsigned address);
+
+    unsigned baudRate_;
+    const SystemTime window_;
+
+    SystemTime windowStart_;
+    Window current_;
+    Window previous_;
+
+    unsigned long totalFrames_;
+    unsigned long long totalBytes_;
+    unsigned long long totalWireTimeUs_;
+    SystemTime lastEnd_;
+    Debug::LatencyHistogram idleGaps_;
+
+    uint8_t deviceIndex_[numberOfAddresses];
+    DeviceStatistics devices_[TURAG_FELDBUS_BUSMETER_MAX_DEVICES];
+    unsigned numberOfDevices_;
+};
+
+
+} // namespace Feldbus
+} // namespace TURAG
+
+#endif // TINAPP_FELDBUS_HOST_FELDBUS_BUSMETER_H
@@ -0,0 +1,284 @@
+#define TURAG_DEBUG_LOG_SOURCE "B"
+
+#include <tina++/tina.h>
+
+#if TURAG_USE_TURAG_FELDBUS_HOST
+
+#include <tina++/thread.h>
+#include <tina/debug/print.h>
+#include <algorithm>
+
+#include "feldbus_busscheduler.h"
+#include "feldbus_busmeter.h"
+
+
+namespace TURAG {
+namespace Feldbus {
+
+namespace {
+
+TuragSystemTicks greatestCommonDivisor(TuragSystemTicks a, TuragSystemTicks b) {
+    while (b != 0) {
+        TuragSystemTicks t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Rounded up, so that short times aren't planned as free on coarse system ticks.
+SystemTime fromUsecRoundedUp(unsigned long long us) {
+    SystemTime time = SystemTime::fromUsec(static_cast<unsigned>(us));
+    if (time.toUsec() < us) {
+        time += SystemTime(1);
+    }
+    return time;
+}
+
+} // namespace
+
+
+int BusScheduler::addEntry(Device* device, Operation operation, SystemTime period,
+                           SystemTime duration, void* context, TransmissionPriority priority,
+                           unsigned frameBytes)
+{
+    if (!device || !operation || period.toTicks() == 0) {
+        turag_errorf("BusScheduler %s: invalid entry", bus_.name());
+        return -1;
+    }
+    if (&device->bus() != &bus_) {
+        turag_errorf("BusScheduler %s: %s is connected to another bus", bus_.name(), device->name());
+        return -1;
+    }
+    if (entries_.size() == entries_.max_size()) {
+        turag_errorf("BusScheduler %s: too many entries", bus_.name());
+        return -1;
+    }
+
+    Entry entry;
+    entry.device = device;
+    entry.operation = operation;
+    entry.context = context;
+    entry.period = period;
+    entry.duration = duration;
+    entry.priority = priority;
+    entry.frameBytes = frameBytes;
+    entry.minorCyclesPerPeriod = 1;
+    entry.offset = 0;
+    entries_.push_back(entry);
+
+    feasible_ = false;
+    return entries_.size() - 1;
+}
+
+void BusScheduler::clear(void)
+{
+    entries_.clear();
+    order_.clear();
+    minorCyclesPerMajor_ = 0;
+    feasible_ = false;
+}
+
+SystemTime BusScheduler::interFrameDelay(void) const
+{
+    if (interFrameDelay_.toTicks() != 0) {
+        return interFrameDelay_;
+    }
+    // the baud rate might have been changed since construction
+    return fromUsecRoundedUp(BusMeter::wireTimeUs(0, true, bus_.baudRate()));
+}
+
+SystemTime BusScheduler::cost(const Entry& entry) const
+{
+    // Every entry is assumed to pay the inter-frame delay once. Grouping
+    // entries of the same device only ever makes the real cost smaller.
+    SystemTime duration = entry.duration.toTicks() != 0 ? entry.duration : entry.statistics.maxDuration;
+    if (duration.toTicks() == 0) {
+        // not measured yet, so at least plan the time on the wire
+        duration = fromUsecRoundedUp(BusMeter::wireTimeUs(entry.frameBytes, false, bus_.baudRate()));
+    }
+    return duration + interFrameDelay();
+}
+
+bool BusScheduler::compute(void)
+{
+    order_.clear();
+    minorCyclesPerMajor_ = 0;
+    utilization_ = 0.0f;
+    feasible_ = false;
+
+    if (entries_.empty()) {
+        return true;
+    }
+
+    // minor cycle: gcd of all periods, major cycle: lcm of all periods
+    TuragSystemTicks minor = entries_[0].period.toTicks();
+    TuragSystemTicks major = minor;
+    for (const Entry& entry : entries_) {
+        TuragSystemTicks period = entry.period.toTicks();
+        minor = greatestCommonDivisor(minor, period);
+        major = major / greatestCommonDivisor(major, period) * period;
+
+        if (major / minor > TURAG_FELDBUS_BUSSCHEDULER_MAX_MINOR_CYCLES) {
+            turag_errorf("BusScheduler %s: periods need too many minor cycles (more than %u)",
+                         bus_.name(), TURAG_FELDBUS_BUSSCHEDULER_MAX_MINOR_CYCLES);
+            return false;
+        }
+    }
+    minorCycle_ = SystemTime(minor);
+    majorCycle_ = SystemTime(major);
+    minorCyclesPerMajor_ = static_cast<unsigned>(major / minor);
+
+    // rate monotonic order: shorter periods first, entries of the
+    // same device next to each other to avoid inter-frame delays
+    for (unsigned i = 0; i < entries_.size(); ++i) {
+        order_.push_back(static_cast<uint8_t>(i));
+    }
+    std::stable_sort(order_.begin(), order_.end(), [this](uint8_t a, uint8_t b) {
+        const Entry& lhs = entries_[a];
+        const Entry& rhs = entries_[b];
+        if (lhs.period != rhs.period) {
+            return lhs.period < rhs.period;
+        }
+        return lhs.device->address() < rhs.device->address();
+    });
+
+    // Place every entry in the least loaded minor cycles.
+    // Entries with shorter periods are placed first as they have
+    // the least freedom.
+    TuragSystemTicks load[TURAG_FELDBUS_BUSSCHEDULER_MAX_MINOR_CYCLES] = { };
+    feasible_ = true;
+
+    for (uint8_t index : order_) {
+        Entry& entry = entries_[index];
+        TuragSystemTicks entryCost = cost(entry).toTicks();
+        entry.minorCyclesPerPeriod = static_cast<unsigned>(entry.period.toTicks() / minor);
+
+        unsigned bestOffset = 0;
+        TuragSystemTicks bestLoad = 0;
+        for (unsigned offset = 0; offset < entry.minorCyclesPerPeriod; ++offset) {
+            TuragSystemTicks maxLoad = 0;
+            for (unsigned k = offset; k < minorCyclesPerMajor_; k += entry.minorCyclesPerPeriod) {
+                maxLoad = std::max(maxLoad, load[k]);
+            }
+            if (offset == 0 || maxLoad < bestLoad) {
+                bestOffset = offset;
+                bestLoad = maxLoad;
+            }
+        }
+
+        entry.offset = bestOffset;
+        for (unsigned k = bestOffset; k < minorCyclesPerMajor_; k += entry.minorCyclesPerPeriod) {
+            load[k] += entryCost;
+            if (load[k] > minor) {
+                feasible_ = false;
+            }
+        }
+
+        utilization_ += static_cast<float>(entryCost) / static_cast<float>(entry.period.toTicks());
+    }
+
+    if (!feasible_) {
+        turag_warningf("BusScheduler %s: schedule not feasible (utilization %u %%)",
+                       bus_.name(), static_cast<unsigned>(utilization_ * 100.0f));
+    }
+
+    started_ = false;
+    return feasible_;
+}
+
+void BusScheduler::processMinorCycle(void)
+{
+    if (minorCyclesPerMajor_ == 0) {
+        // nothing scheduled
+        CurrentThread::delay(SystemTime::fromMsec(10));
+        return;
+    }
+
+    SystemTime now = SystemTime::now();
+    if (!started_) {
+        epoch_ = now;
+        currentMinorCycle_ = 0;
+        started_ = true;
+    }
+
+    SystemTime release = epoch_ + minorCycle_ * currentMinorCycle_;
+    if (now < release) {
+        CurrentThread::delay(release - now);
+    } else if (now >= release + minorCycle_) {
+        // We are late by at least one whole minor cycle. Skip the
+        // elapsed cycles instead of executing them back to back.
+        unsigned skipped = static_cast<unsigned>((now - release).toTicks() / minorCycle_.toTicks());
+        for (unsigned i = 0; i < skipped; ++i) {
+            for (Entry& entry : entries_) {
+                if (isDue(entry, currentMinorCycle_)) {
+                    ++entry.statistics.missedSlots;
+                }
+            }
+            if (++currentMinorCycle_ == minorCyclesPerMajor_) {
+                epoch_ += majorCycle_;
+                currentMinorCycle_ = 0;
+            }
+        }
+        release = epoch_ + minorCycle_ * currentMinorCycle_;
+    }
+
+    for (uint8_t index : order_) {
+        Entry& entry = entries_[index];
+        if (isDue(entry, currentMinorCycle_)) {
+            execute(entry, release);
+        }
+    }
+
+    if (++currentMinorCycle_ == minorCyclesPerMajor_) {
+        epoch_ += majorCycle_;
+        currentMinorCycle_ = 0;
+    }
+}
+
+void BusScheduler::execute(Entry& entry, SystemTime release)
+{
+    SystemTime start = SystemTime::now();
+    SystemTime deadline = release + entry.period;
+    Statistics& statistics = entry.statistics;
+
+    if (start >= deadline) {
+        ++statistics.missedSlots;
+        return;
+    }
+
+    unsigned deadlineMisses = entry.device->getDeadlineMisses();
+    bool success;
+    {
+        // The override fixes the deadline, so all frames of the
+        // operation share what is left of the period.
+        BaseDevice::PriorityOverride priority(*entry.device, entry.priority, deadline - start);
+        success = entry.operation(entry.device, entry.context);
+    }
+    SystemTime end = SystemTime::now();
+
+    ++statistics.executions;
+    if (entry.device->getDeadlineMisses() != deadlineMisses) {
+        ++statistics.missedSlots;
+    } else if (!success) {
+        ++statistics.failures;
+    }
+
+    SystemTime jitter = start > release ? start - release : SystemTime(0);
+    statistics.totalJitter += jitter;
+    statistics.maxJitter = std::max(statistics.maxJitter, jitter);
+    statistics.maxDuration = std::max(statistics.maxDuration, end - start);
+}
+
+void BusScheduler::resetStatistics(void)
+{
+    for (Entry& entry : entries_) {
+        entry.statistics = Statistics();
+    }
+}
+
+
+} // namespace Feldbus
+} // namespace TURAG
+
+#endif // TURAG_USE_TURAG_FELDBUS_HOST
@@ -0,0 +1,241 @@
+#ifndef TINAPP_FELDBUS_HOST_FELDBUS_BUSSCHEDULER_H
+#define TINAPP_FELDBUS_HOST_FELDBUS_BUSSCHEDULER_H
+
+#include <tina++/tina.h>
+#include <tina++/time.h>
+#include <tina++/container/array_buffer.h>
+#include <tina++/feldbus/host/feldbusabstraction.h>
+#include "device.h"
+
+
+#if !TURAG_USE_TURAG_FELDBUS_HOST
+# warning TURAG_USE_TURAG_FELDBUS_HOST must be defined to 1
+#endif
+
+
+/// \addtogroup feldbus-host
+/// \{
+
+/// Maximale Anzahl an Einträgen eines BusSchedulers.
+#if !defined(TURAG_FELDBUS_BUSSCHEDULER_MAX_ENTRIES) || defined(__DOXYGEN__)
+# define TURAG_FELDBUS_BUSSCHEDULER_MAX_ENTRIES		32
+#endif
+
+/// Maximale Anzahl an Nebenzyklen innerhalb eines Hauptzyklus eines BusSchedulers.
+/// Bestimmt den Stackbedarf von BusScheduler::compute().
+#if !defined(TURAG_FELDBUS_BUSSCHEDULER_MAX_MINOR_CYCLES) || defined(__DOXYGEN__)
+# define TURAG_FELDBUS_BUSSCHEDULER_MAX_MINOR_CYCLES	64
+#endif
+
+/// \}
+
+
+namespace TURAG {
+namespace Feldbus {
+
+
+/**
+ * \brief Zyklischer Ablaufplan für periodische Busoperationen.
+ *
+ * Statt jedes Gerät aus einem eigenen %Thread heraus abzufragen, werden Geräte
+ * mit einer Operation (z.B. ASEBBase::sync()) und einer Periode registriert.
+ * compute() berechnet daraus einen statischen, zyklischen Ablaufplan: Der Nebenzyklus
+ * ist der größte gemeinsame Teiler, der Hauptzyklus das kleinste gemeinsame Vielfache
+ * aller Perioden. Die Einträge werden nach Rate-Monotonic-Prinzip (kürzere Periode
+ * zuerst) so auf die Nebenzyklen verteilt, dass die Last pro Nebenzyklus minimal wird.
+ * Die Kosten eines Eintrags berücksichtigen dabei das Paket-Delay, das
+ * FeldbusAbstraction::transceive() beim Wechsel des Zielgerätes einfügt.
+ *
+ * Innerhalb eines Nebenzyklus werden die Operationen in Rate-Monotonic-Reihenfolge
+ * ausgeführt, Einträge eines Gerätes mit gleicher Periode direkt nacheinander.
+ * Jede Operation läuft mit der Priorität ihres Eintrags und einer Deadline, die
+ * dem Ende ihrer Periode entspricht. Sie gilt für alle Pakete der Operation gemeinsam.
+ *
+ * Die Abarbeitung übernimmt ein %Thread, der processMinorCycle() in einer Schleife
+ * aufruft:
+ * \code
+ * scheduler.addEntry(&aseb, [](Device* d, void*) { return static_cast<Aseb*>(d)->sync(); },
+ *                    SystemTime::fromMsec(10));
+ * scheduler.compute();
+ * while (!thread.shouldTerminate()) {
+ *     scheduler.processMinorCycle();
+ * }
+ * \endcode
+ *
+ * Pro Eintrag werden Ausführungen, Fehlschläge, verpasste Slots und der Jitter
+ * des Startzeitpunkts erfasst.
+ *
+ * \note Ist für einen Eintrag keine Dauer angegeben, wird die gemessene
+ * maximale Dauer verwendet. Ein erneuter Aufruf von compute() nach einer gewissen
+ * Laufzeit passt den Ablaufplan an die gemessenen Werte an.
+ */
+class BusScheduler {
+    BusScheduler(const BusScheduler&) = delete;
+    BusScheduler& operator=(const BusScheduler&) = delete;
+
+public:
+    /**
+     * \brief Periodisch auszuführende Operation.
+     * \param device Gerät des Eintrags.
+     * \param context Bei der Registrierung angegebener Zeiger.
+     * \return True bei Erfolg.
+     */
+    typedef bool (*Operation)(Device* device, void* context);
+
+    /// Statistiken eines Eintrags.
+    struct Statistics {
+        Statistics() :
+            executions(0), failures(0), missedSlots(0),
+            maxJitter(0), totalJitter(0), maxDuration(0)
+        { }
+
+        /// Anzahl der Ausführungen.
+        unsigned executions;
+        /// Anzahl der Ausführungen, bei denen die Operation false zurückgab.
+        unsigned failures;
+        /// Anzahl der Slots, die ausgelassen wurden oder deren Deadline verpasst wurde.
+        unsigned missedSlots;
+        /// Maximale Verzögerung des Starts gegenüber dem Beginn des Nebenzyklus.
+        SystemTime maxJitter;
+        /// Summe der Verzögerungen aller Ausführungen.
+        SystemTime totalJitter;
+        /// Maximale gemessene Dauer der Operation.
+        SystemTime maxDuration;
+
+        /// Durchschnittliche Verzögerung des Starts.
+        SystemTime averageJitter(void) const {
+            return executions ? SystemTime(totalJitter.toTicks() / executions) : SystemTime(0);
+        }
+    };
+
+    /**
+     * \brief Konstruktor.
+     * \param bus Bus, dessen Geräte geplant werden.
+     * \param interFrameDelay Dauer des Paket-Delays des Busses. Ist sie 0, werden
+     * 15 Bitzeiten bei der jeweils aktuellen Baudrate des Busses angenommen.
+     */
+    explicit BusScheduler(FeldbusAbstraction& bus, SystemTime interFrameDelay = SystemTime(0)) :
+        bus_(bus), interFrameDelay_(interFrameDelay),
+        minorCycle_(0), majorCycle_(0), minorCyclesPerMajor_(0),
+        utilization_(0.0f), feasible_(false),
+        started_(false), epoch_(0), currentMinorCycle_(0)
+    { }
+
+    /**
+     * \brief Registriert eine periodische Operation.
+     * \param device Gerät, das sich am Bus des Schedulers befinden muss.
+     * \param operation Auszuführende Operation.
+     * \param period Periode. Sollte ein Vielfaches einer gemeinsamen Basis sein,
+     * damit der Hauptzyklus kurz bleibt.
+     * \param duration Maximale Busbelegung der Operation. Ist sie 0, wird
+     * die gemessene Dauer verwendet.
+     * \param context Beliebiger Zeiger, der der Operation übergeben wird.
+     * \param priority Prioritätsklasse, mit der die Operation den Bus anfordert.
+     * \param frameBytes Länge aller Anfragen und Antworten der Operation inklusive
+     * Adresse und Checksumme. Solange weder \a duration angegeben noch eine Dauer
+     * gemessen ist, wird die Dauer daraus und aus der Baudrate des Busses abgeschätzt.
+     * \return Index des Eintrags oder -1, falls die Registrierung fehlschlug.
+     *
+     * Nach Änderungen an den Einträgen muss compute() aufgerufen werden.
+     */
+    int addEntry(Device* device, Operation operation, SystemTime period,
+                 SystemTime duration = SystemTime(0), void* context = nullptr,
+                 TransmissionPriority priority = TransmissionPriority::control,
+                 unsigned frameBytes = 0);
+
+    /// Entfernt alle Einträge.
+    void clear(void);
+
+    /**
+     * \brief Berechnet den Ablaufplan.
+     * \return True, wenn alle Einträge innerhalb ihres Nebenzyklus Platz finden.
+     *
+     * Auch wenn der Plan nicht einhaltbar ist, wird er berechnet und kann ausgeführt werden;
+     * die betroffenen Einträge verpassen dann Slots.
+     */
+    bool compute(void);
+
+    /**
+     * \brief Führt den nächsten Nebenzyklus aus.
+     *
+     * Blockiert bis zum Beginn des nächsten Nebenzyklus und führt alle darin
+     * fälligen Operationen aus. Ist die Ausführung so weit verzögert, dass ganze
+     * Nebenzyklen verstrichen sind, werden diese übersprungen und deren Einträge
+     * als verpasst gezählt.
+     */
+    void processMinorCycle(void);
+
+    /// Setzt den Ablauf zurück, sodass der nächste Nebenzyklus sofort beginnt.
+    void restart(void) { started_ = false; }
+
+    /// Setzt die Statistiken aller Einträge zurück.
+    void resetStatistics(void);
+
+    /// Anzahl der Einträge.
+    unsigned size(void) const { return entries_.size(); }
+
+    /// Statistiken des Eintrags \a index.
+    const Statistics& statistics(unsigned index) const { return entries_[index].statistics; }
+
+    /// Gerät des Eintrags \a index.
+    Device* device(unsigned index) const { return entries_[index].device; }
+
+    /// Dauer eines Nebenzyklus.
+    SystemTime minorCycle(void) const { return minorCycle_; }
+
+    /// Dauer eines Hauptzyklus.
+    SystemTime majorCycle(void) const { return majorCycle_; }
+
+    /// Geschätzte Busauslastung durch alle Einträge zwischen 0 und 1.
+    float utilization(void) const { return utilization_; }
+
+    /// Gibt zurück, ob der zuletzt berechnete Plan einhaltbar ist.
+    bool isFeasible(void) const { return feasible_; }
+
+private:
+    struct Entry {
+        Device* device;
+        Operation operation;
+        void* context;
+        SystemTime period;
+        SystemTime duration;
+        TransmissionPriority priority;
+        unsigned frameBytes;
+
+        // position within the schedule
+        unsigned minorCyclesPerPeriod;
+        unsigned offset;
+
+        Statistics statistics;
+    };
+
+    bool isDue(const Entry& entry, unsigned minorCycle) const {
+        return minorCycle % entry.minorCyclesPerPeriod == entry.offset;
+    }
+    SystemTime interFrameDelay(void) const;
+    SystemTime cost(const Entry& entry) const;
+    void execute(Entry& entry, SystemTime release);
+
+    FeldbusAbstraction& bus_;
+    SystemTime interFrameDelay_;
+
+    ArrayBuffer<Entry, TURAG_FELDBUS_BUSSCHEDULER_MAX_ENTRIES> entries_;
+    // execution order within a minor cycle as indices into entries_
+    ArrayBuffer<uint8_t, TURAG_FELDBUS_BUSSCHEDULER_MAX_ENTRIES> order_;
+
+    SystemTime minorCycle_;
+    SystemTime majorCycle_;
+    unsigned minorCyclesPerMajor_;
+    float utilization_;
+    bool feasible_;
+
+    bool started_;
+    SystemTime epoch_;
+    unsigned currentMinorCycle_;
+};
+
+
+} // namespace Feldbus
+} // namespace TURAG
+
+#endif // TINAPP_FELDBUS_HOST_FELDBUS_BUSSCHEDULER_H
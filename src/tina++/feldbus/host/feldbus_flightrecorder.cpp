@@ -0,0 +1,235 @@
+#define TURAG_DEBUG_LOG_SOURCE "B"
+
+#include <tina++/tina.h>
+
+#if TURAG_USE_TURAG_FELDBUS_HOST
+
+#include <tina++/thread.h>
+#include <tina/debug/print.h>
+#include <algorithm>
+#include <cstring>
+
+#include "feldbus_flightrecorder.h"
+#include "feldbus_littleendian.h"
+
+
+namespace TURAG {
+namespace Feldbus {
+
+namespace {
+
+using detail::putUint16;
+using detail::putUint32;
+using detail::putUint64;
+using detail::getUint16;
+using detail::getUint32;
+using detail::getUint64;
+
+constexpr uint8_t formatVersion = 1;
+
+// size of the serialized header and of the fixed part of a record
+constexpr size_t headerSize = 10;
+constexpr size_t recordHeaderSize = 18;
+
+unsigned recordedBytes(unsigned length) {
+    return std::min<unsigned>(length, TURAG_FELDBUS_FLIGHTRECORDER_MAX_PAYLOAD);
+}
+
+} // namespace
+
+
+FlightRecorder::FlightRecorder(Slot* slots, unsigned capacity) :
+    slots_(slots), capacity_(capacity), writeIndex_(0)
+{
+    for (unsigned i = 0; i < capacity_; ++i) {
+        slots_[i].sequence.store(0, std::memory_order_relaxed);
+    }
+}
+
+void FlightRecorder::record(SystemTime timestamp, unsigned address, ChecksumType checksumType,
+                            const uint8_t* request, int requestLength,
+                            const uint8_t* response, int expectedResponseLength, int responseLength,
+                            FeldbusAbstraction::ResultStatus status, unsigned attempt)
+{
+    if (capacity_ == 0) {
+        return;
+    }
+
+    // Every writer gets its own slot, so concurrent buses can share a recorder.
+    // The sequence number marks the slot as invalid while it is written, which
+    // lets dump() detect records that were overwritten while being read.
+    const uint32_t index = writeIndex_.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = slots_[index % capacity_];
+    slot.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    Record& entry = slot.record;
+    entry.timestamp = timestamp.toTicks();
+    entry.requestLength = request ? static_cast<uint16_t>(std::max(0, requestLength)) : 0;
+    entry.expectedResponseLength = static_cast<uint16_t>(std::max(0, expectedResponseLength));
+    entry.responseLength = response ? static_cast<uint16_t>(std::max(0, responseLength)) : 0;
+    entry.address = static_cast<uint8_t>(address);
+    entry.status = static_cast<uint8_t>(status);
+    entry.attempt = static_cast<uint8_t>(std::min(attempt, 255u));
+    entry.checksumType = static_cast<uint8_t>(checksumType);
+    if (entry.requestLength) {
+        std::memcpy(entry.request, request, recordedBytes(entry.requestLength));
+    }
+    if (entry.responseLength) {
+        std::memcpy(entry.response, response, recordedBytes(entry.responseLength));
+    }
+
+    slot.sequence.store(index + 1, std::memory_order_release);
+}
+
+int FlightRecorder::dump(WriteFunction write, void* context) const
+{
+    uint8_t header[headerSize] = { 'T', 'F', 'R', formatVersion };
+    putUint16(header + 4, TURAG_FELDBUS_FLIGHTRECORDER_MAX_PAYLOAD);
+    putUint32(header + 6, SystemTime::frequency());
+    if (!write(header, sizeof(header), context)) {
+        return -1;
+    }
+
+    const uint32_t end = writeIndex_.load(std::memory_order_acquire);
+    const uint32_t begin = end > capacity_ ? end - capacity_ : 0;
+    int written = 0;
+
+    for (uint32_t index = begin; index != end; ++index) {
+        const Slot& slot = slots_[index % capacity_];
+
+        // copy the record and make sure it was not touched in the meantime
+        if (slot.sequence.load(std::memory_order_acquire) != index + 1) {
+            continue;
+        }
+        Record entry = slot.record;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != index + 1) {
+            continue;
+        }
+
+        uint8_t buffer[recordHeaderSize + 2 * TURAG_FELDBUS_FLIGHTRECORDER_MAX_PAYLOAD];
+        putUint64(buffer, entry.timestamp);
+        putUint16(buffer + 8, entry.requestLength);
+        putUint16(buffer + 10, entry.expectedResponseLength);
+        putUint16(buffer + 12, entry.responseLength);
+        buffer[14] = entry.address;
+        buffer[15] = entry.status;
+        buffer[16] = entry.attempt;
+        buffer[17] = entry.checksumType;
+        size_t size = recordHeaderSize;
+        std::memcpy(buffer + size, entry.request, recordedBytes(entry.requestLength));
+        size += recordedBytes(entry.requestLength);
+        std::memcpy(buffer + size, entry.response, recordedBytes(entry.responseLength));
+        size += recordedBytes(entry.responseLength);
+
+        if (!write(buffer, size, context)) {
+            return -1;
+        }
+        ++written;
+    }
+
+    return written;
+}
+
+void FlightRecorder::clear(void)
+{
+    for (unsigned i = 0; i < capacity_; ++i) {
+        slots_[i].sequence.store(0, std::memory_order_relaxed);
+    }
+    writeIndex_.store(0, std::memory_order_release);
+}
+
+
+bool FlightRecorderReplayer::replay(ReadFunction read, void* context, Result* result)
+{
+    *result = Result();
+
+    uint8_t header[headerSize];
+    if (!read(header, sizeof(header), context) ||
+            header[0] != 'T' || header[1] != 'F' || header[2] != 'R') {
+        turag_errorf("%s: no flight recorder data", bus_.name());
+        return false;
+    }
+    if (header[3] != formatVersion) {
+        turag_errorf("%s: unsupported flight recorder format version %u", bus_.name(), header[3]);
+        return false;
+    }
+    const unsigned maxPayload = getUint16(header + 4);
+    const uint64_t frequency = getUint32(header + 6);
+    if (maxPayload > TURAG_FELDBUS_FLIGHTRECORDER_MAX_PAYLOAD || frequency == 0) {
+        turag_errorf("%s: flight recorder data needs a payload size of %u", bus_.name(), maxPayload);
+        return false;
+    }
+
+    bool first = true;
+    uint64_t firstTimestamp = 0;
+    uint64_t lastTimestamp = 0;
+    const SystemTime replayStart = SystemTime::now();
+
+    uint8_t recordHeader[recordHeaderSize];
+    while (read(recordHeader, sizeof(recordHeader), context)) {
+        const uint64_t timestamp = getUint64(recordHeader);
+        const unsigned requestLength = getUint16(recordHeader + 8);
+        const unsigned expectedResponseLength = getUint16(recordHeader + 10);
+        const unsigned responseLength = getUint16(recordHeader + 12);
+        const uint8_t address = recordHeader[14];
+        const auto status = static_cast<FeldbusAbstraction::ResultStatus>(recordHeader[15]);
+        const auto checksumType = static_cast<ChecksumType>(recordHeader[17]);
+
+        uint8_t request[TURAG_FELDBUS_FLIGHTRECORDER_MAX_PAYLOAD];
+        uint8_t recordedResponse[TURAG_FELDBUS_FLIGHTRECORDER_MAX_PAYLOAD];
+        if (!read(request, std::min(requestLength, maxPayload), context) ||
+                !read(recordedResponse, std::min(responseLength, maxPayload), context)) {
+            turag_errorf("%s: flight recorder data truncated", bus_.name());
+            return false;
+        }
+
+        if (first) {
+            firstTimestamp = timestamp;
+            first = false;
+        }
+        lastTimestamp = timestamp;
+
+        if (requestLength > maxPayload || expectedResponseLength > maxPayload ||
+                status == FeldbusAbstraction::ResultStatus::DeadlineMissed) {
+            ++result->skipped;
+            continue;
+        }
+
+        if (preserveTiming_) {
+            const SystemTime due = replayStart + SystemTime(static_cast<TuragSystemTicks>(
+                        (timestamp - firstTimestamp) * SystemTime::frequency() / frequency));
+            const SystemTime now = SystemTime::now();
+            if (due > now) {
+                CurrentThread::delay(due - now);
+            }
+        }
+
+        uint8_t response[TURAG_FELDBUS_FLIGHTRECORDER_MAX_PAYLOAD];
+        int transmitLength = requestLength;
+        int receiveLength = expectedResponseLength;
+        FeldbusAbstraction::ResultStatus replayStatus = bus_.transceive(
+                    request, &transmitLength, response, &receiveLength, address, checksumType);
+        ++result->replayed;
+
+        if (replayStatus != status) {
+            ++result->statusMismatches;
+        } else if (status == FeldbusAbstraction::ResultStatus::Success &&
+                   (static_cast<unsigned>(receiveLength) != responseLength ||
+                    std::memcmp(response, recordedResponse, responseLength) != 0)) {
+            ++result->responseMismatches;
+        }
+    }
+
+    result->recordedDuration = SystemTime(static_cast<TuragSystemTicks>(
+                (lastTimestamp - firstTimestamp) * SystemTime::frequency() / frequency));
+    result->replayDuration = SystemTime::now() - replayStart;
+    return true;
+}
+
+
+} // namespace Feldbus
+} // namespace TURAG
+
+#endif // TURAG_USE_TURAG_FELDBUS_HOST
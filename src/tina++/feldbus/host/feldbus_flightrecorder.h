@@ -0,0 +1,224 @@
+#ifndef TINAPP_FELDBUS_HOST_FELDBUS_FLIGHTRECORDER_H
+#define TINAPP_FELDBUS_HOST_FELDBUS_FLIGHTRECORDER_H
+
+#include <tina++/tina.h>
+#include <tina++/time.h>
+#include <tina++/feldbus/host/feldbusabstraction.h>
+
+#include <atomic>
+
+
+#if !TURAG_USE_TURAG_FELDBUS_HOST
+# warning TURAG_USE_TURAG_FELDBUS_HOST must be defined to 1
+#endif
+
+
+/// \addtogroup feldbus-host
+/// \{
+
+/// Maximale Anzahl an Bytes von Anfrage und Antwort, die der FlightRecorder
+/// pro Übertragung speichert. Längere Pakete werden abgeschnitten.
+#if !defined(TURAG_FELDBUS_FLIGHTRECORDER_MAX_PAYLOAD) || defined(__DOXYGEN__)
+# define TURAG_FELDBUS_FLIGHTRECORDER_MAX_PAYLOAD	32
+#endif
+
+/// \}
+
+
+namespace TURAG {
+namespace Feldbus {
+
+
+/**
+ * \brief Zeichnet alle Übertragungen eines Busses in einem Ringpuffer auf.
+ *
+ * Ein FlightRecorder wird mit FeldbusAbstraction::setFlightRecorder() an einen
+ * Bus gehängt und speichert dann für jede Übertragung Zeitstempel, Zieladresse,
+ * Anfrage- und Antwortbytes, das Ergebnis und die Nummer des Übertragungsversuchs.
+ * Ist der Puffer voll, werden die ältesten Einträge überschrieben.
+ *
+ * Das Aufzeichnen ist lock-frei und kostet im Wesentlichen das Kopieren der
+ * Paketdaten. Es kann parallel zum Aufzeichnen mit dump() in ein kompaktes
+ * Binärformat ausgelesen werden, das FlightRecorderReplayer wieder abspielen kann:
+ * \code
+ * FlightRecorderStorage<1024> recorder;
+ * bus.setFlightRecorder(&recorder);
+ * ...
+ * FILE* file = fopen("bus.trace", "wb");
+ * recorder.dump([](const void* data, size_t size, void* f) {
+ *     return fwrite(data, 1, size, static_cast<FILE*>(f)) == size;
+ * }, file);
+ * \endcode
+ *
+ * Das Binärformat besteht aus einem Kopf (Kennung "TFR", Version, maximale
+ * Nutzdatenlänge, Frequenz der Zeitstempel) und den Einträgen in zeitlicher
+ * Reihenfolge. Jeder Eintrag enthält nur so viele Anfrage- und Antwortbytes, wie
+ * tatsächlich aufgezeichnet wurden. Alle Zahlen sind Little-Endian.
+ *
+ * \note clear() darf nicht gleichzeitig mit laufenden Übertragungen aufgerufen werden.
+ */
+class FlightRecorder {
+    FlightRecorder(const FlightRecorder&) = delete;
+    FlightRecorder& operator=(const FlightRecorder&) = delete;
+
+public:
+    /// Aufgezeichnete Übertragung.
+    struct Record {
+        /// Systemzeit in Ticks zu Beginn der Übertragung.
+        uint64_t timestamp;
+        /// Länge der gesendeten Daten.
+        uint16_t requestLength;
+        /// Erwartete Länge der Antwort.
+        uint16_t expectedResponseLength;
+        /// Länge der tatsächlich empfangenen Antwort.
+        uint16_t responseLength;
+        /// Zieladresse.
+        uint8_t address;
+        /// Ergebnis als FeldbusAbstraction::ResultStatus.
+        uint8_t status;
+        /// Nummer des Übertragungsversuchs, beginnend mit 1.
+        uint8_t attempt;
+        /// Checksummentyp als ChecksumType.
+        uint8_t checksumType;
+        /// Anfang der gesendeten Daten.
+        uint8_t request[TURAG_FELDBUS_FLIGHTRECORDER_MAX_PAYLOAD];
+        /// Anfang der empfangenen Daten.
+        uint8_t response[TURAG_FELDBUS_FLIGHTRECORDER_MAX_PAYLOAD];
+    };
+
+    /// Eintrag des Ringpuffers.
+    struct Slot {
+        // 0 while being written, otherwise index of the record + 1
+        std::atomic<uint32_t> sequence;
+        Record record;
+    };
+
+    /**
+     * \brief Funktionstyp zum Ausgeben der Binärdaten.
+     * \return False, wenn das Schreiben fehlschlug.
+     */
+    typedef bool (*WriteFunction)(const void* data, size_t size, void* context);
+
+    /**
+     * \brief Konstruktor.
+     * \param slots Speicher für die Einträge.
+     * \param capacity Anzahl der Einträge.
+     */
+    FlightRecorder(Slot* slots, unsigned capacity);
+
+    /**
+     * \brief Zeichnet eine Übertragung auf.
+     *
+     * Wird von FeldbusAbstraction::transceive() aufgerufen.
+     */
+    void record(SystemTime timestamp, unsigned address, ChecksumType checksumType,
+                const uint8_t* request, int requestLength,
+                const uint8_t* response, int expectedResponseLength, int responseLength,
+                FeldbusAbstraction::ResultStatus status, unsigned attempt);
+
+    /**
+     * \brief Gibt den Inhalt des Puffers im Binärformat aus.
+     * \param write Funktion, die die Daten schreibt.
+     * \param context Beliebiger Zeiger, der write übergeben wird.
+     * \return Anzahl der ausgegebenen Einträge oder -1 bei einem Schreibfehler.
+     *
+     * Einträge, die während der Ausgabe überschrieben werden, werden ausgelassen.
+     */
+    int dump(WriteFunction write, void* context) const;
+
+    /// Verwirft alle Einträge.
+    void clear(void);
+
+    /// Anzahl der seit dem letzten clear() aufgezeichneten Übertragungen.
+    unsigned recordedTransmissions(void) const { return writeIndex_; }
+
+    /// Kapazität des Ringpuffers.
+    unsigned capacity(void) const { return capacity_; }
+
+private:
+    Slot* slots_;
+    const unsigned capacity_;
+    std::atomic<uint32_t> writeIndex_;
+};
+
+
+/**
+ * \brief FlightRecorder mit statisch alloziertem Speicher.
+ * \tparam Capacity Anzahl der Einträge.
+ */
+template<unsigned Capacity>
+class FlightRecorderStorage : public FlightRecorder {
+public:
+    FlightRecorderStorage() :
+        FlightRecorder(storage_, Capacity)
+    { }
+
+private:
+    Slot storage_[Capacity];
+};
+
+
+/**
+ * \brief Spielt eine mit FlightRecorder::dump() erzeugte Aufzeichnung auf einem Bus ab.
+ *
+ * Die aufgezeichneten Anfragen werden mit ihrem ursprünglichen zeitlichen Abstand
+ * (oder so schnell wie möglich) erneut gesendet und die Ergebnisse mit der
+ * Aufzeichnung verglichen. Damit lassen sich Timingprobleme reproduzieren und
+ * Änderungen am Host mit realem Verkehr vergleichen, z.B. auf einem VirtualFeldbus.
+ *
+ * Übersprungen werden Einträge, deren Anfrage oder Antwort beim Aufzeichnen abgeschnitten
+ * wurde, sowie Übertragungen, die wegen einer abgelaufenen Deadline nie gesendet wurden.
+ */
+class FlightRecorderReplayer {
+public:
+    /**
+     * \brief Funktionstyp zum Einlesen der Binärdaten.
+     * \return False, wenn nicht genügend Daten gelesen werden konnten.
+     */
+    typedef bool (*ReadFunction)(void* data, size_t size, void* context);
+
+    /// Ergebnis des Abspielens.
+    struct Result {
+        /// Anzahl der abgespielten Einträge.
+        unsigned replayed;
+        /// Anzahl der übersprungenen Einträge.
+        unsigned skipped;
+        /// Anzahl der Einträge, deren Ergebnis von der Aufzeichnung abweicht.
+        unsigned statusMismatches;
+        /// Anzahl der erfolgreichen Einträge, deren Antwort von der Aufzeichnung abweicht.
+        unsigned responseMismatches;
+        /// Dauer der Aufzeichnung.
+        SystemTime recordedDuration;
+        /// Dauer des Abspielens.
+        SystemTime replayDuration;
+    };
+
+    /**
+     * \brief Konstruktor.
+     * \param bus Bus, auf dem die Aufzeichnung abgespielt wird.
+     * \param preserveTiming Gibt an, ob die zeitlichen Abstände der Aufzeichnung
+     * eingehalten werden sollen.
+     */
+    explicit FlightRecorderReplayer(FeldbusAbstraction& bus, bool preserveTiming = true) :
+        bus_(bus), preserveTiming_(preserveTiming)
+    { }
+
+    /**
+     * \brief Spielt eine Aufzeichnung ab.
+     * \param read Funktion, die die Binärdaten liefert.
+     * \param context Beliebiger Zeiger, der read übergeben wird.
+     * \param result Ergebnis des Abspielens.
+     * \return False, wenn die Aufzeichnung nicht gelesen werden konnte.
+     */
+    bool replay(ReadFunction read, void* context, Result* result);
+
+private:
+    FeldbusAbstraction& bus_;
+    bool preserveTiming_;
+};
+
+
+} // namespace Feldbus
+} // namespace TURAG
+
+#endif // TINAPP_FELDBUS_HOST_FELDBUS_FLIGHTRECORDER_H
@@ -0,0 +1,113 @@
+#define TURAG_DEBUG_LOG_SOURCE "B"
+
+#include <tina++/tina.h>
+
+#if TURAG_USE_TURAG_FELDBUS_HOST
+
+#include <tina++/thread.h>
+#include <tina/debug/print.h>
+
+#include "feldbus_healthmonitor.h"
+
+
+namespace TURAG {
+namespace Feldbus {
+
+
+void HealthMonitor::updateDeviceList(void)
+{
+    // devices may be created by other threads while we walk the list
+    Mutex::Lock lock(Device::listMutex);
+
+    Device* first = Device::getFirstDevice();
+
+    for (Device* device = first; device && device != knownFirstDevice_; device = device->getNextDevice()) {
+        if (bus_ && &device->bus() != bus_) {
+            continue;
+        }
+        if (entries_.size() == entries_.max_size()) {
+            turag_errorf("HealthMonitor: too many devices, %s is not monitored", device->name());
+            continue;
+        }
+
+        Entry entry;
+        entry.device = device;
+        entry.nextProbe = SystemTime(0);
+        entry.backoff = minBackoff_;
+        entry.dysfunctional = false;
+        entries_.push_back(entry);
+    }
+
+    knownFirstDevice_ = first;
+}
+
+void HealthMonitor::probe(Entry& entry, SystemTime now)
+{
+    bool success;
+    {
+        BaseDevice::PriorityOverride background(*entry.device, TransmissionPriority::background, probeDeadline_);
+        success = entry.device->sendPing();
+    }
+    ++probes_;
+
+    if (!entry.dysfunctional) {
+        return;
+    }
+
+    if (success) {
+        turag_infof("%s: device is available again", entry.device->name());
+        entry.dysfunctional = false;
+        ++recoveries_;
+    } else {
+        SystemTime backoff = entry.backoff + entry.backoff;
+        entry.backoff = backoff < maxBackoff_ ? backoff : maxBackoff_;
+        entry.nextProbe = now + entry.backoff;
+    }
+}
+
+void HealthMonitor::process(void)
+{
+    updateDeviceList();
+
+    SystemTime now = SystemTime::now();
+    SystemTime next = now + minBackoff_;
+
+    for (Entry& entry : entries_) {
+        switch (entry.device->availability()) {
+        case Device::Availability::unknown:
+            // not checked yet, one ping per pass until it answers or becomes dysfunctional
+            probe(entry, now);
+            break;
+
+        case Device::Availability::available:
+            entry.dysfunctional = false;
+            break;
+
+        case Device::Availability::unavailable:
+            if (!entry.dysfunctional) {
+                // just failed, start with the shortest backoff
+                entry.dysfunctional = true;
+                entry.backoff = minBackoff_;
+                entry.nextProbe = now + minBackoff_;
+            } else if (now >= entry.nextProbe) {
+                probe(entry, now);
+                now = SystemTime::now();
+            }
+            if (entry.dysfunctional && entry.nextProbe < next) {
+                next = entry.nextProbe;
+            }
+            break;
+        }
+    }
+
+    now = SystemTime::now();
+    if (next > now) {
+        CurrentThread::delay(next - now);
+    }
+}
+
+
+} // namespace Feldbus
+} // namespace TURAG
+
+#endif // TURAG_USE_TURAG_FELDBUS_HOST
@@ -0,0 +1,134 @@
+#ifndef TINAPP_FELDBUS_HOST_FELDBUS_HEALTHMONITOR_H
+#define TINAPP_FELDBUS_HOST_FELDBUS_HEALTHMONITOR_H
+
+#include <tina++/tina.h>
+#include <tina++/time.h>
+#include <tina++/container/array_buffer.h>
+#include <tina++/feldbus/host/feldbusabstraction.h>
+#include "device.h"
+
+
+#if !TURAG_USE_TURAG_FELDBUS_HOST
+# warning TURAG_USE_TURAG_FELDBUS_HOST must be defined to 1
+#endif
+
+
+/// \addtogroup feldbus-host
+/// \{
+
+/// Maximale Anzahl an Geräten, die ein HealthMonitor überwacht.
+#if !defined(TURAG_FELDBUS_HEALTHMONITOR_MAX_DEVICES) || defined(__DOXYGEN__)
+# define TURAG_FELDBUS_HEALTHMONITOR_MAX_DEVICES		64
+#endif
+
+/// \}
+
+
+namespace TURAG {
+namespace Feldbus {
+
+
+/**
+ * \brief Überwacht die Erreichbarkeit von Geräten im Hintergrund.
+ *
+ * Statt beim Start für jedes Gerät blockierend Device::isAvailable() aufzurufen
+ * und dysfunktionale Geräte von Hand zurückzuholen, übernimmt ein eigener %Thread
+ * diese Aufgabe:
+ * \code
+ * HealthMonitor monitor(&bus);
+ * while (!thread.shouldTerminate()) {
+ *     monitor.process();
+ * }
+ * \endcode
+ *
+ * Bisher ungeprüfte Geräte werden mit einem Ping geprüft, bis sie antworten
+ * oder dysfunktional werden. Dysfunktionale Geräte werden mit exponentiell
+ * wachsendem Abstand weiter angepingt und sind wieder verfügbar, sobald sie
+ * antworten. Alle Pings laufen mit der Priorität TransmissionPriority::background
+ * und einer kurzen Deadline, sodass sie nur in Lücken des übrigen Busverkehrs
+ * gesendet werden.
+ *
+ * Die Anwendung fragt den Zustand mit Device::availability() ab, was keine
+ * Buslast verursacht und nie blockiert.
+ *
+ * Überwacht werden alle Geräte der globalen Geräteliste (Device::getFirstDevice()),
+ * optional eingeschränkt auf einen Bus. Später erstellte Geräte werden beim
+ * nächsten Durchlauf automatisch aufgenommen.
+ *
+ * Der Monitor speichert Zeiger auf die überwachten Geräte. Diese müssen
+ * deshalb mindestens so lange existieren wie der Monitor selbst.
+ */
+class HealthMonitor {
+    HealthMonitor(const HealthMonitor&) = delete;
+    HealthMonitor& operator=(const HealthMonitor&) = delete;
+
+public:
+    /**
+     * \brief Konstruktor.
+     * \param bus Bus, dessen Geräte überwacht werden, oder nullptr für alle Geräte.
+     * \param minBackoff Abstand des ersten Pings, nachdem ein Gerät dysfunktional wurde.
+     * Bestimmt außerdem, wie oft neue und neu ausgefallene Geräte erkannt werden.
+     * \param maxBackoff Größter Abstand zwischen zwei Pings an ein dysfunktionales Gerät.
+     */
+    explicit HealthMonitor(FeldbusAbstraction* bus = nullptr,
+                           SystemTime minBackoff = SystemTime::fromMsec(100),
+                           SystemTime maxBackoff = SystemTime::fromSec(10)) :
+        bus_(bus), minBackoff_(minBackoff), maxBackoff_(maxBackoff),
+        probeDeadline_(SystemTime::fromMsec(20)), knownFirstDevice_(nullptr),
+        probes_(0), recoveries_(0)
+    { }
+
+    /**
+     * \brief Legt fest, wie lange ein Ping auf die Zuteilung des Busses warten darf.
+     *
+     * Ist der Bus länger belegt, wird der Ping verworfen und später wiederholt.
+     */
+    void setProbeDeadline(SystemTime deadline) { probeDeadline_ = deadline; }
+
+    /**
+     * \brief Führt einen Durchlauf aus.
+     *
+     * Sendet alle fälligen Pings und blockiert danach bis zum nächsten
+     * fälligen Ping, höchstens jedoch für die minimale Backoff-Zeit.
+     */
+    void process(void);
+
+    /// Anzahl der bisher gesendeten Pings.
+    unsigned probes(void) const { return probes_; }
+
+    /// Anzahl der Geräte, die nach einem Ausfall wieder verfügbar wurden.
+    unsigned recoveries(void) const { return recoveries_; }
+
+    /// Anzahl der überwachten Geräte.
+    unsigned size(void) const { return entries_.size(); }
+
+private:
+    struct Entry {
+        Device* device;
+        SystemTime nextProbe;
+        SystemTime backoff;
+        bool dysfunctional;
+    };
+
+    void updateDeviceList(void);
+    void probe(Entry& entry, SystemTime now);
+
+    FeldbusAbstraction* bus_;
+    SystemTime minBackoff_;
+    SystemTime maxBackoff_;
+    SystemTime probeDeadline_;
+
+    ArrayBuffer<Entry, TURAG_FELDBUS_HEALTHMONITOR_MAX_DEVICES> entries_;
+    // head of the global device list at the last update,
+    // new devices are always inserted in front of it
+    Device* knownFirstDevice_;
+
+    unsigned probes_;
+    unsigned recoveries_;
+};
+
+
+} // namespace Feldbus
+} // namespace TURAG
+
+#endif // TINAPP_FELDBUS_HOST_FELDBUS_HEALTHMONITOR_H
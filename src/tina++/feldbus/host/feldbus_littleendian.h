@@ -0,0 +1,44 @@
+#ifndef TINAPP_FELDBUS_HOST_FELDBUS_LITTLEENDIAN_H
+#define TINAPP_FELDBUS_HOST_FELDBUS_LITTLEENDIAN_H
+
+#include <tina++/tina.h>
+
+// Internal helpers for the byte order independent file formats of
+// MetadataCache and FlightRecorder. Not part of the public interface.
+
+namespace TURAG {
+namespace Feldbus {
+namespace detail {
+
+inline void putUint16(uint8_t* buffer, uint16_t value) {
+    buffer[0] = value & 0xFF;
+    buffer[1] = value >> 8;
+}
+
+inline void putUint32(uint8_t* buffer, uint32_t value) {
+    putUint16(buffer, value & 0xFFFF);
+    putUint16(buffer + 2, value >> 16);
+}
+
+inline void putUint64(uint8_t* buffer, uint64_t value) {
+    putUint32(buffer, value & 0xFFFFFFFF);
+    putUint32(buffer + 4, value >> 32);
+}
+
+inline uint16_t getUint16(const uint8_t* buffer) {
+    return buffer[0] | (buffer[1] << 8);
+}
+
+inline uint32_t getUint32(const uint8_t* buffer) {
+    return getUint16(buffer) | (static_cast<uint32_t>(getUint16(buffer + 2)) << 16);
+}
+
+inline uint64_t getUint64(const uint8_t* buffer) {
+    return getUint32(buffer) | (static_cast<uint64_t>(getUint32(buffer + 4)) << 32);
+}
+
+} // namespace detail
+} // namespace Feldbus
+} // namespace TURAG
+
+#endif // TINAPP_FELDBUS_HOST_FELDBUS_LITTLEENDIAN_H
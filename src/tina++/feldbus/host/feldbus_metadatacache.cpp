@@ -0,0 +1,350 @@
+#define TURAG_DEBUG_LOG_SOURCE "B"
+
+#include <tina++/tina.h>
+
+#if TURAG_USE_TURAG_FELDBUS_HOST
+
+#include <tina++/crc/fnv.h>
+#include <tina/debug/print.h>
+#include <algorithm>
+#include <cstring>
+
+#include "feldbus_metadatacache.h"
+#include "feldbus_littleendian.h"
+
+
+namespace TURAG {
+namespace Feldbus {
+
+namespace {
+
+using detail::putUint16;
+using detail::putUint32;
+using detail::getUint16;
+using detail::getUint32;
+
+constexpr uint8_t formatVersion = 1;
+
+constexpr size_t headerSize = 4;
+
+// fixed part of a serialized entry and the largest entry we can hold
+constexpr size_t entryHeaderSize = 13;
+constexpr size_t maxEntrySize = entryHeaderSize + 2 * TURAG_FELDBUS_METADATACACHE_MAX_STRING +
+        2 + TURAG_FELDBUS_METADATACACHE_MAX_DATA;
+
+} // namespace
+
+
+uint32_t MetadataCache::fingerprint(const Device::DeviceInfo& deviceInfo)
+{
+    const uint8_t data[] = {
+        deviceInfo.deviceProtocolId(),
+        deviceInfo.deviceTypeId(),
+        static_cast<uint8_t>(static_cast<uint8_t>(deviceInfo.crcType()) |
+                             (deviceInfo.legacyDeviceInfoPacket() ? 0 : 0x08) |
+                             (deviceInfo.packageStatisticsAvailable() ? 0x80 : 0)),
+        static_cast<uint8_t>(deviceInfo.extendedDeviceInfoPacketSize() & 0xFF),
+        static_cast<uint8_t>(deviceInfo.extendedDeviceInfoPacketSize() >> 8),
+        static_cast<uint8_t>(deviceInfo.uptimeFrequency() & 0xFF),
+        static_cast<uint8_t>(deviceInfo.uptimeFrequency() >> 8)
+    };
+
+    return FNV1a::calculate(data, sizeof(data));
+}
+
+int MetadataCache::load(ReadFunction read, void* context)
+{
+    Mutex::Lock lock(mutex_);
+
+    entries_.clear();
+    modified_ = false;
+
+    uint8_t header[headerSize];
+    if (!read(header, sizeof(header), context) ||
+            header[0] != 'T' || header[1] != 'M' || header[2] != 'C') {
+        turag_errorf("MetadataCache: no cache data");
+        return -1;
+    }
+    if (header[3] != formatVersion) {
+        // a cache is only an optimization, so simply start over
+        turag_warningf("MetadataCache: unsupported format version %u, cache discarded", header[3]);
+        modified_ = true;
+        return 0;
+    }
+
+    uint8_t buffer[maxEntrySize];
+    uint8_t length[2];
+    while (read(length, sizeof(length), context)) {
+        const size_t size = getUint16(length);
+
+        if (size > maxEntrySize) {
+            // Written with a bigger configuration. Skip it, the device
+            // will refill its entry from the bus.
+            size_t remaining = size + 4;
+            while (remaining > 0) {
+                const size_t chunk = std::min(remaining, sizeof(buffer));
+                if (!read(buffer, chunk, context)) {
+                    turag_errorf("MetadataCache: cache data truncated");
+                    return -1;
+                }
+                remaining -= chunk;
+            }
+            modified_ = true;
+            continue;
+        }
+
+        uint8_t checksum[4];
+        if (!read(buffer, size, context) || !read(checksum, sizeof(checksum), context)) {
+            turag_errorf("MetadataCache: cache data truncated");
+            return -1;
+        }
+        if (size < entryHeaderSize || FNV1a::calculate(buffer, size) != getUint32(checksum)) {
+            turag_warningf("MetadataCache: corrupted entry discarded");
+            modified_ = true;
+            continue;
+        }
+
+        Entry entry;
+        entry.uuid = getUint32(buffer);
+        entry.fingerprint = getUint32(buffer + 4);
+        entry.flags = buffer[8];
+        entry.bufferSize = getUint16(buffer + 9);
+        entry.nameLength = buffer[11];
+        entry.versionInfoLength = buffer[12];
+        entry.dataLength = 0;
+
+        size_t offset = entryHeaderSize;
+        bool valid = true;
+        if (entry.flags & hasName) {
+            valid = entry.nameLength <= TURAG_FELDBUS_METADATACACHE_MAX_STRING &&
+                    offset + entry.nameLength <= size;
+            if (valid) {
+                std::memcpy(entry.name, buffer + offset, entry.nameLength);
+                offset += entry.nameLength;
+            }
+        }
+        if (valid && (entry.flags & hasVersionInfo)) {
+            valid = entry.versionInfoLength <= TURAG_FELDBUS_METADATACACHE_MAX_STRING &&
+                    offset + entry.versionInfoLength <= size;
+            if (valid) {
+                std::memcpy(entry.versionInfo, buffer + offset, entry.versionInfoLength);
+                offset += entry.versionInfoLength;
+            }
+        }
+        if (valid && (entry.flags & hasData)) {
+            valid = offset + 2 <= size;
+            if (valid) {
+                entry.dataLength = getUint16(buffer + offset);
+                offset += 2;
+                valid = entry.dataLength <= TURAG_FELDBUS_METADATACACHE_MAX_DATA &&
+                        offset + entry.dataLength <= size;
+            }
+            if (valid) {
+                std::memcpy(entry.data, buffer + offset, entry.dataLength);
+            }
+        }
+
+        if (!valid) {
+            turag_warningf("MetadataCache: invalid entry for %08x discarded", static_cast<unsigned>(entry.uuid));
+            modified_ = true;
+            continue;
+        }
+        if (entries_.size() == entries_.max_size()) {
+            turag_warningf("MetadataCache: too many entries, the rest is discarded");
+            modified_ = true;
+            break;
+        }
+        entries_.push_back(entry);
+    }
+
+    return entries_.size();
+}
+
+bool MetadataCache::save(WriteFunction write, void* context)
+{
+    Mutex::Lock lock(mutex_);
+
+    const uint8_t header[headerSize] = { 'T', 'M', 'C', formatVersion };
+    if (!write(header, sizeof(header), context)) {
+        return false;
+    }
+
+    for (const Entry& entry : entries_) {
+        // length, entry and checksum
+        uint8_t buffer[2 + maxEntrySize + 4];
+        uint8_t* data = buffer + 2;
+
+        putUint32(data, entry.uuid);
+        putUint32(data + 4, entry.fingerprint);
+        data[8] = entry.flags;
+        putUint16(data + 9, entry.bufferSize);
+        data[11] = entry.nameLength;
+        data[12] = entry.versionInfoLength;
+        size_t size = entryHeaderSize;
+        if (entry.flags & hasName) {
+            std::memcpy(data + size, entry.name, entry.nameLength);
+            size += entry.nameLength;
+        }
+        if (entry.flags & hasVersionInfo) {
+            std::memcpy(data + size, entry.versionInfo, entry.versionInfoLength);
+            size += entry.versionInfoLength;
+        }
+        if (entry.flags & hasData) {
+            putUint16(data + size, entry.dataLength);
+            size += 2;
+            std::memcpy(data + size, entry.data, entry.dataLength);
+            size += entry.dataLength;
+        }
+
+        putUint16(buffer, static_cast<uint16_t>(size));
+        // FNV-1a, independent of the configured CRC algorithms
+        putUint32(data + size, FNV1a::calculate(data, size));
+        if (!write(buffer, size + 6, context)) {
+            return false;
+        }
+    }
+
+    modified_ = false;
+    return true;
+}
+
+void MetadataCache::clear(void)
+{
+    Mutex::Lock lock(mutex_);
+
+    modified_ = modified_ || !entries_.empty();
+    entries_.clear();
+    hits_ = 0;
+    misses_ = 0;
+}
+
+int MetadataCache::acquire(uint32_t uuid, uint32_t fingerprint)
+{
+    Mutex::Lock lock(mutex_);
+
+    for (unsigned i = 0; i < entries_.size(); ++i) {
+        Entry& entry = entries_[i];
+        if (entry.uuid != uuid) {
+            continue;
+        }
+        if (entry.fingerprint == fingerprint) {
+            ++hits_;
+        } else {
+            // new firmware, all the other information is outdated
+            entry.fingerprint = fingerprint;
+            entry.flags = 0;
+            modified_ = true;
+            ++misses_;
+        }
+        return i;
+    }
+
+    ++misses_;
+    if (entries_.size() == entries_.max_size()) {
+        turag_warningf("MetadataCache: full, device %08x is not cached", static_cast<unsigned>(uuid));
+        return -1;
+    }
+
+    Entry entry;
+    entry.uuid = uuid;
+    entry.fingerprint = fingerprint;
+    entry.flags = 0;
+    entry.bufferSize = 0;
+    entry.dataLength = 0;
+    entry.nameLength = 0;
+    entry.versionInfoLength = 0;
+    entries_.push_back(entry);
+    modified_ = true;
+    return entries_.size() - 1;
+}
+
+bool MetadataCache::getExtendedInfo(int index, uint8_t* nameLength, uint8_t* versionInfoLength, uint16_t* bufferSize)
+{
+    Mutex::Lock lock(mutex_);
+
+    const Entry& entry = entries_[index];
+    if (!(entry.flags & hasExtendedInfo)) {
+        return false;
+    }
+    *nameLength = entry.nameLength;
+    *versionInfoLength = entry.versionInfoLength;
+    *bufferSize = entry.bufferSize;
+    return true;
+}
+
+void MetadataCache::setExtendedInfo(int index, uint8_t nameLength, uint8_t versionInfoLength, uint16_t bufferSize)
+{
+    Mutex::Lock lock(mutex_);
+
+    Entry& entry = entries_[index];
+    if ((entry.flags & hasExtendedInfo) && entry.nameLength == nameLength &&
+            entry.versionInfoLength == versionInfoLength && entry.bufferSize == bufferSize) {
+        return;
+    }
+    entry.nameLength = nameLength;
+    entry.versionInfoLength = versionInfoLength;
+    entry.bufferSize = bufferSize;
+    // the strings belong to the old lengths
+    entry.flags = (entry.flags & hasData) | hasExtendedInfo;
+    modified_ = true;
+}
+
+bool MetadataCache::getString(int index, bool versionInfo, char* string)
+{
+    Mutex::Lock lock(mutex_);
+
+    const Entry& entry = entries_[index];
+    if (!(entry.flags & (versionInfo ? hasVersionInfo : hasName))) {
+        return false;
+    }
+    const unsigned length = versionInfo ? entry.versionInfoLength : entry.nameLength;
+    std::memcpy(string, versionInfo ? entry.versionInfo : entry.name, length);
+    string[length] = 0;
+    return true;
+}
+
+void MetadataCache::setString(int index, bool versionInfo, const char* string, unsigned length)
+{
+    Mutex::Lock lock(mutex_);
+
+    Entry& entry = entries_[index];
+    if (!(entry.flags & hasExtendedInfo) || length > TURAG_FELDBUS_METADATACACHE_MAX_STRING ||
+            length != (versionInfo ? entry.versionInfoLength : entry.nameLength)) {
+        return;
+    }
+    std::memcpy(versionInfo ? entry.versionInfo : entry.name, string, length);
+    entry.flags |= versionInfo ? hasVersionInfo : hasName;
+    modified_ = true;
+}
+
+int MetadataCache::getData(int index, void* data, unsigned size)
+{
+    Mutex::Lock lock(mutex_);
+
+    const Entry& entry = entries_[index];
+    if (!(entry.flags & hasData) || entry.dataLength > size) {
+        return -1;
+    }
+    std::memcpy(data, entry.data, entry.dataLength);
+    return entry.dataLength;
+}
+
+void MetadataCache::setData(int index, const void* data, unsigned size)
+{
+    Mutex::Lock lock(mutex_);
+
+    if (size > TURAG_FELDBUS_METADATACACHE_MAX_DATA) {
+        return;
+    }
+    Entry& entry = entries_[index];
+    std::memcpy(entry.data, data, size);
+    entry.dataLength = static_cast<uint16_t>(size);
+    entry.flags |= hasData;
+    modified_ = true;
+}
+
+
+} // namespace Feldbus
+} // namespace TURAG
+
+#endif // TURAG_USE_TURAG_FELDBUS_HOST
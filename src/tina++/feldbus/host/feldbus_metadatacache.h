@@ -0,0 +1,195 @@
+#ifndef TINAPP_FELDBUS_HOST_FELDBUS_METADATACACHE_H
+#define TINAPP_FELDBUS_HOST_FELDBUS_METADATACACHE_H
+
+#include <tina++/tina.h>
+#include <tina++/thread.h>
+#include <tina++/container/array_buffer.h>
+#include "device.h"
+
+
+#if !TURAG_USE_TURAG_FELDBUS_HOST
+# warning TURAG_USE_TURAG_FELDBUS_HOST must be defined to 1
+#endif
+
+
+/// \addtogroup feldbus-host
+/// \{
+
+/// Maximale Anzahl an Geräten in einem MetadataCache.
+#if !defined(TURAG_FELDBUS_METADATACACHE_MAX_ENTRIES) || defined(__DOXYGEN__)
+# define TURAG_FELDBUS_METADATACACHE_MAX_ENTRIES		32
+#endif
+
+/// Maximale Länge von Gerätename und Versionsinfo im MetadataCache.
+/// Längere Strings werden nicht gespeichert, sondern immer über den Bus abgefragt.
+#if !defined(TURAG_FELDBUS_METADATACACHE_MAX_STRING) || defined(__DOXYGEN__)
+# define TURAG_FELDBUS_METADATACACHE_MAX_STRING		32
+#endif
+
+/// Maximale Anzahl an Bytes gerätespezifischer Metadaten pro Gerät im MetadataCache.
+#if !defined(TURAG_FELDBUS_METADATACACHE_MAX_DATA) || defined(__DOXYGEN__)
+# define TURAG_FELDBUS_METADATACACHE_MAX_DATA		128
+#endif
+
+/// \}
+
+
+namespace TURAG {
+namespace Feldbus {
+
+
+/**
+ * \brief Puffert Metadaten von Geräten über Neustarts hinweg.
+ *
+ * Extended-Device-Info, Gerätename, Versionsinfo und gerätespezifische Metadaten
+ * (z.B. Größen, Faktoren und Frequenzen eines ASEBBase oder der Befehlssatz eines
+ * StellantriebeDevice) ändern sich zwischen zwei
+ * Starts praktisch nie, werden aber ohne Cache bei jedem Start erneut über den Bus
+ * gelesen. Ist mit Device::setMetadataCache() ein Cache gesetzt, fragt ein Gerät
+ * bei der Initialisierung nur die Device-Info ab. Stimmen UUID und Firmware-Fingerabdruck
+ * mit einem Eintrag des Caches überein, werden alle weiteren Metadaten aus dem Cache
+ * genommen. Andernfalls wird der Eintrag beim Lesen über den Bus neu befüllt.
+ *
+ * Der Fingerabdruck wird aus der Device-Info (Protokoll-ID, Gerätetyp, Checksummentyp,
+ * Größe der Extended-Device-Info und Uptime-Frequenz) gebildet. Ein Firmware-Update, das
+ * keinen dieser Werte ändert, erkennt er nicht. Gerätespezifische Metadaten müssen deshalb
+ * vor der Verwendung mit einem Wert abgeglichen werden, der sich mit einer einzelnen Anfrage
+ * lesen lässt und sich mit ihnen ändert. ASEBBase vergleicht dazu z.B. die Größe des
+ * Sync-Pakets und liest bei einer Abweichung alle Metadaten neu über den Bus.
+ *
+ * Der Cache liegt im RAM und wird mit load() und save() in einem kompakten Binärformat
+ * gespeichert. Das Speichermedium wird über Lese- und Schreibfunktionen angebunden:
+ * \code
+ * MetadataCache cache;
+ * FILE* file = fopen("feldbus.cache", "rb");
+ * if (file) {
+ *     cache.load([](void* data, size_t size, void* f) {
+ *         return fread(data, 1, size, static_cast<FILE*>(f)) == size;
+ *     }, file);
+ *     fclose(file);
+ * }
+ * Device::setMetadataCache(&cache);
+ * ... // initialize devices
+ * if (cache.isModified()) {
+ *     file = fopen("feldbus.cache", "wb");
+ *     cache.save([](const void* data, size_t size, void* f) {
+ *         return fwrite(data, 1, size, static_cast<FILE*>(f)) == size;
+ *     }, file);
+ *     fclose(file);
+ * }
+ * \endcode
+ *
+ * Jeder Eintrag ist mit einer Prüfsumme gesichert. Beschädigte Einträge werden beim
+ * Laden verworfen.
+ *
+ * \note Alle Funktionen sind thread-safe, sodass Geräte an verschiedenen
+ * Bussen gleichzeitig initialisiert werden können.
+ */
+class MetadataCache {
+    MetadataCache(const MetadataCache&) = delete;
+    MetadataCache& operator=(const MetadataCache&) = delete;
+
+    friend class Device;
+
+public:
+    /**
+     * \brief Funktionstyp zum Einlesen der Binärdaten.
+     * \return False, wenn nicht genügend Daten gelesen werden konnten.
+     */
+    typedef bool (*ReadFunction)(void* data, size_t size, void* context);
+
+    /**
+     * \brief Funktionstyp zum Ausgeben der Binärdaten.
+     * \return False, wenn das Schreiben fehlschlug.
+     */
+    typedef bool (*WriteFunction)(const void* data, size_t size, void* context);
+
+    MetadataCache() :
+        modified_(false), hits_(0), misses_(0)
+    { }
+
+    /**
+     * \brief Lädt den Cache.
+     * \param read Funktion, die die Binärdaten liefert.
+     * \param context Beliebiger Zeiger, der read übergeben wird.
+     * \return Anzahl der geladenen Einträge oder -1, wenn die Daten nicht
+     * gelesen werden konnten.
+     *
+     * Vorhandene Einträge werden verworfen. Die Funktion muss vor der
+     * Initialisierung der Geräte aufgerufen werden.
+     */
+    int load(ReadFunction read, void* context);
+
+    /**
+     * \brief Speichert den Cache.
+     * \param write Funktion, die die Daten schreibt.
+     * \param context Beliebiger Zeiger, der write übergeben wird.
+     * \return False bei einem Schreibfehler.
+     */
+    bool save(WriteFunction write, void* context);
+
+    /**
+     * \brief Verwirft alle Einträge.
+     *
+     * Darf nicht aufgerufen werden, während Geräte den Cache benutzen.
+     */
+    void clear(void);
+
+    /// Gibt zurück, ob sich der Cache seit dem letzten load() oder save() geändert hat.
+    bool isModified(void) const { return modified_; }
+
+    /// Anzahl der Einträge.
+    unsigned size(void) const { return entries_.size(); }
+
+    /// Anzahl der Geräte, deren Metadaten im Cache gefunden wurden.
+    unsigned hits(void) const { return hits_; }
+
+    /// Anzahl der Geräte, die nicht oder mit einer anderen Firmware im Cache waren.
+    unsigned misses(void) const { return misses_; }
+
+    /// Berechnet den Firmware-Fingerabdruck aus der Device-Info.
+    static uint32_t fingerprint(const Device::DeviceInfo& deviceInfo);
+
+private:
+    enum Flags : uint8_t {
+        hasExtendedInfo = 0x01,
+        hasName = 0x02,
+        hasVersionInfo = 0x04,
+        hasData = 0x08
+    };
+
+    struct Entry {
+        uint32_t uuid;
+        uint32_t fingerprint;
+        uint16_t bufferSize;
+        uint16_t dataLength;
+        uint8_t nameLength;
+        uint8_t versionInfoLength;
+        uint8_t flags;
+        char name[TURAG_FELDBUS_METADATACACHE_MAX_STRING];
+        char versionInfo[TURAG_FELDBUS_METADATACACHE_MAX_STRING];
+        uint8_t data[TURAG_FELDBUS_METADATACACHE_MAX_DATA];
+    };
+
+    // Used by Device. Entries are referenced by their index,
+    // which stays valid until clear() or load() is called.
+    int acquire(uint32_t uuid, uint32_t fingerprint);
+    bool getExtendedInfo(int index, uint8_t* nameLength, uint8_t* versionInfoLength, uint16_t* bufferSize);
+    void setExtendedInfo(int index, uint8_t nameLength, uint8_t versionInfoLength, uint16_t bufferSize);
+    bool getString(int index, bool versionInfo, char* string);
+    void setString(int index, bool versionInfo, const char* string, unsigned length);
+    int getData(int index, void* data, unsigned size);
+    void setData(int index, const void* data, unsigned size);
+
+    Mutex mutex_;
+    ArrayBuffer<Entry, TURAG_FELDBUS_METADATACACHE_MAX_ENTRIES> entries_;
+    bool modified_;
+    unsigned hits_;
+    unsigned misses_;
+};
+
+
+} // namespace Feldbus
+} // namespace TURAG
+
+#endif // TINAPP_FELDBUS_HOST_FELDBUS_METADATACACHE_H
@@ -0,0 +1,184 @@
+#ifndef TINAPP_FELDBUS_HOST_FELDBUS_PACKET_H
+#define TINAPP_FELDBUS_HOST_FELDBUS_PACKET_H
+
+#include <tina++/tina.h>
+
+#include <cstddef>
+#include <cstring>
+
+
+#if !TURAG_USE_TURAG_FELDBUS_HOST
+# warning TURAG_USE_TURAG_FELDBUS_HOST must be defined to 1
+#endif
+
+
+namespace TURAG {
+namespace Feldbus {
+
+namespace detail {
+
+template<typename... Fields>
+struct PacketSize;
+
+template<>
+struct PacketSize<> {
+    static constexpr std::size_t value = 0;
+};
+
+template<typename First, typename... Rest>
+struct PacketSize<First, Rest...> {
+    static constexpr std::size_t value = sizeof(First) + PacketSize<Rest...>::value;
+};
+
+template<std::size_t Index, typename... Fields>
+struct PacketField;
+
+template<typename First, typename... Rest>
+struct PacketField<0, First, Rest...> {
+    typedef First type;
+    static constexpr std::size_t offset = 0;
+};
+
+template<std::size_t Index, typename First, typename... Rest>
+struct PacketField<Index, First, Rest...> {
+    typedef typename PacketField<Index - 1, Rest...>::type type;
+    static constexpr std::size_t offset = sizeof(First) + PacketField<Index - 1, Rest...>::offset;
+};
+
+} // namespace detail
+
+
+/**
+ * \brief Beschreibt den Aufbau eines Pakets zur Compile-Zeit.
+ * \tparam Fields Typen der Nutzdatenfelder in der Reihenfolge auf dem Bus.
+ *
+ * Ein Paket besteht aus der Adresse, den Feldern ohne Padding, einem optionalen
+ * Datenblock variabler Länge (Tail) und der Checksumme. Offsets, Größen und die
+ * Position der Checksumme werden vom Compiler berechnet, sodass Pakete nicht mehr
+ * von Hand mit Ausdrücken wie <tt>myAddressLength + 1 + 4</tt> zusammengesetzt werden müssen:
+ * \code
+ * // command, target address, size
+ * typedef PacketLayout<uint8_t, uint32_t, uint16_t> ReadRequest;
+ * static_assert(ReadRequest::offset<2>() == 6, "");
+ * static_assert(ReadRequest::size == 9, "");
+ * \endcode
+ *
+ * Die Felder werden in Host-Byte-Reihenfolge übertragen, also wie bei
+ * BaseDevice::Request in Little-Endian.
+ */
+template<typename... Fields>
+struct PacketLayout {
+    /// Länge der Adresse.
+    static constexpr std::size_t addressLength = 1;
+
+    /// Länge aller Felder.
+    static constexpr std::size_t payloadSize = detail::PacketSize<Fields...>::value;
+
+    /// Offset des Datenblocks variabler Länge.
+    static constexpr std::size_t tailOffset = addressLength + payloadSize;
+
+    /// Länge des Pakets ohne Datenblock variabler Länge.
+    static constexpr std::size_t size = tailOffset + 1;
+
+    /// Typ des Feldes mit dem Index \a Index.
+    template<std::size_t Index>
+    using Field = typename detail::PacketField<Index, Fields...>::type;
+
+    /// Offset des Feldes mit dem Index \a Index im Paket.
+    template<std::size_t Index>
+    static constexpr std::size_t offset(void) {
+        return addressLength + detail::PacketField<Index, Fields...>::offset;
+    }
+
+    /// Länge des Pakets mit einem Datenblock der Länge \a tailLength.
+    static constexpr std::size_t length(std::size_t tailLength = 0) {
+        return size + tailLength;
+    }
+
+    /// Offset der Checksumme bei einem Datenblock der Länge \a tailLength.
+    static constexpr std::size_t checksumOffset(std::size_t tailLength = 0) {
+        return tailOffset + tailLength;
+    }
+};
+
+
+/**
+ * \brief Zugriff auf ein Paket in einem fremden Puffer.
+ * \tparam Layout PacketLayout des Pakets.
+ *
+ * Felder werden direkt im Puffer gelesen und geschrieben, es wird also
+ * nichts zwischengespeichert. Damit können auch Pakete, deren Länge erst zur
+ * Laufzeit feststeht, ohne Offset-Rechnung gebaut und an Ort und Stelle
+ * dekodiert werden. Die Zugriffe sind unabhängig von der Ausrichtung des Puffers.
+ */
+template<typename Layout>
+class PacketView {
+public:
+    /// Benutzt \a buffer, der mindestens Layout::length() Byte groß sein muss.
+    explicit PacketView(uint8_t* buffer) :
+        buffer_(buffer)
+    { }
+
+    /// Schreibt das Feld mit dem Index \a Index.
+    template<std::size_t Index>
+    void set(const typename Layout::template Field<Index>& value) {
+        std::memcpy(buffer_ + Layout::template offset<Index>(), &value, sizeof(value));
+    }
+
+    /// Liest das Feld mit dem Index \a Index.
+    template<std::size_t Index>
+    typename Layout::template Field<Index> get(void) const {
+        typename Layout::template Field<Index> value;
+        std::memcpy(&value, buffer_ + Layout::template offset<Index>(), sizeof(value));
+        return value;
+    }
+
+    /// Anfang des Datenblocks variabler Länge.
+    uint8_t* tail(void) const { return buffer_ + Layout::tailOffset; }
+
+    /// Anfang des Pakets.
+    uint8_t* data(void) const { return buffer_; }
+
+private:
+    uint8_t* buffer_;
+};
+
+
+/**
+ * \brief Paket mit eigenem Puffer.
+ * \tparam Layout PacketLayout des Pakets.
+ * \tparam MaxTail Maximale Länge des Datenblocks variabler Länge.
+ *
+ * Der Puffer liegt im Objekt selbst, sodass für Pakete keine Heap-Allokation
+ * nötig ist. Das Paket wird mit Device::transceive() direkt aus diesem Puffer
+ * gesendet bzw. in ihn empfangen.
+ */
+template<typename Layout, std::size_t MaxTail = 0>
+class Packet : public PacketView<Layout> {
+    Packet(const Packet&) = delete;
+    Packet& operator=(const Packet&) = delete;
+
+public:
+    /// Größe des Puffers.
+    static constexpr std::size_t capacity = Layout::size + MaxTail;
+
+    Packet() :
+        PacketView<Layout>(storage_)
+    { }
+
+private:
+    uint8_t storage_[capacity];
+};
+
+// definitions for ODR-use before C++17
+template<typename... Fields> constexpr std::size_t PacketLayout<Fields...>::addressLength;
+template<typename... Fields> constexpr std::size_t PacketLayout<Fields...>::payloadSize;
+template<typename... Fields> constexpr std::size_t PacketLayout<Fields...>::tailOffset;
+template<typename... Fields> constexpr std::size_t PacketLayout<Fields...>::size;
+template<typename Layout, std::size_t MaxTail> constexpr std::size_t Packet<Layout, MaxTail>::capacity;
+
+
+} // namespace Feldbus
+} // namespace TURAG
+
+#endif // TINAPP_FELDBUS_HOST_FELDBUS_PACKET_H
@@ -0,0 +1,156 @@
+#define TURAG_DEBUG_LOG_SOURCE "B"
+
+#include <tina++/tina.h>
+
+#if TURAG_USE_TURAG_FELDBUS_HOST
+
+#include <cstring>
+
+#include "feldbus_requestcoalescer.h"
+#include "device.h"
+
+
+namespace TURAG {
+namespace Feldbus {
+
+
+RequestCoalescer::RequestCoalescer(SystemTime freshness) :
+    freshness_(freshness), transmitted_(0), coalesced_(0)
+{ }
+
+void RequestCoalescer::setFreshness(SystemTime freshness)
+{
+    Mutex::Lock lock(mutex_);
+    freshness_ = freshness;
+}
+
+void RequestCoalescer::invalidate(void)
+{
+    Mutex::Lock lock(mutex_);
+    for (Slot& slot : slots_) {
+        slot.valid = false;
+    }
+}
+
+void RequestCoalescer::invalidate(const Device& device)
+{
+    Mutex::Lock lock(mutex_);
+    for (Slot& slot : slots_) {
+        if (slot.device == &device) {
+            slot.valid = false;
+        }
+    }
+}
+
+RequestCoalescer::Slot* RequestCoalescer::find(const Device& device, const uint8_t* request, int requestLength, int responseLength)
+{
+    for (Slot& slot : slots_) {
+        if (slot.device == &device &&
+                slot.requestLength == requestLength &&
+                slot.responseLength == responseLength &&
+                std::memcmp(slot.request, request, requestLength) == 0) {
+            return &slot;
+        }
+    }
+    return nullptr;
+}
+
+RequestCoalescer::Slot* RequestCoalescer::claim(void)
+{
+    // Slots with readers left still hold a response somebody has to copy.
+    Slot* oldest = nullptr;
+    for (Slot& slot : slots_) {
+        if (!slot.device) {
+            return &slot;
+        }
+        if (slot.inFlight || slot.readers > 0) {
+            continue;
+        }
+        if (!oldest || slot.completed < oldest->completed) {
+            oldest = &slot;
+        }
+    }
+    return oldest;
+}
+
+bool RequestCoalescer::transceive(Device& device, uint8_t* transmit, int transmit_length, uint8_t* receive, int receive_length)
+{
+    // address and checksum are filled in by the device, only the payload identifies the request
+    const uint8_t* request = transmit + Device::myAddressLength;
+    const int requestLength = transmit_length - Device::myAddressLength - 1;
+
+    if (requestLength < 0 ||
+            requestLength > TURAG_FELDBUS_REQUESTCOALESCER_MAX_REQUEST ||
+            receive_length > TURAG_FELDBUS_REQUESTCOALESCER_MAX_RESPONSE) {
+        return device.transfer(transmit, transmit_length, receive, receive_length);
+    }
+
+    Mutex::Lock lock(mutex_);
+
+    Slot* slot = find(device, request, requestLength, receive_length);
+    if (slot && slot->inFlight) {
+        // Tokens are handed out per completed transfer, so a wake up might
+        // belong to an older one. Only a new generation carries our answer.
+        const unsigned generation = slot->generation;
+        ++slot->readers;
+        while (slot->generation == generation) {
+            ++slot->waiting;
+            lock.unlock();
+            slot->done.wait();
+            lock.lock();
+        }
+        --slot->readers;
+        ++coalesced_;
+        if (slot->success) {
+            std::memcpy(receive, slot->response, receive_length);
+        }
+        return slot->success;
+    }
+
+    if (slot && slot->valid && slot->success && freshness_ > SystemTime() &&
+            SystemTime::now() - slot->completed < freshness_) {
+        ++coalesced_;
+        std::memcpy(receive, slot->response, receive_length);
+        return true;
+    }
+
+    if (!slot) {
+        slot = claim();
+        if (!slot) {
+            // all slots busy, no point in waiting for one
+            ++transmitted_;
+            lock.unlock();
+            return device.transfer(transmit, transmit_length, receive, receive_length);
+        }
+        slot->device = &device;
+        slot->requestLength = requestLength;
+        slot->responseLength = receive_length;
+        std::memcpy(slot->request, request, requestLength);
+    }
+    slot->inFlight = true;
+    slot->valid = true;
+    ++transmitted_;
+    lock.unlock();
+
+    const bool success = device.transfer(transmit, transmit_length, receive, receive_length);
+
+    lock.lock();
+    slot->success = success;
+    if (success) {
+        std::memcpy(slot->response, receive, receive_length);
+    }
+    slot->completed = SystemTime::now();
+    slot->inFlight = false;
+    ++slot->generation;
+    while (slot->waiting > 0) {
+        --slot->waiting;
+        slot->done.signal();
+    }
+    return success;
+}
+
+
+} // namespace Feldbus
+} // namespace TURAG
+
+#endif // TURAG_USE_TURAG_FELDBUS_HOST
@@ -0,0 +1,141 @@
+#ifndef TINAPP_FELDBUS_HOST_FELDBUS_REQUESTCOALESCER_H
+#define TINAPP_FELDBUS_HOST_FELDBUS_REQUESTCOALESCER_H
+
+#include <tina++/tina.h>
+#include <tina++/thread.h>
+#include <tina++/time.h>
+
+
+#if !TURAG_USE_TURAG_FELDBUS_HOST
+# warning TURAG_USE_TURAG_FELDBUS_HOST must be defined to 1
+#endif
+
+
+/// \addtogroup feldbus-host
+/// \{
+
+/// Anzahl der Anfragen, die ein RequestCoalescer gleichzeitig verfolgt.
+#if !defined(TURAG_FELDBUS_REQUESTCOALESCER_SLOTS) || defined(__DOXYGEN__)
+# define TURAG_FELDBUS_REQUESTCOALESCER_SLOTS		8
+#endif
+
+/// Maximale Länge einer Anfrage, die zusammengefasst werden kann.
+#if !defined(TURAG_FELDBUS_REQUESTCOALESCER_MAX_REQUEST) || defined(__DOXYGEN__)
+# define TURAG_FELDBUS_REQUESTCOALESCER_MAX_REQUEST		16
+#endif
+
+/// Maximale Länge einer Antwort, die mit anderen Aufrufern geteilt werden kann.
+#if !defined(TURAG_FELDBUS_REQUESTCOALESCER_MAX_RESPONSE) || defined(__DOXYGEN__)
+# define TURAG_FELDBUS_REQUESTCOALESCER_MAX_RESPONSE		64
+#endif
+
+/// \}
+
+
+namespace TURAG {
+namespace Feldbus {
+
+class Device;
+
+
+/**
+ * \brief Fasst gleichzeitige, identische Leseanfragen an ein Gerät zusammen.
+ *
+ * Lesen mehrere Threads unabhängig voneinander dieselben Werte (z.B. ASEBBase::sync()
+ * oder LegacyStellantriebeDevice::getValue() mit demselben Key), wird ohne Coalescer
+ * jede Anfrage einzeln übertragen. Ist einem Gerät mit Device::setRequestCoalescer()
+ * ein Coalescer zugeordnet, werden lesende Anfragen, die bereits unterwegs sind,
+ * nicht erneut gesendet. Die späteren Aufrufer warten stattdessen auf die laufende
+ * Übertragung und bekommen deren Antwort:
+ * \code
+ * RequestCoalescer coalescer(SystemTime::fromMsec(2));
+ * aseb.setRequestCoalescer(&coalescer);
+ * motor.setRequestCoalescer(&coalescer);
+ * \endcode
+ *
+ * Mit einem Frischefenster größer null werden erfolgreiche Antworten außerdem
+ * so lange wiederverwendet, bis das Fenster seit ihrem Empfang abgelaufen ist.
+ * Jede andere Übertragung an das Gerät (z.B. das Setzen eines Wertes) verwirft
+ * die gepufferten Antworten des Gerätes, sodass nach einem Schreibzugriff nie
+ * ein veralteter Wert gelesen wird.
+ *
+ * Schlägt die gemeinsame Übertragung fehl, bekommen alle wartenden Aufrufer den
+ * Fehler zurück. Der Fehler wird nur einmal im Fehlerzähler des Gerätes erfasst.
+ *
+ * Welche Anfragen nur lesen, weiß allein die Geräteklasse. Sie benutzt dafür
+ * Device::coalescedTransceive(), alle anderen Anfragen werden nie zusammengefasst.
+ * Ein Coalescer kann von beliebig vielen Geräten gemeinsam benutzt werden.
+ */
+class RequestCoalescer {
+    RequestCoalescer(const RequestCoalescer&) = delete;
+    RequestCoalescer& operator=(const RequestCoalescer&) = delete;
+
+    friend class Device;
+
+public:
+    /**
+     * \brief Konstruktor.
+     * \param freshness Zeit, für die eine erfolgreiche Antwort wiederverwendet wird.
+     * Bei null werden nur gleichzeitig laufende Anfragen zusammengefasst.
+     */
+    explicit RequestCoalescer(SystemTime freshness = SystemTime());
+
+    /// Setzt das Frischefenster.
+    void setFreshness(SystemTime freshness);
+
+    /// Frischefenster.
+    SystemTime freshness(void) const { return freshness_; }
+
+    /// Verwirft alle gepufferten Antworten.
+    void invalidate(void);
+
+    /// Anzahl der Anfragen, die tatsächlich über den Bus gesendet wurden.
+    unsigned transmittedRequests(void) const { return transmitted_; }
+
+    /// Anzahl der Anfragen, die eine Antwort einer anderen Anfrage bekommen haben.
+    unsigned coalescedRequests(void) const { return coalesced_; }
+
+private:
+    struct Slot {
+        Slot() :
+            device(nullptr), requestLength(0), responseLength(0),
+            inFlight(false), valid(false), success(false),
+            waiting(0), readers(0), generation(0), completed(SystemTime())
+        { }
+
+        const Device* device;
+        uint8_t request[TURAG_FELDBUS_REQUESTCOALESCER_MAX_REQUEST];
+        uint8_t response[TURAG_FELDBUS_REQUESTCOALESCER_MAX_RESPONSE];
+        int requestLength;
+        int responseLength;
+        bool inFlight;
+        // false if the response must not be reused
+        bool valid;
+        bool success;
+        // threads blocked on done
+        unsigned waiting;
+        // threads that still have to copy the response
+        unsigned readers;
+        unsigned generation;
+        SystemTime completed;
+        Semaphore done;
+    };
+
+    bool transceive(Device& device, uint8_t* transmit, int transmit_length, uint8_t* receive, int receive_length);
+    void invalidate(const Device& device);
+
+    Slot* find(const Device& device, const uint8_t* request, int requestLength, int responseLength);
+    Slot* claim(void);
+
+    Mutex mutex_;
+    Slot slots_[TURAG_FELDBUS_REQUESTCOALESCER_SLOTS];
+    SystemTime freshness_;
+    unsigned transmitted_;
+    unsigned coalesced_;
+};
+
+
+} // namespace Feldbus
+} // namespace TURAG
+
+#endif // TINAPP_FELDBUS_HOST_FELDBUS_REQUESTCOALESCER_H
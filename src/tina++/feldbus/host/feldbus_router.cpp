@@ -0,0 +1,179 @@
+#define TURAG_DEBUG_LOG_SOURCE "B"
+
+#include <tina++/tina.h>
+
+#if TURAG_USE_TURAG_FELDBUS_HOST
+
+#include <tina/debug/print.h>
+#include <cstring>
+
+#include "feldbus_router.h"
+
+
+namespace TURAG {
+namespace Feldbus {
+
+
+FeldbusRouter::FeldbusRouter(const char* name, bool threadSafe) :
+    FeldbusAbstraction(name, threadSafe)
+{
+    for (std::atomic<uint8_t>& segment : segmentOf_) {
+        segment = unassigned;
+    }
+}
+
+bool FeldbusRouter::addSegment(FeldbusAbstraction& bus)
+{
+    if (segments_.size() == segments_.max_size()) {
+        turag_errorf("%s: too many segments", name());
+        return false;
+    }
+    segments_.push_back(&bus);
+    return true;
+}
+
+bool FeldbusRouter::assign(unsigned address, unsigned segment)
+{
+    if (address == TURAG_FELDBUS_BROADCAST_ADDR || address >= numberOfAddresses || segment >= segments_.size()) {
+        turag_errorf("%s: can't assign address %u to segment %u", name(), address, segment);
+        return false;
+    }
+    segmentOf_[address] = static_cast<uint8_t>(segment);
+    return true;
+}
+
+void FeldbusRouter::forget(unsigned address)
+{
+    if (address < numberOfAddresses) {
+        segmentOf_[address] = unassigned;
+    }
+}
+
+int FeldbusRouter::segmentOf(unsigned address) const
+{
+    if (address >= numberOfAddresses) {
+        return -1;
+    }
+    const uint8_t segment = segmentOf_[address];
+    return segment == unassigned ? -1 : segment;
+}
+
+FeldbusAbstraction* FeldbusRouter::route(unsigned targetAddress)
+{
+    // broadcasts and unknown devices are handled by doTransceive()
+    if (targetAddress >= numberOfAddresses) {
+        return this;
+    }
+    const uint8_t segment = segmentOf_[targetAddress];
+    return segment == unassigned ? this : segments_[segment];
+}
+
+bool FeldbusRouter::doTransceive(const uint8_t* transmit, int* transmit_length, uint8_t* receive, int* receive_length, bool)
+{
+    // The segments insert the bus delay themselves.
+    if (!transmit || !transmit_length || *transmit_length == 0 || segments_.empty()) {
+        if (receive_length) {
+            *receive_length = 0;
+        }
+        return false;
+    }
+
+    const unsigned address = transmit[0];
+    if (address == TURAG_FELDBUS_BROADCAST_ADDR) {
+        return broadcast(transmit, transmit_length, receive, receive_length);
+    }
+
+    // assigned in the meantime by another thread
+    FeldbusAbstraction* segment = route(address);
+    if (segment != this) {
+        return segment->transceive(transmit, transmit_length, receive, receive_length, address, ChecksumType::none,
+                                   transmissionPriority(), transmissionDeadline(), 1,
+                                   responseTimeout(SystemTime::infinite())) == ResultStatus::Success;
+    }
+    return discover(address, transmit, transmit_length, receive, receive_length);
+}
+
+bool FeldbusRouter::broadcast(const uint8_t* transmit, int* transmit_length, uint8_t* receive, int* receive_length)
+{
+    const int requested = *transmit_length;
+    const int wanted = receive && receive_length ? *receive_length : 0;
+    if (wanted > TURAG_FELDBUS_ROUTER_MAX_BROADCAST_RESPONSE) {
+        turag_errorf("%s: broadcast response of %d bytes too long", name(), wanted);
+        *receive_length = 0;
+        return false;
+    }
+
+    // The answers of all segments are combined as if they had collided on one bus.
+    int received = 0;
+    int sent = requested;
+    for (FeldbusAbstraction* segment : segments_) {
+        int transmitLength = requested;
+        int receiveLength = wanted;
+        segment->transceive(transmit, &transmitLength, wanted ? broadcastBuffer_ : nullptr, &receiveLength,
+                            TURAG_FELDBUS_BROADCAST_ADDR, ChecksumType::none,
+                            transmissionPriority(), transmissionDeadline(), 1,
+                            responseTimeout(SystemTime::infinite()));
+        if (transmitLength < sent) {
+            sent = transmitLength;
+        }
+        if (wanted == 0) {
+            continue;
+        }
+        for (int i = 0; i < receiveLength; ++i) {
+            if (i < received) {
+                receive[i] |= broadcastBuffer_[i];
+            } else {
+                receive[i] = broadcastBuffer_[i];
+            }
+        }
+        if (receiveLength > received) {
+            received = receiveLength;
+        }
+    }
+
+    *transmit_length = sent;
+    if (receive_length) {
+        *receive_length = received;
+    }
+    return sent == requested && received == wanted;
+}
+
+bool FeldbusRouter::discover(unsigned address, const uint8_t* transmit, int* transmit_length, uint8_t* receive, int* receive_length)
+{
+    const int requested = *transmit_length;
+    const int wanted = receive && receive_length ? *receive_length : 0;
+    if (wanted == 0) {
+        // nobody tells us where the device is, so everybody gets the packet
+        return broadcast(transmit, transmit_length, receive, receive_length);
+    }
+
+    int transmitLength = requested;
+    int receiveLength = 0;
+    for (unsigned i = 0; i < segments_.size(); ++i) {
+        transmitLength = requested;
+        receiveLength = wanted;
+        // Noise or the answer of another device must not bind the address
+        // to the wrong segment, so the response is checked like it would
+        // be by the caller.
+        const ResultStatus status = segments_[i]->transceive(
+                    transmit, &transmitLength, receive, &receiveLength, address, transmissionChecksumType(),
+                    transmissionPriority(), transmissionDeadline(), 1,
+                    responseTimeout(SystemTime::infinite()));
+        if (status == ResultStatus::Success && receiveLength == wanted &&
+                (receive[0] & ~TURAG_FELDBUS_MASTER_ADDR) == address) {
+            segmentOf_[address] = static_cast<uint8_t>(i);
+            turag_infof("%s: device %u found on segment %u", name(), address, i);
+            break;
+        }
+    }
+
+    *transmit_length = transmitLength;
+    *receive_length = receiveLength;
+    return transmitLength == requested && receiveLength == wanted;
+}
+
+
+} // namespace Feldbus
+} // namespace TURAG
+
+#endif // TURAG_USE_TURAG_FELDBUS_HOST
@@ -0,0 +1,138 @@
+#ifndef TINAPP_FELDBUS_HOST_FELDBUS_ROUTER_H
+#define TINAPP_FELDBUS_HOST_FELDBUS_ROUTER_H
+
+#include <tina++/tina.h>
+#include <tina++/container/array_buffer.h>
+#include <tina++/feldbus/host/feldbusabstraction.h>
+
+#include <atomic>
+
+
+#if !TURAG_USE_TURAG_FELDBUS_HOST
+# warning TURAG_USE_TURAG_FELDBUS_HOST must be defined to 1
+#endif
+
+
+/// \addtogroup feldbus-host
+/// \{
+
+/// Maximale Anzahl an Bussegmenten eines FeldbusRouter.
+#if !defined(TURAG_FELDBUS_ROUTER_MAX_SEGMENTS) || defined(__DOXYGEN__)
+# define TURAG_FELDBUS_ROUTER_MAX_SEGMENTS		4
+#endif
+
+/// Maximale Länge der Antwort auf einen Broadcast, den ein FeldbusRouter
+/// an alle Segmente verteilt.
+#if !defined(TURAG_FELDBUS_ROUTER_MAX_BROADCAST_RESPONSE) || defined(__DOXYGEN__)
+# define TURAG_FELDBUS_ROUTER_MAX_BROADCAST_RESPONSE		64
+#endif
+
+/// \}
+
+
+namespace TURAG {
+namespace Feldbus {
+
+
+/**
+ * \brief Fasst mehrere physikalische Busse zu einem logischen Bus zusammen.
+ *
+ * Geräte werden wie gewohnt mit einem Bus konstruiert, nur dass statt eines
+ * physikalischen Busses der Router übergeben wird. Der Router ordnet jeder
+ * Geräteadresse ein Segment zu und reicht Übertragungen (blockierend mit transceive()
+ * oder asynchron mit submit()) ohne eigene Sperre direkt an den Bus des Segments
+ * weiter. Übertragungen an Geräte in verschiedenen Segmenten laufen damit parallel,
+ * sofern sie aus verschiedenen Threads oder über die Warteschlangen der Segmente
+ * angestoßen werden:
+ * \code
+ * LinuxSerialFeldbus bus1("rs485-1"), bus2("rs485-2");
+ * FeldbusRouter router("robot");
+ * router.addSegment(bus1);
+ * router.addSegment(bus2);
+ * router.assign(12, 1);   // optional, otherwise discovered
+ * ASEB<...> aseb("aseb", 12, router);
+ * \endcode
+ *
+ * Die Zuordnung kann mit assign() vorgegeben werden. Übertragungen an Adressen ohne
+ * Zuordnung probiert der Router nacheinander auf allen Segmenten aus und merkt sich
+ * das Segment, auf dem eine vollständige Antwort kam. Üblicherweise geschieht das beim
+ * ersten Ping während der Initialisierung der Geräte.
+ *
+ * Broadcasts werden nacheinander auf allen Segmenten gesendet. Antworten auf
+ * Broadcasts werden wie auf einem gemeinsamen Bus überlagert (bitweises Oder),
+ * damit Verfahren, die auf Kollisionen beruhen, weiterhin funktionieren.
+ *
+ * \note Es werden nur 1 Byte lange Adressen unterstützt. Sync-Reads mit SyncReadGroup
+ * müssen auf den einzelnen Segmenten ausgeführt werden. clearBuffer() wird nicht
+ * an die Segmente weitergereicht, weil es laufende Übertragungen stören würde.
+ */
+class FeldbusRouter : public FeldbusAbstraction {
+public:
+    /**
+     * \brief Konstruktor.
+     * \param name Name des logischen Busses.
+     * \param threadSafe Schützt Broadcasts und die Suche nach unbekannten Geräten.
+     * Die an die Segmente weitergereichten Übertragungen werden von deren
+     * Bussen geschützt.
+     */
+    explicit FeldbusRouter(const char* name, bool threadSafe = true);
+
+    /**
+     * \brief Fügt ein Segment hinzu.
+     * \param bus Bus des Segments.
+     * \return False, wenn bereits \ref TURAG_FELDBUS_ROUTER_MAX_SEGMENTS Segmente existieren.
+     *
+     * Alle Segmente müssen vor der ersten Übertragung hinzugefügt werden.
+     */
+    bool addSegment(FeldbusAbstraction& bus);
+
+    /**
+     * \brief Ordnet eine Geräteadresse fest einem Segment zu.
+     * \param address Geräteadresse.
+     * \param segment Index des Segments in der Reihenfolge von addSegment().
+     * \return False bei ungültiger Adresse oder ungültigem Segment.
+     */
+    bool assign(unsigned address, unsigned segment);
+
+    /**
+     * \brief Verwirft die Zuordnung einer Geräteadresse.
+     *
+     * Die nächste Übertragung an die Adresse sucht das Gerät erneut auf allen Segmenten.
+     */
+    void forget(unsigned address);
+
+    /**
+     * \brief Gibt das Segment einer Geräteadresse zurück.
+     * \return Index des Segments oder -1, wenn die Adresse noch keinem Segment zugeordnet ist.
+     */
+    int segmentOf(unsigned address) const;
+
+    /// Anzahl der Segmente.
+    unsigned segments(void) const { return segments_.size(); }
+
+    /// Bus des angegebenen Segments.
+    FeldbusAbstraction& segment(unsigned index) const { return *segments_[index]; }
+
+    void clearBuffer(void) override { }
+
+protected:
+    FeldbusAbstraction* route(unsigned targetAddress) override;
+    bool doTransceive(const uint8_t* transmit, int* transmit_length, uint8_t* receive, int* receive_length, bool delayTransmission) override;
+
+private:
+    static constexpr unsigned numberOfAddresses = 128;
+    static constexpr uint8_t unassigned = 0xFF;
+
+    bool broadcast(const uint8_t* transmit, int* transmit_length, uint8_t* receive, int* receive_length);
+    bool discover(unsigned address, const uint8_t* transmit, int* transmit_length, uint8_t* receive, int* receive_length);
+
+    ArrayBuffer<FeldbusAbstraction*, TURAG_FELDBUS_ROUTER_MAX_SEGMENTS> segments_;
+    std::atomic<uint8_t> segmentOf_[numberOfAddresses];
+    uint8_t broadcastBuffer_[TURAG_FELDBUS_ROUTER_MAX_BROADCAST_RESPONSE];
+};
+
+
+} // namespace Feldbus
+} // namespace TURAG
+
+#endif // TINAPP_FELDBUS_HOST_FELDBUS_ROUTER_H
@@ -0,0 +1,164 @@
+#define TURAG_DEBUG_LOG_SOURCE "B"
+
+#include <tina++/tina.h>
+
+#if TURAG_USE_TURAG_FELDBUS_HOST
+
+#include <tina/debug/print.h>
+#include <tina++/crc/xor.h>
+#include <tina++/crc/crc.h>
+#include <cstring>
+
+#include "feldbus_syncreadgroup.h"
+
+
+namespace TURAG {
+namespace Feldbus {
+
+namespace {
+
+// broadcast address, 0x00, command, slot length, device count
+constexpr unsigned headerSize = 5;
+
+bool checkResponse(const uint8_t* data, unsigned length, ChecksumType type) {
+    switch (type) {
+    case ChecksumType::xor_based:
+        return XOR::check(data, length - 1, data[length - 1]);
+    case ChecksumType::crc8:
+        return CRC8::check(data, length - 1, data[length - 1]);
+    case ChecksumType::none:
+        break;
+    }
+    return true;
+}
+
+} // namespace
+
+
+bool SyncReadGroup::addDevice(Device* device, void* response, unsigned responseLength)
+{
+    if (!device || !response || responseLength < 2) {
+        turag_errorf("SyncReadGroup: invalid device or response");
+        return false;
+    }
+    if (&device->bus() != &bus_) {
+        turag_errorf("%s: not connected to bus %s", device->name(), bus_.name());
+        return false;
+    }
+    if (responseLength + guardFrames_ > 255) {
+        turag_errorf("%s: response too long for sync read", device->name());
+        return false;
+    }
+    if (entries_.size() == entries_.max_size() ||
+            responseLength_ + responseLength > TURAG_FELDBUS_SYNCREAD_MAX_RESPONSE) {
+        turag_errorf("%s: sync read group is full", device->name());
+        return false;
+    }
+
+    entries_.push_back({device, static_cast<uint8_t*>(response), responseLength, false});
+    responseLength_ += responseLength;
+    return true;
+}
+
+bool SyncReadGroup::read(const void* request, unsigned length)
+{
+    if (length == 0 || length > TURAG_FELDBUS_SYNCREAD_MAX_REQUEST) {
+        turag_errorf("SyncReadGroup: invalid request length %u", length);
+        return false;
+    }
+
+    uint8_t transmit[headerSize + TURAG_FELDBUS_SYNCREAD_MAX_DEVICES + TURAG_FELDBUS_SYNCREAD_MAX_REQUEST + 1];
+    uint8_t receive[TURAG_FELDBUS_SYNCREAD_MAX_RESPONSE];
+
+    // Devices known to be dead would only leave gaps, so we don't ask them.
+    uint8_t active[TURAG_FELDBUS_SYNCREAD_MAX_DEVICES];
+    unsigned count = 0;
+    unsigned slotLength = 0;
+    int receiveLength = 0;
+    for (unsigned i = 0; i < entries_.size(); ++i) {
+        Entry& entry = entries_[i];
+        entry.success = false;
+        if (entry.device->availability() == Device::Availability::unavailable) {
+            continue;
+        }
+        transmit[headerSize + count] = static_cast<uint8_t>(entry.device->address());
+        active[count++] = static_cast<uint8_t>(i);
+        if (entry.length > slotLength) {
+            slotLength = entry.length;
+        }
+        receiveLength += entry.length;
+    }
+    if (count == 0) {
+        return false;
+    }
+
+    transmit[0] = TURAG_FELDBUS_BROADCAST_ADDR;
+    transmit[1] = TURAG_FELDBUS_BROADCAST_TO_ALL_DEVICES;
+    transmit[2] = TURAG_FELDBUS_DEVICE_BROADCAST_SYNC_READ;
+    transmit[3] = static_cast<uint8_t>(slotLength + guardFrames_);
+    transmit[4] = static_cast<uint8_t>(count);
+    std::memcpy(transmit + headerSize + count, request, length);
+
+    int transmitLength = headerSize + count + length + 1;
+    switch (checksumType_) {
+    case ChecksumType::xor_based:
+        transmit[transmitLength - 1] = XOR::calculate(transmit, transmitLength - 1);
+        break;
+    case ChecksumType::crc8:
+        transmit[transmitLength - 1] = CRC8::calculate(transmit, transmitLength - 1);
+        break;
+    case ChecksumType::none:
+        break;
+    }
+
+    // The responses are checked individually, so the bus must not check
+    // the whole buffer as one packet.
+    const int expected = receiveLength;
+    bus_.clearBuffer();
+    bus_.transceive(transmit, &transmitLength, receive, &receiveLength, TURAG_FELDBUS_BROADCAST_ADDR,
+                    ChecksumType::none, priority_, SystemTime::infinite(), 1, responseTimeout_);
+    if (receiveLength > expected) {
+        receiveLength = expected;
+    }
+
+    // Missing devices leave no bytes in the stream, so a response that does not
+    // fit at the current position belongs to one of the following devices.
+    unsigned answered = 0;
+    int position = 0;
+    for (unsigned i = 0; i < count; ++i) {
+        Entry& entry = entries_[active[i]];
+        const uint8_t* data = receive + position;
+        if (position + static_cast<int>(entry.length) > receiveLength ||
+                (data[0] & ~TURAG_FELDBUS_MASTER_ADDR) != entry.device->address()) {
+            continue;
+        }
+        // The device answered, so its slot is used even if the response is
+        // corrupted. Otherwise all following responses would be misaligned.
+        position += entry.length;
+        if (!checkResponse(data, entry.length, checksumType_)) {
+            continue;
+        }
+        std::memcpy(entry.response, data, entry.length);
+        entry.success = true;
+        ++answered;
+    }
+
+    return answered == count;
+}
+
+unsigned SyncReadGroup::responses(void) const
+{
+    unsigned answered = 0;
+    for (const Entry& entry : entries_) {
+        if (entry.success) {
+            ++answered;
+        }
+    }
+    return answered;
+}
+
+
+} // namespace Feldbus
+} // namespace TURAG
+
+#endif // TURAG_USE_TURAG_FELDBUS_HOST
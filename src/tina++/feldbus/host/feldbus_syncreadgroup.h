@@ -0,0 +1,169 @@
+#ifndef TINAPP_FELDBUS_HOST_FELDBUS_SYNCREADGROUP_H
+#define TINAPP_FELDBUS_HOST_FELDBUS_SYNCREADGROUP_H
+
+#include <tina++/tina.h>
+#include <tina++/time.h>
+#include <tina++/container/array_buffer.h>
+#include "device.h"
+
+
+#if !TURAG_USE_TURAG_FELDBUS_HOST
+# warning TURAG_USE_TURAG_FELDBUS_HOST must be defined to 1
+#endif
+
+
+/// \addtogroup feldbus-host
+/// \{
+
+/// Maximale Anzahl an Geräten in einer SyncReadGroup.
+#if !defined(TURAG_FELDBUS_SYNCREAD_MAX_DEVICES) || defined(__DOXYGEN__)
+# define TURAG_FELDBUS_SYNCREAD_MAX_DEVICES		16
+#endif
+
+/// Maximale Länge der Anfrage, die eine SyncReadGroup an alle Geräte sendet.
+#if !defined(TURAG_FELDBUS_SYNCREAD_MAX_REQUEST) || defined(__DOXYGEN__)
+# define TURAG_FELDBUS_SYNCREAD_MAX_REQUEST		16
+#endif
+
+/// Maximale Summe der Antwortlängen aller Geräte einer SyncReadGroup.
+#if !defined(TURAG_FELDBUS_SYNCREAD_MAX_RESPONSE) || defined(__DOXYGEN__)
+# define TURAG_FELDBUS_SYNCREAD_MAX_RESPONSE		256
+#endif
+
+/// Standardwert für die Anzahl an Byte-Zeiten, die jeder Zeitschlitz länger
+/// als die längste Antwort ist, um Verarbeitungszeit und Ungenauigkeiten der
+/// Slaves auszugleichen.
+#if !defined(TURAG_FELDBUS_SYNCREAD_GUARD_FRAMES) || defined(__DOXYGEN__)
+# define TURAG_FELDBUS_SYNCREAD_GUARD_FRAMES		2
+#endif
+
+/// \}
+
+
+namespace TURAG {
+namespace Feldbus {
+
+
+/**
+ * \brief Liest dieselben Daten von mehreren Geräten mit einer einzigen Anfrage.
+ *
+ * Statt jedes Gerät einzeln abzufragen und dabei pro Gerät Anfrage, Paket-Delay und
+ * Antwortverzögerung zu bezahlen, sendet read() einen Sync-Read-Broadcast
+ * (\ref TURAG_FELDBUS_DEVICE_BROADCAST_SYNC_READ) mit der Liste der Geräte. Jedes
+ * Gerät verarbeitet die Anfrage wie ein direkt an es adressiertes Paket und antwortet
+ * in seinem Zeitschlitz, sodass alle Antworten ohne Kollision in einer einzigen
+ * Übertragung empfangen werden:
+ * \code
+ * SyncReadGroup group(bus);
+ * Device::Response<int16_t> positions[3];
+ * group.addDevice(&motor1, &positions[0]);
+ * group.addDevice(&motor2, &positions[1]);
+ * group.addDevice(&motor3, &positions[2]);
+ * ...
+ * uint8_t key = 1; // command key of the current position
+ * group.read(key);
+ * \endcode
+ *
+ * Die Zeitschlitze sind so lang wie die längste Antwort zuzüglich
+ * \ref TURAG_FELDBUS_SYNCREAD_GUARD_FRAMES Byte-Zeiten. Antwortet ein Gerät nicht,
+ * bleibt sein Zeitschlitz leer und die Antworten der übrigen Geräte werden trotzdem
+ * ausgewertet. Geräte, deren Device::availability() Device::Availability::unavailable
+ * ist, werden nicht in die Anfrage aufgenommen.
+ *
+ * Die Geräte müssen Sync-Reads unterstützen, also Slave::Base mit
+ * TURAG_FELDBUS_SLAVE_BROADCASTS_AVAILABLE verwenden, und 1 Byte lange Adressen haben.
+ *
+ * \note Die Klasse ist nicht thread-safe.
+ */
+class SyncReadGroup {
+public:
+    /**
+     * \brief Konstruktor.
+     * \param bus Bus, an dem alle Geräte der Gruppe hängen.
+     * \param type Checksummentyp der Geräte.
+     * \param guardFrames Zusätzliche Byte-Zeiten pro Zeitschlitz.
+     */
+    explicit SyncReadGroup(FeldbusAbstraction& bus,
+                           ChecksumType type = TURAG_FELDBUS_DEVICE_CONFIG_STANDARD_CHECKSUM_TYPE,
+                           unsigned guardFrames = TURAG_FELDBUS_SYNCREAD_GUARD_FRAMES) :
+        bus_(bus), checksumType_(type), guardFrames_(guardFrames), responseLength_(0),
+        responseTimeout_(SystemTime::infinite()), priority_(TransmissionPriority::control)
+    { }
+
+    /**
+     * \brief Fügt ein Gerät hinzu.
+     * \param device Gerät, das am Bus der Gruppe hängen muss.
+     * \param response Puffer für die Antwort inklusive Adresse und Checksumme.
+     * \param responseLength Länge der Antwort inklusive Adresse und Checksumme.
+     * \return False, wenn die Gruppe voll ist oder das Gerät nicht passt.
+     *
+     * Die Geräte antworten in der Reihenfolge, in der sie hinzugefügt wurden.
+     */
+    bool addDevice(Device* device, void* response, unsigned responseLength);
+
+    /// Fügt ein Gerät mit einer Antwort vom Typ Device::Response<T> hinzu.
+    template<typename T>
+    bool addDevice(Device* device, BaseDevice::Response<T>* response) {
+        return addDevice(device, response, sizeof(*response));
+    }
+
+    /**
+     * \brief Sendet eine Anfrage an alle Geräte und empfängt ihre Antworten.
+     * \param request Datenteil der Anfrage ohne Adresse und Checksumme.
+     * \param length Länge der Anfrage.
+     * \return True, wenn alle angefragten Geräte geantwortet haben.
+     *
+     * Welche Geräte geantwortet haben, gibt success() zurück. Die Antwortpuffer
+     * der übrigen Geräte bleiben unverändert.
+     */
+    bool read(const void* request, unsigned length);
+
+    /// Sendet eine Anfrage vom Typ T an alle Geräte.
+    template<typename T>
+    bool read(const T& request) {
+        return read(&request, sizeof(request));
+    }
+
+    /// Gibt zurück, ob das i-te Gerät beim letzten read() geantwortet hat.
+    bool success(unsigned i) const { return i < entries_.size() && entries_[i].success; }
+
+    /// Anzahl der Geräte.
+    unsigned size(void) const { return entries_.size(); }
+
+    /// Anzahl der Geräte, die beim letzten read() geantwortet haben.
+    unsigned responses(void) const;
+
+    /**
+     * \brief Stellt den Antwort-Timeout ein.
+     *
+     * Wird an FeldbusAbstraction::transceive() übergeben. Der Timeout sollte
+     * die Zeitschlitze aller Geräte abdecken. Bei SystemTime::infinite() wird
+     * der Standard-Timeout des Busses verwendet.
+     */
+    void setResponseTimeout(SystemTime timeout) { responseTimeout_ = timeout; }
+
+    /// Stellt die Priorität der Anfragen ein.
+    void setTransmissionPriority(TransmissionPriority priority) { priority_ = priority; }
+
+private:
+    struct Entry {
+        Device* device;
+        uint8_t* response;
+        unsigned length;
+        bool success;
+    };
+
+    FeldbusAbstraction& bus_;
+    const ChecksumType checksumType_;
+    const unsigned guardFrames_;
+    unsigned responseLength_;
+    SystemTime responseTimeout_;
+    TransmissionPriority priority_;
+    ArrayBuffer<Entry, TURAG_FELDBUS_SYNCREAD_MAX_DEVICES> entries_;
+};
+
+
+} // namespace Feldbus
+} // namespace TURAG
+
+#endif // TINAPP_FELDBUS_HOST_FELDBUS_SYNCREADGROUP_H
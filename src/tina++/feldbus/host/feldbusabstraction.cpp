@@ -5,6 +5,8 @@
 
 
 #include <tina++/feldbus/host/feldbusabstraction.h>
+#include <tina++/feldbus/host/feldbus_flightrecorder.h>
+#include <tina++/feldbus/host/feldbus_busmeter.h>
 #include <tina++/debug.h>
 #include <tina++/crc/xor.h>
 #include <tina++/crc/crc.h>
@@ -13,12 +15,262 @@
 namespace TURAG {
 namespace Feldbus {
 
-FeldbusAbstraction::ResultStatus FeldbusAbstraction::transceive(const uint8_t *transmit, int *transmit_length, uint8_t *receive, int *receive_length, unsigned targetAddress, ChecksumType checksumType)
+FeldbusAbstraction::ResultStatus FeldbusAbstraction::transceive(const uint8_t *transmit, int *transmit_length, uint8_t *receive, int *receive_length, unsigned targetAddress, ChecksumType checksumType,
+																  TransmissionPriority priority, SystemTime deadline, unsigned attempt,
+																  SystemTime responseTimeout, SystemTime* duration)
 {
+	FeldbusAbstraction* segment = route(targetAddress);
+	if (segment != this) {
+		return segment->transceive(transmit, transmit_length, receive, receive_length, targetAddress, checksumType,
+								   priority, deadline, attempt, responseTimeout, duration);
+	}
+
+	// the lengths are overwritten with the actual ones, but the recorder wants both
+	const int requestLength = transmit_length ? *transmit_length : 0;
+	const int expectedLength = receive && receive_length ? *receive_length : 0;
+
+	ResultStatus status;
+	SystemTime start;
+	if (duration) {
+		*duration = SystemTime(0);
+	}
+
+	if (threadSafe_ && !acquireBus(priority, deadline)) {
+		++deadlineMisses_;
+		status = ResultStatus::DeadlineMissed;
+		start = SystemTime::now();
+	} else {
+		start = SystemTime::now();
+		if (deadline != SystemTime::infinite() && start > deadline) {
+			++deadlineMisses_;
+			status = ResultStatus::DeadlineMissed;
+		} else {
+			// only valid while we own the bus
+			responseTimeout_ = responseTimeout;
+			priority_ = priority;
+			deadline_ = deadline;
+			status = doTransaction(transmit, transmit_length, receive, receive_length, targetAddress, checksumType, duration);
+			responseTimeout_ = SystemTime::infinite();
+		}
+
+		if (threadSafe_) {
+			releaseBus();
+		}
+	}
+
+	FlightRecorder* recorder = flightRecorder_;
+	if (recorder) {
+		const int responseLength = status != ResultStatus::DeadlineMissed && expectedLength ? *receive_length : 0;
+		recorder->record(start, targetAddress, checksumType,
+						 transmit, requestLength,
+						 receive, expectedLength, responseLength,
+						 status, attempt);
+	}
+
+	return status;
+}
+
+bool FeldbusAbstraction::setBaudRate(unsigned baudRate)
+{
+	if (threadSafe_ && !acquireBus(TransmissionPriority::realtime, SystemTime::infinite())) {
+		return false;
+	}
+
+	const bool success = doSetBaudRate(baudRate);
+	if (success) {
+		BusMeter* meter = busMeter_;
+		if (meter) {
+			meter->setBaudRate(baudRate);
+		}
+		// slaves still listening with the old baud rate might be in the middle
+		// of a garbled packet, so the next one is delayed in any case
+		lastTargetAddress_ = TURAG_FELDBUS_BROADCAST_ADDR;
+	} else {
+		turag_errorf("%s: can't switch to %u baud", name(), baudRate);
+	}
+
 	if (threadSafe_) {
-		sem_.wait();
+		releaseBus();
+	}
+	return success;
+}
+
+bool FeldbusAbstraction::acquireBus(TransmissionPriority priority, SystemTime deadline)
+{
+	const unsigned index = static_cast<unsigned>(priority);
+
+	{
+		Mutex::Lock lock(arbitrationMutex_);
+
+		if (!busBusy_) {
+			busBusy_ = true;
+			return true;
+		}
+		++busWaiters_[index];
+	}
+
+	if (deadline == SystemTime::infinite()) {
+		busGrant_[index].wait();
+		return true;
+	}
+
+	SystemTime now = SystemTime::now();
+	if (deadline > now && busGrant_[index].wait(deadline - now)) {
+		return true;
+	}
+
+	// The deadline passed while waiting. The bus is only handed over with the
+	// mutex held, so we can safely check whether it was granted to us in the
+	// meantime. In that case the caller has to release it again.
+	Mutex::Lock lock(arbitrationMutex_);
+	if (busGrant_[index].wait(SystemTime::immediate())) {
+		return true;
+	}
+	--busWaiters_[index];
+	return false;
+}
+
+void FeldbusAbstraction::releaseBus(void)
+{
+	Mutex::Lock lock(arbitrationMutex_);
+
+	for (unsigned i = 0; i < numberOfPriorities; ++i) {
+		if (busWaiters_[i] > 0) {
+			--busWaiters_[i];
+			busGrant_[i].signal();
+			return;
+		}
+	}
+	busBusy_ = false;
+}
+
+bool FeldbusAbstraction::submit(Transaction* transaction)
+{
+	FeldbusAbstraction* segment = route(transaction->targetAddress_);
+	if (segment != this) {
+		return segment->submit(transaction);
+	}
+
+	if (transaction->pending_.exchange(true)) {
+		return false;
+	}
+
+	transaction->transmitLength_ = transaction->requestedTransmitLength_;
+	transaction->receiveLength_ = transaction->requestedReceiveLength_;
+	transaction->status_ = ResultStatus::TransmissionError;
+	transaction->next_ = nullptr;
+
+	{
+		Mutex::Lock lock(queueMutex_);
+
+		const unsigned index = static_cast<unsigned>(transaction->priority_);
+		if (queueTail_[index]) {
+			queueTail_[index]->next_ = transaction;
+		} else {
+			queueHead_[index] = transaction;
+		}
+		queueTail_[index] = transaction;
 	}
 
+	queueSignal_.signal();
+	return true;
+}
+
+FeldbusAbstraction::Transaction* FeldbusAbstraction::popQueue(void)
+{
+	Mutex::Lock lock(queueMutex_);
+
+	const unsigned lastTarget = lastTargetAddress_;
+
+	for (unsigned i = 0; i < numberOfPriorities; ++i) {
+		Transaction* head = queueHead_[i];
+		if (!head) {
+			continue;
+		}
+
+		// Prefer the oldest transaction to the slave we talked to last, which
+		// saves the bus delay. The order of transactions to the same slave is
+		// kept, and the head is only overtaken a bounded number of times.
+		Transaction* previous = nullptr;
+		if (lastTarget != TURAG_FELDBUS_BROADCAST_ADDR &&
+				head->targetAddress_ != lastTarget &&
+				head->deadline_ == SystemTime::infinite() &&
+				queueOvertaken_[i] < reorderLimit_) {
+			for (Transaction* t = head; t->next_; t = t->next_) {
+				if (t->next_->targetAddress_ == lastTarget) {
+					previous = t;
+					break;
+				}
+			}
+		}
+
+		Transaction* transaction;
+		if (previous) {
+			transaction = previous->next_;
+			previous->next_ = transaction->next_;
+			if (queueTail_[i] == transaction) {
+				queueTail_[i] = previous;
+			}
+			++queueOvertaken_[i];
+			++savedDelays_;
+		} else {
+			transaction = head;
+			queueHead_[i] = head->next_;
+			if (!queueHead_[i]) {
+				queueTail_[i] = nullptr;
+			}
+			queueOvertaken_[i] = 0;
+		}
+		transaction->next_ = nullptr;
+		return transaction;
+	}
+	return nullptr;
+}
+
+bool FeldbusAbstraction::processQueue(SystemTime timeout)
+{
+	// The semaphore counts submissions, but the queue is drained completely
+	// on every call. Surplus signals only lead to an empty pass.
+	Transaction* transaction = popQueue();
+	if (!transaction) {
+		if (!queueSignal_.wait(timeout)) {
+			return false;
+		}
+		transaction = popQueue();
+		if (!transaction) {
+			return false;
+		}
+	}
+
+	do {
+		// The bus is acquired for every single transaction, so that
+		// blocking calls of transceive() from other threads with a higher
+		// priority get their turn in between.
+		transaction->status_ = transceive(
+					transaction->transmit_, &transaction->transmitLength_,
+					transaction->receive_, &transaction->receiveLength_,
+					transaction->targetAddress_, transaction->checksumType_,
+					transaction->priority_, transaction->deadline_);
+
+		// Fetch the handler before releasing the transaction because the
+		// owner is allowed to reuse it as soon as it is not pending anymore.
+		Transaction::CompletionHandler handler = transaction->handler_;
+		void* context = transaction->context_;
+		transaction->pending_ = false;
+		if (handler) {
+			handler(transaction, context);
+		} else {
+			transaction->done_.signal();
+		}
+
+		transaction = popQueue();
+	} while (transaction);
+
+	return true;
+}
+
+FeldbusAbstraction::ResultStatus FeldbusAbstraction::doTransaction(const uint8_t *transmit, int *transmit_length, uint8_t *receive, int *receive_length, unsigned targetAddress, ChecksumType checksumType, SystemTime* duration)
+{
 	// we need to delay the transmission for protocol compliance reasons in the following
 	// cases:
 	// - our last transmission was a broadcast
@@ -31,23 +283,51 @@ FeldbusAbstraction::ResultStatus FeldbusAbstraction::transceive(const uint8_t *t
 		insertTransmissionDelay = false;
 	}
 
+	receiveChecksum_.reset(checksumType);
+
+	const SystemTime start = SystemTime::now();
 	bool transceiveSuccessful = doTransceive(transmit, transmit_length, receive, receive_length, insertTransmissionDelay);
+	const SystemTime end = SystemTime::now();
+	const SystemTime elapsed = end - start;
+	busLatencyHistogram_.add(elapsed);
+	BusMeter* meter = busMeter_;
+	if (meter) {
+		meter->account(start, end, targetAddress,
+					   transmit && transmit_length ? *transmit_length : 0,
+					   receive && receive_length ? *receive_length : 0,
+					   insertTransmissionDelay);
+	}
+	if (duration) {
+		// Only the time the slave took to answer, which is what the response
+		// timeout limits. The bus delay and the bytes on the wire are calculated
+		// like in BusMeter, the delay might have been shorter though.
+		const unsigned bytes = (transmit && transmit_length ? *transmit_length : 0) +
+							   (receive && receive_length ? *receive_length : 0);
+		const unsigned long long wireTimeUs = BusMeter::wireTimeUs(bytes, insertTransmissionDelay, baudRate());
+		const unsigned elapsedUs = elapsed.toUsec();
+		*duration = elapsedUs > wireTimeUs ? SystemTime::fromUsec(static_cast<unsigned>(elapsedUs - wireTimeUs)) : SystemTime(0);
+	}
 	ResultStatus status = ResultStatus::TransmissionError;
 
 	// Transmission seems fine, lets look at the checksum.
 	// It might seem less than ideal to let the device calculate the transmit checksum and then
 	// check the received one here but it's due to performance reasons. The device should calculate
 	// the outgoing one to save it in case the first transmission attempt fails. But we also want checksum
-	// errors to be reflected in the statistics thus the need to calculate the received checksum here.
-	// Depending on the implementation of the checksum this calculation might take some time
-	// while the lock is still acquired. But the other option would be to release it and reacquire it
-	// afterwards, which I felt would in most cases probably be more costly.
+	// errors to be reflected in the statistics thus the need to check the received checksum here.
+	// Drivers that pass the received bytes to accumulateReceived() already calculated it while
+	// waiting for the rest of the response, which leaves a single compare for the locked section.
+	// For all others the calculation over the receive buffer takes some time while the lock is
+	// still acquired. But the other option would be to release it and reacquire it afterwards,
+	// which I felt would in most cases probably be more costly.
 	if (transceiveSuccessful)
 	{
         if (!receive || !receive_length || *receive_length == 0) {
 			// if the caller doesn't want to receive anything and the transmission was successful
 			// we can't check the checksum
 			status = ResultStatus::Success;
+		} else if (receiveChecksum_.length() == static_cast<std::size_t>(*receive_length)) {
+			// the driver calculated the checksum while receiving
+			status = receiveChecksum_.valid() ? ResultStatus::Success : ResultStatus::ChecksumError;
 		} else {
 			// transmission seems fine, lets look at the checksum
 			bool checksum_correct = false;
@@ -72,6 +352,10 @@ FeldbusAbstraction::ResultStatus FeldbusAbstraction::transceive(const uint8_t *t
 	}
 
 
+	// After a failed transfer the slave might still be sending or waiting
+	// for the rest of the packet, so the next one is delayed in any case.
+	lastTargetAddress_ = status == ResultStatus::Success ? targetAddress : TURAG_FELDBUS_BROADCAST_ADDR;
+
 	if (busTransmissionStatistics_.doErrorOutput(status == ResultStatus::Success))
 	{
 		turag_warningf("%s: %u/%u failed transmissions on the bus so far (%u %% success).",
@@ -81,10 +365,6 @@ FeldbusAbstraction::ResultStatus FeldbusAbstraction::transceive(const uint8_t *t
 					   busTransmissionStatistics_.getSuccessRatio());
 	}
 
-	if (threadSafe_) {
-		sem_.signal();
-	}
-
 	return status;
 }
 
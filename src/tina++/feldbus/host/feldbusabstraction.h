@@ -6,17 +6,39 @@
 #include <tina++/time.h>
 #include <tina++/thread.h>
 #include <tina++/debug/errorobserver.h>
+#include <tina++/debug/latencyhistogram.h>
+#include <tina++/crc/xor.h>
+#include <tina++/crc/crc.h>
 #include <tina/feldbus/protocol/turag_feldbus_bus_protokoll.h>
 
+#include <atomic>
+
 
 #if !TURAG_USE_TURAG_FELDBUS_HOST
 # warning TURAG_USE_TURAG_FELDBUS_HOST must be defined to 1
 #endif
 
 
+/// \addtogroup feldbus-host
+/// \{
+
+/// Standardwert dafür, wie oft die älteste eingereihte Übertragung einer
+/// Prioritätsklasse von Übertragungen an das zuletzt angesprochene Gerät
+/// überholt werden darf. Bei 0 werden Übertragungen nie umsortiert.
+/// \see FeldbusAbstraction::setQueueReordering()
+#if !defined(TURAG_FELDBUS_QUEUE_REORDER_LIMIT) || defined(__DOXYGEN__)
+# define TURAG_FELDBUS_QUEUE_REORDER_LIMIT		4
+#endif
+
+/// \}
+
+
 namespace TURAG {
 namespace Feldbus {
 
+class FlightRecorder;
+class BusMeter;
+
 /*!
  * \brief Verfügbare Checksummenalgorithmen.
  * \see \ref checksums
@@ -27,6 +49,73 @@ enum class ChecksumType : uint8_t {
 	none = 0xFF ///< Keine Checksumme verwenden.
 };
 
+/*!
+ * \brief Berechnet eine Checksumme stückweise, während die Daten eintreffen.
+ *
+ * Wird die korrekte Checksumme selbst mit eingerechnet, ergibt sich bei XOR und
+ * CRC8 null. Ein vollständig eingerechnetes Paket ist deshalb genau dann korrekt,
+ * wenn valid() true liefert, ohne dass das Ende des Pakets bekannt sein muss.
+ * \see FeldbusAbstraction::accumulateReceived()
+ */
+class ChecksumAccumulator {
+public:
+	explicit ChecksumAccumulator(ChecksumType type = ChecksumType::none) {
+		reset(type);
+	}
+
+	/// Beginnt eine neue Checksumme vom Typ \a type.
+	void reset(ChecksumType type) {
+		type_ = type;
+		value_ = type == ChecksumType::crc8 ? CRC8::initialValue : 0;
+		length_ = 0;
+	}
+
+	/// Rechnet \a length Bytes ab \a data ein.
+	void update(const uint8_t* data, std::size_t length) {
+		switch (type_) {
+		case ChecksumType::xor_based:
+			value_ ^= XOR::calculate(data, length);
+			break;
+		case ChecksumType::crc8:
+			value_ = CRC8::update(value_, data, length);
+			break;
+		case ChecksumType::none:
+			break;
+		}
+		length_ += length;
+	}
+
+	/// Checksumme der bisher eingerechneten Bytes.
+	uint8_t value(void) const { return value_; }
+
+	/// Anzahl der bisher eingerechneten Bytes.
+	std::size_t length(void) const { return length_; }
+
+	/// Typ der Checksumme.
+	ChecksumType type(void) const { return type_; }
+
+	/// Gibt an, ob die eingerechneten Bytes mit ihrer korrekten Checksumme enden.
+	bool valid(void) const { return type_ == ChecksumType::none || value_ == 0; }
+
+private:
+	ChecksumType type_;
+	uint8_t value_;
+	std::size_t length_;
+};
+
+/*!
+ * \brief Prioritätsklassen für den Buszugriff.
+ *
+ * Warten mehrere Übertragungen auf den Bus, so erhält immer die Übertragung
+ * mit der höchsten Priorität den Zuschlag. Innerhalb einer Klasse wird der Bus
+ * in der Reihenfolge der Anfragen vergeben.
+ */
+enum class TransmissionPriority : uint8_t {
+	realtime = 0, ///< Zeitkritische Übertragungen, z.B. Sollwerte von Regelkreisen.
+	control = 1, ///< Gewöhnliche Übertragungen (Standard).
+	background = 2 ///< Unkritische Übertragungen wie Diagnose oder Bootloader-Zugriffe.
+};
+
 
 
 /**
@@ -41,10 +130,18 @@ enum class ChecksumType : uint8_t {
  * Die eigentliche Implementierung des Transports obliegt abzuleitenden
  * Subklassen, die plattformabhängig sind.
  *
- * Im Konstruktor kann angegeben werden, ob der Buszugriff mit einer
- * Semaphore geschützt werden soll. Ist dies der Fall, so kann ein
- * Busobjekt von Feldbusgeräten in unterschiedlichen Threads benutzt
- * werden.
+ * Im Konstruktor kann angegeben werden, ob der Buszugriff geschützt
+ * werden soll. Ist dies der Fall, so kann ein Busobjekt von Feldbusgeräten
+ * in unterschiedlichen Threads benutzt werden. Der Bus wird dann nach
+ * Prioritätsklassen (siehe TransmissionPriority) vergeben.
+ *
+ * Neben dem blockierenden transceive() können Übertragungen auch
+ * asynchron mit submit() in eine Warteschlange eingereiht werden.
+ * Diese wird von einem Thread abgearbeitet, der processQueue()
+ * aufruft und damit Besitzer des Busses ist. Dieser Thread führt die
+ * eingereihten Übertragungen direkt nacheinander aus, prüft die
+ * Checksummen, führt die Statistiken und benachrichtigt die Aufrufer.
+ * Die einreihenden Threads werden dabei nicht blockiert.
  */
 class FeldbusAbstraction
 {
@@ -62,19 +159,158 @@ public:
 		ChecksumError,
 		/// Innerhalb des Timeouts nicht genügend Daten gesendet oder empfangen
 		/// oder ein anderes, transportspezifisches Problem.
-		TransmissionError
+		TransmissionError,
+		/// Die Deadline ist vor der Zuteilung des Busses abgelaufen,
+		/// die Übertragung wurde verworfen.
+		DeadlineMissed
+	};
+
+	/**
+	 * @brief Asynchron auszuführende Busübertragung.
+	 *
+	 * Instanzen dieser Klasse werden vom Aufrufer bereitgestellt und mit
+	 * FeldbusAbstraction::submit() in die Warteschlange des Busses eingereiht.
+	 * Die Instanz selbst sowie Sende- und Empfangspuffer müssen gültig bleiben,
+	 * bis die Übertragung abgeschlossen ist.
+	 *
+	 * Der Abschluss kann entweder über einen Callback signalisiert werden,
+	 * der im Kontext des Threads aufgerufen wird, der processQueue() ausführt,
+	 * oder mit wait() abgewartet werden. Ein abgeschlossenes Objekt kann
+	 * erneut eingereiht werden.
+	 */
+	class Transaction {
+		friend class FeldbusAbstraction;
+
+		Transaction(const Transaction&) = delete;
+		Transaction& operator=(const Transaction&) = delete;
+
+	public:
+		/**
+		 * @brief Typ des Callbacks, der nach Abschluss der Übertragung aufgerufen wird.
+		 *
+		 * Der Callback wird im Thread des Busbesitzers aufgerufen und sollte
+		 * daher schnell zurückkehren. Er darf die Übertragung erneut einreihen.
+		 */
+		typedef void (*CompletionHandler)(Transaction* transaction, void* context);
+
+		/**
+		 * @brief Erzeugt eine asynchrone Übertragung.
+		 * @param transmit Pointer auf den Sendepuffer (inklusive Adresse und Checksumme).
+		 * @param transmitLength Größe der zu sendenden Daten.
+		 * @param receive Pointer auf den Empfangspuffer.
+		 * @param receiveLength Größe der zu empfangenden Daten.
+		 * @param targetAddress Adresse, an die das Paket gesendet wird.
+		 * @param checksumType Checksummentyp, mit der die Transmission abgesichert wird.
+		 * @param handler Optionaler Callback, der nach Abschluss aufgerufen wird.
+		 * @param context Beliebiger Zeiger, der dem Callback übergeben wird.
+		 */
+		Transaction(const uint8_t* transmit, int transmitLength,
+					uint8_t* receive, int receiveLength,
+					unsigned targetAddress, ChecksumType checksumType,
+					CompletionHandler handler = nullptr, void* context = nullptr) :
+			transmit_(transmit), receive_(receive),
+			transmitLength_(transmitLength), receiveLength_(receiveLength),
+			requestedTransmitLength_(transmitLength), requestedReceiveLength_(receiveLength),
+			targetAddress_(targetAddress), checksumType_(checksumType),
+			status_(ResultStatus::TransmissionError),
+			priority_(TransmissionPriority::control), deadline_(SystemTime::infinite()),
+			handler_(handler), context_(context),
+			next_(nullptr), done_(0), pending_(false)
+		{ }
+
+		/**
+		 * @brief Blockiert, bis die Übertragung abgeschlossen ist.
+		 * @return Ergebnis der Übertragung.
+		 *
+		 * Nur verwendbar, wenn kein Callback angegeben wurde. Pro Einreihung darf
+		 * diese Funktion nur von einem Thread aufgerufen werden.
+		 */
+		ResultStatus wait(void) {
+			done_.wait();
+			return status_;
+		}
+
+		/**
+		 * @brief Blockiert, bis die Übertragung abgeschlossen ist
+		 * oder die angegebene Zeit verstrichen ist.
+		 * @param timeout Maximale Wartezeit.
+		 * @return True, wenn die Übertragung abgeschlossen wurde.
+		 *
+		 * Nur verwendbar, wenn kein Callback angegeben wurde.
+		 */
+		bool wait(SystemTime timeout) {
+			return done_.wait(timeout);
+		}
+
+		/// Gibt zurück, ob die Übertragung noch aussteht.
+		bool isPending(void) const { return pending_; }
+
+		/// Ergebnis der Übertragung. Nur nach Abschluss gültig.
+		ResultStatus status(void) const { return status_; }
+
+		/// Größe der tatsächlich gesendeten Daten. Nur nach Abschluss gültig.
+		int transmitLength(void) const { return transmitLength_; }
+
+		/// Größe der tatsächlich empfangenen Daten. Nur nach Abschluss gültig.
+		int receiveLength(void) const { return receiveLength_; }
+
+		/// Adresse, an die das Paket gesendet wird.
+		unsigned targetAddress(void) const { return targetAddress_; }
+
+		/**
+		 * @brief Legt Priorität und Deadline der Übertragung fest.
+		 * @param priority Prioritätsklasse.
+		 * @param deadline Absoluter Zeitpunkt, bis zu dem die Übertragung
+		 * begonnen haben muss. Standardmäßig unbegrenzt.
+		 *
+		 * Darf nur aufgerufen werden, solange die Übertragung nicht aussteht.
+		 */
+		void setPriority(TransmissionPriority priority, SystemTime deadline = SystemTime::infinite()) {
+			priority_ = priority;
+			deadline_ = deadline;
+		}
+
+		/// Prioritätsklasse der Übertragung.
+		TransmissionPriority priority(void) const { return priority_; }
+
+		/// Deadline der Übertragung.
+		SystemTime deadline(void) const { return deadline_; }
+
+	private:
+		const uint8_t* transmit_;
+		uint8_t* receive_;
+		int transmitLength_;
+		int receiveLength_;
+		int requestedTransmitLength_;
+		int requestedReceiveLength_;
+		unsigned targetAddress_;
+		ChecksumType checksumType_;
+		ResultStatus status_;
+		TransmissionPriority priority_;
+		SystemTime deadline_;
+		CompletionHandler handler_;
+		void* context_;
+
+		Transaction* next_;
+		Semaphore done_;
+		std::atomic<bool> pending_;
 	};
 
 	/**
 	 * @brief Erzeugt ein FeldbusAbstraction-Objekt.
 	 * @param name Name des Busses.
-	 * @param threadSafe Gibt an, ob der Zugriff auf den Bus mit
-	 * einer Semaphore geschützt werden soll.
+	 * @param threadSafe Gibt an, ob der Zugriff auf den Bus
+	 * geschützt werden soll.
 	 */
 	FeldbusAbstraction(const char* name, bool threadSafe = true) :
 		name_(name), busTransmissionStatistics_(SystemTime::fromSec(5), 0, 50),
-		sem_(1), lastTargetAddress_(TURAG_FELDBUS_BROADCAST_ADDR),
-		threadSafe_(threadSafe)
+		deadlineMisses_(0), busBusy_(false), busWaiters_{},
+		lastTargetAddress_(TURAG_FELDBUS_BROADCAST_ADDR), responseTimeout_(SystemTime::infinite()),
+		priority_(TransmissionPriority::control), deadline_(SystemTime::infinite()),
+		threadSafe_(threadSafe),
+		queueHead_{}, queueTail_{}, queueOvertaken_{}, queueSignal_(0),
+		reorderLimit_(TURAG_FELDBUS_QUEUE_REORDER_LIMIT), savedDelays_(0),
+		flightRecorder_(nullptr), busMeter_(nullptr)
 	{}
 
 #if TURAG_USE_LIBSUPCPP_RUNTIME_SUPPORT
@@ -94,6 +330,17 @@ public:
 	 * effizienten Einhalten des 15-Frame-Delays zwischen Transmissionen nötig,
 	 * da diese Klasse keine Information über die im Paket verwendete Adresslänge hat).
 	 * \param[in] checksumType Checksummentyp, mit der die Transmission abgesichert wird.
+	 * \param[in] priority Prioritätsklasse, mit der der Bus angefordert wird.
+	 * \param[in] deadline Absoluter Zeitpunkt, bis zu dem der Bus zugeteilt sein muss.
+	 * Läuft die Deadline vorher ab, wird die Übertragung verworfen.
+	 * \param[in] attempt Nummer des Übertragungsversuchs, wird nur für die
+	 * Aufzeichnung durch einen FlightRecorder verwendet.
+	 * \param[in] responseTimeout Maximale Wartezeit auf die Antwort für diese
+	 * Übertragung. Bei SystemTime::infinite() gilt der Standardwert der Subklasse.
+	 * \param[out] duration Wenn nicht null, enthält es nach Rückkehr die Antwortzeit
+	 * des Slaves: die Dauer der Übertragung auf dem Bus (ohne das Warten auf die
+	 * Zuteilung des Busses) abzüglich des Paket-Delays und der Zeit, die Anfrage und
+	 * Antwort bei der Baudrate des Busses auf der Leitung benötigen.
 	 * \return True wenn die korrekte Menge Daten gesendet und empfangen wurden, ansonsten false.
 	 *
 	 * Diese Funktion sendet blockierend einen Satz Daten auf den Bus und empfängt
@@ -110,7 +357,70 @@ public:
 	 * Wenn die Übertragung schon beim Senden scheitert, steht in receive_length 0.
      *
      */
-	ResultStatus transceive(const uint8_t *transmit, int *transmit_length, uint8_t *receive, int *receive_length, unsigned targetAddress, ChecksumType checksumType);
+	ResultStatus transceive(const uint8_t *transmit, int *transmit_length, uint8_t *receive, int *receive_length, unsigned targetAddress, ChecksumType checksumType,
+							TransmissionPriority priority = TransmissionPriority::control, SystemTime deadline = SystemTime::infinite(),
+							unsigned attempt = 1, SystemTime responseTimeout = SystemTime::infinite(),
+							SystemTime* duration = nullptr);
+
+	/**
+	 * \brief Reiht eine Übertragung in die Warteschlange des Busses ein.
+	 * \param[in] transaction Auszuführende Übertragung.
+	 * \return False, wenn die Übertragung bereits eingereiht ist und
+	 * noch aussteht, ansonsten true.
+	 *
+	 * Die Funktion kehrt sofort zurück. Ausgeführt wird die Übertragung
+	 * vom Thread, der processQueue() aufruft. Eingereihte Übertragungen
+	 * werden nach Priorität und innerhalb einer Prioritätsklasse grundsätzlich
+	 * in der Reihenfolge des Einreihens abgearbeitet. Übertragungen an dasselbe
+	 * Gerät werden dabei nie umsortiert, siehe setQueueReordering().
+	 */
+	bool submit(Transaction* transaction);
+
+	/**
+	 * \brief Legt fest, wie weit die Warteschlange umsortiert werden darf.
+	 * \param[in] limit Wie oft die älteste Übertragung einer Prioritätsklasse
+	 * höchstens überholt werden darf. Bei 0 wird nie umsortiert.
+	 *
+	 * Zwischen Paketen an verschiedene Geräte muss das Paket-Delay eingehalten
+	 * werden. Damit es bei abwechselnd einreihenden Threads nicht vor fast
+	 * jedem Paket anfällt, zieht processQueue() innerhalb einer Prioritätsklasse
+	 * die älteste Übertragung an das zuletzt angesprochene Gerät vor.
+	 * Höhere Prioritätsklassen gehen weiterhin immer vor. Eine Übertragung mit
+	 * Deadline wird nie überholt, sobald sie die älteste ihrer Klasse ist.
+	 * Standardwert ist \ref TURAG_FELDBUS_QUEUE_REORDER_LIMIT.
+	 */
+	void setQueueReordering(unsigned limit) { reorderLimit_ = limit; }
+
+	/**
+	 * \brief Anzahl der Paket-Delays, die durch Umsortieren der Warteschlange
+	 * eingespart wurden.
+	 * \see savedDelayTime()
+	 */
+	unsigned savedTransmissionDelays(void) const { return savedDelays_; }
+
+	/**
+	 * \brief Durch Umsortieren der Warteschlange eingesparte Buszeit.
+	 * \param[in] baudRate Baudrate des Busses.
+	 * \return Anzahl der eingesparten Paket-Delays mal 1,5 Frames.
+	 */
+	SystemTime savedDelayTime(unsigned baudRate) const {
+		return SystemTime::fromUsec(static_cast<unsigned>(savedDelays_ * 15000000ULL / baudRate));
+	}
+
+	/**
+	 * \brief Arbeitet die Warteschlange des Busses ab.
+	 * \param[in] timeout Maximale Zeit, die auf eine eingereihte
+	 * Übertragung gewartet wird.
+	 * \return True, wenn mindestens eine Übertragung ausgeführt wurde.
+	 *
+	 * Diese Funktion sollte wiederholt von genau einem Thread aufgerufen
+	 * werden, der damit zum Besitzer des Busses wird. Die eingereihten
+	 * Übertragungen werden direkt nacheinander ausgeführt, bis die
+	 * Warteschlange leer ist. Jede Übertragung konkurriert dabei mit ihrer
+	 * Priorität um den Bus mit blockierenden Aufrufen von
+	 * transceive() aus anderen Threads.
+	 */
+	bool processQueue(SystemTime timeout = SystemTime::infinite());
 
     /**
      * \brief Leert den Eingangspuffer der benutzten Hardwareschnittstelle.
@@ -129,6 +439,55 @@ public:
 	 */
 	const Debug::ErrorObserver& busTransmissionStatistics(void) const { return busTransmissionStatistics_; }
 
+	/**
+	 * @brief Anzahl der Übertragungen, die wegen einer abgelaufenen Deadline
+	 * verworfen wurden.
+	 */
+	unsigned deadlineMisses(void) const { return deadlineMisses_; }
+
+	/**
+	 * @brief Hängt einen FlightRecorder an den Bus.
+	 * @param recorder FlightRecorder, der alle folgenden Übertragungen aufzeichnet,
+	 * oder nullptr, um die Aufzeichnung zu beenden.
+	 */
+	void setFlightRecorder(FlightRecorder* recorder) { flightRecorder_ = recorder; }
+
+	/**
+	 * @brief Hängt einen BusMeter an den Bus.
+	 * @param meter BusMeter, der Auslastung und Durchsatz aller folgenden
+	 * Übertragungen misst, oder nullptr, um die Messung zu beenden.
+	 */
+	void setBusMeter(BusMeter* meter) { busMeter_ = meter; }
+
+	/**
+	 * @brief Ändert die Baudrate der Schnittstelle.
+	 * @param baudRate Neue Baudrate.
+	 * @return False, wenn der Treiber die Baudrate nicht unterstützt oder nicht
+	 * zur Laufzeit wechseln kann.
+	 *
+	 * Wartet, bis der Bus frei ist, sodass keine Übertragung unterbrochen wird.
+	 * Ein angehängter BusMeter rechnet anschließend mit der neuen Baudrate.
+	 * Die Geräte am Bus werden dabei nicht umgestellt, dafür gibt es BaudRateNegotiator.
+	 */
+	bool setBaudRate(unsigned baudRate);
+
+	/// Aktuelle Baudrate der Schnittstelle oder 0, falls der Treiber sie nicht kennt.
+	virtual unsigned baudRate(void) const { return 0; }
+
+	/**
+	 * @brief Histogramm der Dauer aller Pakete auf dem Bus.
+	 *
+	 * Erfasst wird die Dauer jeder einzelnen Übertragung inklusive Paket-Delay,
+	 * aber ohne das Warten auf den Bus. Die Übertragungsdauer einzelner Geräte
+	 * inklusive Wiederholungen liefert BaseDevice::latencyHistogram().
+	 */
+	const Debug::LatencyHistogram& latencyHistogram(void) const { return busLatencyHistogram_; }
+
+	/**
+	 * @brief Setzt das Histogramm der Paketdauer zurück.
+	 */
+	void resetLatencyHistogram(void) { busLatencyHistogram_.reset(); }
+
 
 protected:
 	// should be private, but is protected to get it in the docs.
@@ -157,16 +516,121 @@ protected:
 	 */
 	virtual bool doTransceive(const uint8_t *transmit, int *transmit_length, uint8_t *receive, int *receive_length, bool delayTransmission) = 0;
 
+	/**
+	 * \brief Maximale Wartezeit auf die Antwort der laufenden Übertragung.
+	 * \param[in] defaultTimeout Standardwert der Subklasse.
+	 * \return Vom Aufrufer von transceive() gewünschter Timeout oder \a defaultTimeout,
+	 * falls keiner angegeben wurde.
+	 *
+	 * Subklassen sollten diese Funktion in doTransceive() benutzen, damit Geräte
+	 * ihren Timeout an ihr tatsächliches Antwortverhalten anpassen können
+	 * (siehe BaseDevice::setAdaptiveTimeout()).
+	 */
+	SystemTime responseTimeout(SystemTime defaultTimeout) const {
+		return responseTimeout_ == SystemTime::infinite() ? defaultTimeout : responseTimeout_;
+	}
+
+	/**
+	 * \brief Checksummentyp der laufenden Übertragung.
+	 *
+	 * Wie transmissionPriority() und transmissionDeadline() nur in doTransceive()
+	 * gültig. Subklassen, die Pakete an andere Busse weiterreichen (z.B.
+	 * FeldbusRouter), übergeben damit die Vorgaben des Aufrufers.
+	 */
+	ChecksumType transmissionChecksumType(void) const { return receiveChecksum_.type(); }
+
+	/// Priorität der laufenden Übertragung.
+	TransmissionPriority transmissionPriority(void) const { return priority_; }
+
+	/// Absolute Deadline der laufenden Übertragung.
+	SystemTime transmissionDeadline(void) const { return deadline_; }
+
+	/**
+	 * \brief Rechnet empfangene Bytes in die Checksumme der laufenden Übertragung ein.
+	 * \param[in] data Empfangene Bytes.
+	 * \param[in] length Anzahl der Bytes.
+	 *
+	 * Subklassen sollten diese Funktion in doTransceive() für jedes Stück der Antwort
+	 * aufrufen, sobald es empfangen wurde, und zwar jedes Byte genau einmal und in
+	 * der richtigen Reihenfolge. Die Prüfung der Checksumme nach der Übertragung ist
+	 * dann nur noch ein Vergleich, sodass der Bus kürzer belegt bleibt. Wurde die
+	 * Antwort nicht vollständig eingerechnet, wird die Checksumme wie bisher über
+	 * den Empfangspuffer berechnet.
+	 */
+	void accumulateReceived(const uint8_t* data, int length) {
+		receiveChecksum_.update(data, length);
+	}
+
+	/**
+	 * \brief Gibt den Bus zurück, der Übertragungen an die angegebene Adresse ausführt.
+	 * \param[in] targetAddress Zieladresse der Übertragung.
+	 * \return Bus, an den transceive() und submit() die Übertragung weiterreichen,
+	 * oder this, wenn dieser Bus sie selbst ausführt.
+	 *
+	 * Wird von FeldbusRouter überschrieben, um Übertragungen ohne eigene
+	 * Sperre direkt an das Bussegment des Gerätes weiterzugeben.
+	 */
+	virtual FeldbusAbstraction* route(unsigned targetAddress) {
+		(void)targetAddress;
+		return this;
+	}
+
+	/**
+	 * \brief Stellt die Baudrate der Schnittstelle um.
+	 * \param[in] baudRate Neue Baudrate.
+	 * \return False, wenn die Baudrate nicht unterstützt wird.
+	 *
+	 * Wird von setBaudRate() mit belegtem Bus aufgerufen. Die Standardimplementierung
+	 * unterstützt keinen Wechsel der Baudrate.
+	 */
+	virtual bool doSetBaudRate(unsigned baudRate) {
+		(void)baudRate;
+		return false;
+	}
+
 private:
+	ResultStatus doTransaction(const uint8_t *transmit, int *transmit_length, uint8_t *receive, int *receive_length, unsigned targetAddress, ChecksumType checksumType, SystemTime* duration);
+
+	bool acquireBus(TransmissionPriority priority, SystemTime deadline);
+	void releaseBus(void);
+
+	Transaction* popQueue(void);
+
+	static constexpr unsigned numberOfPriorities = 3;
+
 	const char* name_;
 
 	Debug::ErrorObserver busTransmissionStatistics_;
+	Debug::LatencyHistogram busLatencyHistogram_;
+	std::atomic<unsigned> deadlineMisses_;
 
-	TURAG::Semaphore sem_;
+	// Bus arbitration: every waiting thread blocks on the semaphore of
+	// its priority class, the bus is handed over directly on release.
+	Mutex arbitrationMutex_;
+	bool busBusy_;
+	unsigned busWaiters_[numberOfPriorities];
+	Semaphore busGrant_[numberOfPriorities];
 
-	unsigned lastTargetAddress_;
+	// read by popQueue() without owning the bus
+	std::atomic<unsigned> lastTargetAddress_;
+	SystemTime responseTimeout_;
+	TransmissionPriority priority_;
+	SystemTime deadline_;
+	ChecksumAccumulator receiveChecksum_;
 
 	bool threadSafe_;
+
+	Mutex queueMutex_;
+	Transaction* queueHead_[numberOfPriorities];
+	Transaction* queueTail_[numberOfPriorities];
+	// how often the head of each queue was overtaken
+	unsigned queueOvertaken_[numberOfPriorities];
+	Semaphore queueSignal_;
+	std::atomic<unsigned> reorderLimit_;
+	std::atomic<unsigned> savedDelays_;
+
+	std::atomic<FlightRecorder*> flightRecorder_;
+	std::atomic<BusMeter*> busMeter_;
 };
 
 
@@ -19,9 +19,11 @@
 
 
 #include "legacystellantriebedevice.h"
+#include "feldbus_metadatacache.h"
 
 #include <tina/debug/print.h>
 
+#include <algorithm>
 #include <cstring>
 
 
@@ -78,6 +80,22 @@ struct AktorGetStructuredOutputControl {
     uint8_t cmd;
 } TURAG_PACKED;
 
+// Layout of the metadata in the MetadataCache. The header is followed
+// by the properties of the first count keys.
+struct AktorCachedCommandSet {
+    uint8_t commandSetSize;
+    uint8_t count;
+} TURAG_PACKED;
+
+struct AktorCachedCommand {
+    LegacyStellantriebeDevice::Command_t::WriteAccess writeAccess;
+    LegacyStellantriebeDevice::Command_t::CommandLength length;
+    float factor;
+} TURAG_PACKED;
+
+constexpr unsigned aktorMaxCachedCommands =
+        (TURAG_FELDBUS_METADATACACHE_MAX_DATA - sizeof(AktorCachedCommandSet)) / sizeof(AktorCachedCommand);
+
 unsigned int LegacyStellantriebeDevice::getCommandsetLength(void) {
     if (commandSetPopulated) {
         return commandSetLength;
@@ -111,6 +129,31 @@ bool LegacyStellantriebeDevice::populateCommandSet(Command_t* commandSet_, unsig
         commandSetLength = deviceCommandSetLength;
     }
     commandSet = commandSet_;
+
+    // The properties can be taken from the metadata cache if the device is known.
+    // The fingerprint of the cache does not cover the command set, so its size,
+    // which was queried anyway, is compared as well.
+    uint8_t cache[TURAG_FELDBUS_METADATACACHE_MAX_DATA];
+    const int cachedLength = loadCachedMetadata(cache, sizeof(cache));
+    if (cachedLength >= static_cast<int>(sizeof(AktorCachedCommandSet))) {
+        AktorCachedCommandSet header;
+        memcpy(&header, cache, sizeof(header));
+        if (header.commandSetSize == deviceCommandSetLength && header.count >= commandSetLength &&
+                cachedLength == static_cast<int>(sizeof(header) + header.count * sizeof(AktorCachedCommand))) {
+            const uint8_t* data = cache + sizeof(header);
+            for (unsigned int i = 0; i < commandSetLength; ++i) {
+                AktorCachedCommand cached;
+                memcpy(&cached, data, sizeof(cached));
+                data += sizeof(cached);
+                commandSet[i].writeAccess = cached.writeAccess;
+                commandSet[i].length = cached.length;
+                commandSet[i].factor = cached.factor;
+            }
+            commandSetPopulated = true;
+            return true;
+        }
+    }
+    const unsigned int cacheCount = std::min(commandSetLength, aktorMaxCachedCommands);
     
     Request<AktorGetCommandInfo> request;
     request.data.key = TURAG_FELDBUS_STELLANTRIEBE_COMMAND_INFO_GET;
@@ -148,8 +191,22 @@ bool LegacyStellantriebeDevice::populateCommandSet(Command_t* commandSet_, unsig
         commandSet[i].writeAccess = access_mode;
         commandSet[i].length = data_type;
         commandSet[i].factor = response.data.factor;
+
+        if (i < cacheCount) {
+            AktorCachedCommand cached;
+            cached.writeAccess = access_mode;
+            cached.length = data_type;
+            cached.factor = response.data.factor;
+            memcpy(cache + sizeof(AktorCachedCommandSet) + i * sizeof(cached), &cached, sizeof(cached));
+        }
     }
     commandSetPopulated = true;
+
+    AktorCachedCommandSet header;
+    header.commandSetSize = static_cast<uint8_t>(deviceCommandSetLength);
+    header.count = static_cast<uint8_t>(cacheCount);
+    memcpy(cache, &header, sizeof(header));
+    storeCachedMetadata(cache, sizeof(header) + cacheCount * sizeof(AktorCachedCommand));
     return true;
 }
 
@@ -182,7 +239,7 @@ bool LegacyStellantriebeDevice::getValue(uint8_t key, float* value) {
         switch (command->length) {
         case Command_t::CommandLength::length_char: {
             Response<int8_t> response;
-            if (!transceive(request, &response)) {
+            if (!coalescedTransceive(request, &response)) {
                 return false;
             }
             command->buffer.floatValue = static_cast<float>(response.data) * command->factor;
@@ -190,7 +247,7 @@ bool LegacyStellantriebeDevice::getValue(uint8_t key, float* value) {
         }
         case Command_t::CommandLength::length_short: {
             Response<AktorGetShort> response;
-            if (!transceive(request, &response)) {
+            if (!coalescedTransceive(request, &response)) {
                 return false;
             }
             command->buffer.floatValue = static_cast<float>(response.data.value) * command->factor;
@@ -198,7 +255,7 @@ bool LegacyStellantriebeDevice::getValue(uint8_t key, float* value) {
         }
         case Command_t::CommandLength::length_long: {
             Response<AktorGetLong> response;
-            if (!transceive(request, &response)) {
+            if (!coalescedTransceive(request, &response)) {
                 return false;
             }
             command->buffer.floatValue = static_cast<float>(response.data.value) * command->factor;
@@ -206,7 +263,7 @@ bool LegacyStellantriebeDevice::getValue(uint8_t key, float* value) {
         }
         default: {
             Response<AktorGetFloat> response;
-            if (!transceive(request, &response)) {
+            if (!coalescedTransceive(request, &response)) {
                 return false;
             }
             if (command->factor != TURAG_FELDBUS_STELLANTRIEBE_COMMAND_FACTOR_CONTROL_VALUE) {
@@ -257,7 +314,7 @@ bool LegacyStellantriebeDevice::getValue(uint8_t key, int32_t* value) {
         switch (command->length) {
         case Command_t::CommandLength::length_char: {
             Response<int8_t> response;
-            if (!transceive(request, &response)) {
+            if (!coalescedTransceive(request, &response)) {
                 return false;
             }
             command->buffer.intValue = response.data;
@@ -265,7 +322,7 @@ bool LegacyStellantriebeDevice::getValue(uint8_t key, int32_t* value) {
         }
         case Command_t::CommandLength::length_short: {
             Response<AktorGetShort> response;
-            if (!transceive(request, &response)) {
+            if (!coalescedTransceive(request, &response)) {
                 return false;
             }
             command->buffer.intValue = response.data.value;
@@ -273,7 +330,7 @@ bool LegacyStellantriebeDevice::getValue(uint8_t key, int32_t* value) {
         }
         case Command_t::CommandLength::length_long: {
             Response<AktorGetLong> response;
-            if (!transceive(request, &response)) {
+            if (!coalescedTransceive(request, &response)) {
                 return false;
             }
             command->buffer.intValue = response.data.value;
@@ -281,7 +338,7 @@ bool LegacyStellantriebeDevice::getValue(uint8_t key, int32_t* value) {
         }
         case Command_t::CommandLength::length_float: {
             Response<AktorGetFloat> response;
-            if (!transceive(request, &response)) {
+            if (!coalescedTransceive(request, &response)) {
                 return false;
             }
             command->buffer.intValue = response.data.value;
@@ -543,38 +600,84 @@ int LegacyStellantriebeDevice::getStructuredOutputTableLength(void) {
 }
 
 
-bool LegacyStellantriebeDevice::setStructuredOutputTable(const std::vector<uint8_t>& keys) {
-	if (static_cast<int>(keys.size()) > getStructuredOutputTableLength()) {
+namespace {
+
+// The values are packed, so they have to be copied out.
+template<typename T>
+float decodeStructuredValue(const uint8_t* data, float factor) {
+    T value;
+    memcpy(&value, data, sizeof(value));
+    return static_cast<float>(value) * factor;
+}
+
+} // namespace
+
+bool LegacyStellantriebeDevice::setStructuredOutputTable(const uint8_t* keys, unsigned count) {
+	if (static_cast<int>(count) > getStructuredOutputTableLength()) {
 		turag_errorf("%s: output table in device too small for number of provided keys", name());
         return false;
     }
+    if (count > TURAG_FELDBUS_AKTOR_STRUCTURED_OUTPUT_MAX_KEYS) {
+		turag_errorf("%s: more than %u structured output keys", name(), TURAG_FELDBUS_AKTOR_STRUCTURED_OUTPUT_MAX_KEYS);
+        return false;
+    }
     if (!commandSetPopulated) {
 		turag_errorf("%s: commandSet not populated", name());
         return false;
     }
     
-    for (unsigned int i = 0; i < keys.size(); ++i) {
-        if (keys[i] > getCommandsetLength() || commandSet[keys[i] - 1].length == Command_t::CommandLength::none) {
+    // Everything getStructuredOutput() needs to know about a value is
+    // worked out here once instead of on every call.
+    ArrayBuffer<StructuredOutputField, TURAG_FELDBUS_AKTOR_STRUCTURED_OUTPUT_MAX_KEYS> plan;
+    unsigned offset = 0;
+    for (unsigned int i = 0; i < count; ++i) {
+        if (keys[i] == 0 || keys[i] > getCommandsetLength()) {
+			turag_errorf("%s: requested keys invalid", name());
+            return false;
+        }
+        const Command_t& command = commandSet[keys[i] - 1];
+
+        StructuredOutputField field;
+        field.key = keys[i];
+        field.offset = static_cast<uint16_t>(offset);
+        field.factor = command.factor == TURAG_FELDBUS_STELLANTRIEBE_COMMAND_FACTOR_CONTROL_VALUE ? 1.0f : command.factor;
+        switch (command.length) {
+        case Command_t::CommandLength::length_char:
+            field.decode = &decodeStructuredValue<int8_t>;
+            offset += 1;
+            break;
+        case Command_t::CommandLength::length_short:
+            field.decode = &decodeStructuredValue<int16_t>;
+            offset += 2;
+            break;
+        case Command_t::CommandLength::length_long:
+            field.decode = &decodeStructuredValue<int32_t>;
+            offset += 4;
+            break;
+        case Command_t::CommandLength::length_float:
+            field.decode = &decodeStructuredValue<float>;
+            offset += 4;
+            break;
+        default:
 			turag_errorf("%s: requested keys invalid", name());
             return false;
         }
+        plan.push_back(field);
     }
     
-    uint8_t request[keys.size() + myAddressLength + 3];
-
-    request[myAddressLength + 0] = TURAG_FELDBUS_STELLANTRIEBE_STRUCTURED_OUTPUT_CONTROL;
-    request[myAddressLength + 1] = TURAG_FELDBUS_STELLANTRIEBE_STRUCTURED_OUTPUT_SET_STRUCTURE;
-    memcpy(request + myAddressLength + 2, keys.data(), keys.size());
+    // key, command and the table as variable length part
+    typedef PacketLayout<uint8_t, uint8_t> SetStructureRequest;
+    Packet<SetStructureRequest, TURAG_FELDBUS_AKTOR_STRUCTURED_OUTPUT_MAX_KEYS> request;
+    request.set<0>(TURAG_FELDBUS_STELLANTRIEBE_STRUCTURED_OUTPUT_CONTROL);
+    request.set<1>(TURAG_FELDBUS_STELLANTRIEBE_STRUCTURED_OUTPUT_SET_STRUCTURE);
+    memcpy(request.tail(), keys, count);
     
-    uint8_t response[myAddressLength + 1 + 1];
+    Packet<PacketLayout<uint8_t>> response;
     
-    if (transceive(
-			request, 
-			sizeof(request),
-            response,
-			sizeof(response))) {
-        if (response[myAddressLength] == TURAG_FELDBUS_STELLANTRIEBE_STRUCTURED_OUTPUT_TABLE_OK) {
-            structuredOutputTable = keys;
+    if (transceive(request, response, count)) {
+        if (response.get<0>() == TURAG_FELDBUS_STELLANTRIEBE_STRUCTURED_OUTPUT_TABLE_OK) {
+            structuredOutputPlan = plan;
+            structuredOutputDataSize = offset;
             return true;
         }
     }
@@ -584,86 +687,44 @@ bool LegacyStellantriebeDevice::setStructuredOutputTable(const std::vector<uint8
 
 
 bool LegacyStellantriebeDevice::getStructuredOutput(std::vector<StructuredDataPair_t>* values) {
-    if (structuredOutputTable.size() == 0) {
-		turag_errorf("%s: structured output mapping empty", name());
+    float decoded[TURAG_FELDBUS_AKTOR_STRUCTURED_OUTPUT_MAX_KEYS];
+    if (!values || !getStructuredOutput(decoded, TURAG_FELDBUS_AKTOR_STRUCTURED_OUTPUT_MAX_KEYS)) {
         return false;
     }
-    if (!commandSetPopulated) {
-		turag_errorf("%s: commandSet not populated", name());
+
+    values->reserve(values->size() + structuredOutputPlan.size());
+    for (unsigned int i = 0; i < structuredOutputPlan.size(); ++i) {
+        values->push_back(StructuredDataPair_t(structuredOutputPlan[i].key, decoded[i]));
+    }
+    return true;
+}
+
+
+bool LegacyStellantriebeDevice::getStructuredOutput(float* values, unsigned count) {
+    if (structuredOutputPlan.size() == 0) {
+		turag_errorf("%s: structured output mapping empty", name());
         return false;
     }
-    
-	unsigned data_size = 0;
-    for (unsigned int i = 0; i < structuredOutputTable.size(); ++i) {
-        switch (commandSet[structuredOutputTable[i] - 1].length) {
-        case Command_t::CommandLength::length_char:
-            data_size += 1;
-            break;
-        case Command_t::CommandLength::length_short:
-            data_size += 2;
-            break;
-        case Command_t::CommandLength::length_long:
-            data_size += 4;
-            break;
-        case Command_t::CommandLength::length_float:
-            data_size += 4;
-            break;
-        default:
-            return false;
-        }
+    if (!values || count < structuredOutputPlan.size()) {
+		turag_errorf("%s: structured output buffer too small", name());
+        return false;
     }
 
-    uint8_t request[myAddressLength + 1 + 1];
-    request[myAddressLength] = TURAG_FELDBUS_STELLANTRIEBE_STRUCTURED_OUTPUT_GET;
-
-    uint8_t* response = new uint8_t[myAddressLength + data_size + 1];
-
-    if (transceive(request,
-                   sizeof(request),
-                   response,
-                   myAddressLength + data_size + 1)) {
-        uint8_t* pValue = response + myAddressLength;
-
-        for (unsigned int i = 0; i < structuredOutputTable.size(); ++i) {
-            int32_t device_value;
-
-            switch (commandSet[structuredOutputTable[i] - 1].length) {
-            case Command_t::CommandLength::length_char:
-                device_value = *(reinterpret_cast<int8_t*>(pValue));
-                pValue += 1;
-                break;
-            case Command_t::CommandLength::length_short:
-                device_value = *(reinterpret_cast<int16_t*>(pValue));
-                pValue += 2;
-                break;
-            case Command_t::CommandLength::length_long:
-                device_value = *(reinterpret_cast<int32_t *>(pValue));
-                pValue += 4;
-                break;
-            case Command_t::CommandLength::length_float:
-                device_value = *(reinterpret_cast<float *>(pValue));
-                pValue += 4;
-                break;
-            default:
-                return false;
-            }
+    Packet<PacketLayout<uint8_t>> request;
+    request.set<0>(TURAG_FELDBUS_STELLANTRIEBE_STRUCTURED_OUTPUT_GET);
 
-            StructuredDataPair_t pair;
-            pair.key = structuredOutputTable[i];
+    // the response consists of the values only
+    Packet<PacketLayout<>, TURAG_FELDBUS_AKTOR_STRUCTURED_OUTPUT_MAX_KEYS * 4> response;
 
-            if (commandSet[structuredOutputTable[i] - 1].factor == TURAG_FELDBUS_STELLANTRIEBE_COMMAND_FACTOR_CONTROL_VALUE) {
-                pair.value = static_cast<float>(device_value);
-            } else {
-                pair.value = static_cast<float>(device_value) * commandSet[structuredOutputTable[i] - 1].factor;
-            }
-            values->push_back(pair);
-        }
-        delete[] response;
-        return true;
+    if (!transceive(request, response, 0, structuredOutputDataSize)) {
+        return false;
     }
 
-    delete[] response;
-    return false;
+    const uint8_t* data = response.tail();
+    for (const StructuredOutputField& field : structuredOutputPlan) {
+        *values++ = field.decode(data + field.offset, field.factor);
+    }
+    return true;
 }
 
 #endif // TURAG_FELDBUS_AKTOR_STRUCTURED_OUTPUT_AVAILABLE
@@ -16,9 +16,24 @@
 #include <tina/tina.h>
 
 #if TURAG_FELDBUS_AKTOR_STRUCTURED_OUTPUT_AVAILABLE || defined(__DOXYGEN__)
+# include <tina++/container/array_buffer.h>
 # include <vector>
 #endif
 
+
+#if TURAG_FELDBUS_AKTOR_STRUCTURED_OUTPUT_AVAILABLE || defined(__DOXYGEN__)
+/// \addtogroup feldbus-host
+/// \{
+
+/// Maximale Anzahl an Werten in der Tabelle für die zusammenhängende Datenausgabe
+/// eines LegacyStellantriebeDevice.
+#if !defined(TURAG_FELDBUS_AKTOR_STRUCTURED_OUTPUT_MAX_KEYS) || defined(__DOXYGEN__)
+# define TURAG_FELDBUS_AKTOR_STRUCTURED_OUTPUT_MAX_KEYS		32
+#endif
+
+/// \}
+#endif
+
 namespace TURAG {
 	
 
@@ -111,7 +126,7 @@ public:
 	 */
     LegacyStellantriebeDevice(const char* name, unsigned address, FeldbusAbstraction& feldbus, ChecksumType type = TURAG_FELDBUS_DEVICE_CONFIG_STANDARD_CHECKSUM_TYPE) :
                 Device(name, address, feldbus, type), commandSet(nullptr), commandSetLength(0), commandSetPopulated(false),
-                structuredOutputTableLength(-1)  { }
+                structuredOutputTableLength(-1), structuredOutputDataSize(0)  { }
 #else
 	LegacyStellantriebeDevice(const char* name, unsigned address, FeldbusAbstraction& feldbus, ChecksumType type = TURAG_FELDBUS_DEVICE_CONFIG_STANDARD_CHECKSUM_TYPE,
 		const AddressLength addressLength = TURAG_FELDBUS_DEVICE_CONFIG_STANDARD_ADDRESS_LENGTH) :
@@ -183,6 +198,10 @@ public:
 	 *
 	 * Der Aufrufer hat dafür zu sorgen, dass in commandSet_ genügend Platz für die in
 	 * commandSetLength_ angegebene Anzahl von Elementen ist.
+	 *
+	 * Ist mit Device::setMetadataCache() ein MetadataCache gesetzt, wird die Tabelle
+	 * dort abgelegt. Bei einem Treffer wird nur noch die Größe des Befehlssatzes
+	 * abgefragt und mit der im Cache verglichen.
 	 */
     bool populateCommandSet(Command_t* commandSet_, unsigned int commandSetLength_);
 	
@@ -226,16 +245,51 @@ public:
 	 * \return True bei Erfolg, ansonsten false.
 	 * \pre populateCommandSet() muss ausgeführt worden sein.
 	 */
-    bool setStructuredOutputTable(const std::vector<uint8_t>& keys);
+    bool setStructuredOutputTable(const std::vector<uint8_t>& keys) {
+        return setStructuredOutputTable(keys.data(), keys.size());
+    }
+
+	/**
+	 * \brief Überträgt eine Tabelle für die zusammenhängende Datenausgabe.
+	 * \param[in] keys Keys aller gewünschten Gerätewerte.
+	 * \param[in] count Anzahl der Keys, höchstens \ref TURAG_FELDBUS_AKTOR_STRUCTURED_OUTPUT_MAX_KEYS.
+	 * \return True bei Erfolg, ansonsten false.
+	 * \pre populateCommandSet() muss ausgeführt worden sein.
+	 *
+	 * Dabei wird einmalig berechnet, an welcher Stelle der Antwort jeder Wert
+	 * steht, wie er dekodiert wird und mit welchem Faktor er umgerechnet wird,
+	 * sodass getStructuredOutput() nur noch die Antwort abarbeiten muss.
+	 */
+    bool setStructuredOutputTable(const uint8_t* keys, unsigned count);
 	
 	/**
 	 * \brief Fordert die Ausgabe der zusammenhängenden Daten an.
-	 * \param[out] values Puffer, in den die Daten geschrieben werden.
+	 * \param[out] values Vektor, an den die Daten angehängt werden.
 	 * \return True bei Erfolg, anonsten false.
 	 * \pre populateCommandSet() muss ausgeführt worden sein.
 	 * \pre setStructuredOutputTable() muss ausgeführt worden sein.
+	 *
+	 * Für zyklische Abfragen sollte getStructuredOutput(float*, unsigned)
+	 * verwendet werden, das ohne Heap-Speicher auskommt.
 	 */
     bool getStructuredOutput(std::vector<StructuredDataPair_t>* values);
+
+	/**
+	 * \brief Fordert die Ausgabe der zusammenhängenden Daten an.
+	 * \param[out] values Puffer, in den die Werte in der Reihenfolge der Tabelle
+	 * geschrieben werden.
+	 * \param[in] count Größe des Puffers, mindestens structuredOutputSize().
+	 * \return True bei Erfolg, anonsten false.
+	 * \pre setStructuredOutputTable() muss ausgeführt worden sein.
+	 *
+	 * Physikalische Werte werden mit ihrem Faktor umgerechnet, Kontrollwerte
+	 * unverändert übernommen. Ein Struct, das nur aus float-Werten in der
+	 * Reihenfolge der Tabelle besteht, kann direkt als Puffer dienen.
+	 */
+    bool getStructuredOutput(float* values, unsigned count);
+
+	/// Anzahl der Werte in der Tabelle für die zusammenhängende Datenausgabe.
+    unsigned structuredOutputSize(void) const { return structuredOutputPlan.size(); }
 #endif
 
 protected:
@@ -244,8 +298,20 @@ protected:
     bool commandSetPopulated;
 
 #if TURAG_FELDBUS_AKTOR_STRUCTURED_OUTPUT_AVAILABLE || defined(__DOXYGEN__)
+    /// Eintrag des Dekodierplans für die zusammenhängende Datenausgabe.
+    struct StructuredOutputField {
+        /// Funktion, die den Wert aus der Antwort liest und umrechnet.
+        float (*decode)(const uint8_t* data, float factor);
+        /// Faktor, bei Kontrollwerten 1.
+        float factor;
+        /// Position des Werts in den Nutzdaten der Antwort.
+        uint16_t offset;
+        uint8_t key;
+    };
+
     int structuredOutputTableLength;
-    std::vector<uint8_t> structuredOutputTable;
+    ArrayBuffer<StructuredOutputField, TURAG_FELDBUS_AKTOR_STRUCTURED_OUTPUT_MAX_KEYS> structuredOutputPlan;
+    unsigned structuredOutputDataSize;
 #endif    
 
     
@@ -3,8 +3,16 @@
  * See TURAG_FELDBUS_STELLANTRIEBE_COMMAND_FACTOR_CONTROL_VALUE */
 #pragma GCC diagnostic ignored "-Wfloat-equal"
 
+#define TURAG_DEBUG_LOG_SOURCE "B"
+
+#include <tina++/tina.h>
+
+#if TURAG_USE_TURAG_FELDBUS_HOST
+
 #include <tina++/debug.h>
+#include <tina++/crc/fnv.h>
 #include "stellantriebedevice.h"
+#include "feldbus_metadatacache.h"
 
 namespace TURAG {
 namespace Feldbus {
@@ -17,8 +25,30 @@ struct GetCommandInfo {
 } TURAG_PACKED;
 
 struct GetCommandInfoResponse {
-    LegacyStellantriebeDevice::Command_t::WriteAccess writeAccess;
-    LegacyStellantriebeDevice::Command_t::CommandLength length;
+    StellantriebeDevice::WriteAccess writeAccess;
+    StellantriebeDevice::CommandLength length;
+    float factor;
+} TURAG_PACKED;
+
+struct StructuredOutputControl {
+    uint8_t key;
+    uint8_t cmd;
+} TURAG_PACKED;
+
+//Layout of the metadata in the MetadataCache. The header is followed
+//by a CachedCommand for each command of the device class in list order.
+struct CachedCommandSet {
+    uint8_t commandSetSize;
+    //another device class may use the same device with other commands
+    uint32_t namesHash;
+    uint8_t multiAccess;
+    uint8_t structuredOutputSize;
+} TURAG_PACKED;
+
+struct CachedCommand {
+    uint8_t key;
+    StellantriebeDevice::WriteAccess access;
+    StellantriebeDevice::CommandLength length;
     float factor;
 } TURAG_PACKED;
 
@@ -38,20 +68,27 @@ bool StellantriebeDevice::init() {
 
     turag_debugf("%s: Command set size is: %u.", name(), command_set_size.data);
 
+    if(initFromCache(command_set_size.data))
+        return true;
+
+    //keys and properties of all commands for the metadata cache
+    uint8_t cache[TURAG_FELDBUS_METADATACACHE_MAX_DATA];
+    unsigned cache_length = sizeof(CachedCommandSet);
+
     Request<GetCommandInfo> name_length_req;
     Response<uint8_t> name_length_resp;
     name_length_req.data.cmd0 = TURAG_FELDBUS_STELLANTRIEBE_COMMAND_INFO_GET_NAME_LENGTH;
     name_length_req.data.cmd1 = TURAG_FELDBUS_STELLANTRIEBE_COMMAND_INFO_GET_NAME_LENGTH;
     name_length_req.data.cmd2 = TURAG_FELDBUS_STELLANTRIEBE_COMMAND_INFO_GET_NAME_LENGTH;
 
-    const int name_req_len = addressLength() + 4 + 1;
+    const int name_req_len = myAddressLength + 4 + 1;
     uint8_t name_req[2 + 4 + 1];
     name_req[2] = TURAG_FELDBUS_STELLANTRIEBE_COMMAND_INFO_GET_NAME;
     name_req[3] = TURAG_FELDBUS_STELLANTRIEBE_COMMAND_INFO_GET_NAME;
     name_req[4] = TURAG_FELDBUS_STELLANTRIEBE_COMMAND_INFO_GET_NAME;
     //buffer for fieldbus package containing command name
     char name_resp[255+2+1];
-    memset(name_resp, 0, 255+addressLength()+1);
+    memset(name_resp, 0, 255+myAddressLength+1);
 
     Request<GetCommandInfo> cmd_info_req;
     cmd_info_req.data.cmd0 = TURAG_FELDBUS_STELLANTRIEBE_COMMAND_INFO_GET;
@@ -62,6 +99,8 @@ bool StellantriebeDevice::init() {
     //try to find all commands in the command set
     bool all_successful = true;
     for(CommandBase* cmd = first_command_; cmd != nullptr; cmd = cmd->next()) {
+        //only bindCommand() assigns keys, so commands not found stay uninitialized
+        cmd->setKey(0);
         bool found = false;
         //valid keys start at 1
         for(uint8_t i = 1; i <= command_set_size.data; i++) {
@@ -82,17 +121,17 @@ bool StellantriebeDevice::init() {
 
             //query command name
             if(!transceive(name_req, name_req_len,
-                           reinterpret_cast<uint8_t*>(name_resp), name_length_resp.data + addressLength() + 1)) {
+                           reinterpret_cast<uint8_t*>(name_resp), name_length_resp.data + myAddressLength + 1)) {
                 turag_errorf("%s: Failed to query name of key %u.", name(), i);
                 all_successful = false;
                 continue;
             }
 
-            //add null-termination and check name (it is offset by addressLength())
-            name_resp[addressLength() + name_length_resp.data] = 0;
-            if(strcmp(&name_resp[addressLength()], cmd->name())) {
+            //add null-termination and check name (it is offset by myAddressLength)
+            name_resp[myAddressLength + name_length_resp.data] = 0;
+            if(strcmp(&name_resp[myAddressLength], cmd->name())) {
                 turag_debugf("%s: Name of key %u (\"%s\") does not match (looking for name \"%s\"). Skipping.",
-                             name(), i, &name_resp[addressLength()], cmd->name());
+                             name(), i, &name_resp[myAddressLength], cmd->name());
                 continue; //no match
             }
 
@@ -102,34 +141,20 @@ bool StellantriebeDevice::init() {
                 all_successful = false;
                 continue;
             }
-            //check properties
-            if(cmd_info_resp.data.length != cmd->length()) {
-                turag_errorf("%s: Command \"%s\" length mismatched, device reports %u, required %u.",
-                             name(), cmd->name(),
-                             unsigned(cmd_info_resp.data.length), unsigned(cmd->length()));
+            if(!bindCommand(cmd, i, cmd_info_resp.data.writeAccess,
+                            cmd_info_resp.data.length, cmd_info_resp.data.factor)) {
                 all_successful = false;
                 continue;
             }
-            if(cmd_info_resp.data.writeAccess != cmd->access()) {
-                turag_errorf("%s: Command \"%s\" write access mismatched, device reports %u, required %u.",
-                             name(), cmd->name(),
-                             unsigned(cmd_info_resp.data.writeAccess), unsigned(cmd->access()));
-                all_successful = false;
-                continue;
+            if(cache_length + sizeof(CachedCommand) <= sizeof(cache)) {
+                CachedCommand cached;
+                cached.key = i;
+                cached.access = cmd_info_resp.data.writeAccess;
+                cached.length = cmd_info_resp.data.length;
+                cached.factor = cmd_info_resp.data.factor;
+                memcpy(cache + cache_length, &cached, sizeof(cached));
             }
-            bool dev_ctrl = cmd_info_resp.data.factor == TURAG_FELDBUS_STELLANTRIEBE_COMMAND_FACTOR_CONTROL_VALUE;
-            bool cmd_ctrl = cmd->type() == CommandType::control;
-            if(dev_ctrl != cmd_ctrl) {
-                turag_errorf("%s: Command \"%s\" type mismatched, device reports %s, required %s.",
-                             name(), cmd->name(),
-                             dev_ctrl?"control":"real",
-                             cmd_ctrl?"control":"real");
-                all_successful = false;
-                continue;
-            }
-            //all checks for this command successful
-            cmd->setKey(i);
-            cmd->setConversionFactor(cmd_info_resp.data.factor);
+            cache_length += sizeof(CachedCommand);
             found = true;
             break;
         }
@@ -139,9 +164,183 @@ bool StellantriebeDevice::init() {
             continue;
         }
     }
+
+    //an empty multi access is answered by devices supporting it
+    Request<uint8_t[2]> multi_req;
+    multi_req.data[0] = TURAG_FELDBUS_STELLANTRIEBE_MULTI_ACCESS;
+    multi_req.data[1] = 0;
+    Response<> multi_resp;
+    multi_access_ = transceive(multi_req, &multi_resp);
+    updateMaxPayloadLength();
+    structured_output_size_ = 0;
+    structured_output_keys_.clear();
+    if(!multi_access_) {
+        Request<StructuredOutputControl> so_req;
+        so_req.data.key = TURAG_FELDBUS_STELLANTRIEBE_STRUCTURED_OUTPUT_CONTROL;
+        so_req.data.cmd = TURAG_FELDBUS_STELLANTRIEBE_STRUCTURED_OUTPUT_GET_BUFFER_SIZE;
+        Response<uint8_t> so_resp;
+        if(transceive(so_req, &so_resp))
+            structured_output_size_ = so_resp.data;
+        turag_debugf("%s: No multi access, structured output table size %u.", name(), structured_output_size_);
+    }
+
+    if(all_successful && cache_length <= sizeof(cache)) {
+        CachedCommandSet header;
+        header.commandSetSize = command_set_size.data;
+        header.namesHash = commandNamesHash();
+        header.multiAccess = multi_access_;
+        header.structuredOutputSize = static_cast<uint8_t>(structured_output_size_);
+        memcpy(cache, &header, sizeof(header));
+        storeCachedMetadata(cache, cache_length);
+    }
+    return all_successful;
+}
+
+bool StellantriebeDevice::initFromCache(uint8_t command_set_size) {
+    uint8_t cache[TURAG_FELDBUS_METADATACACHE_MAX_DATA];
+    const int length = loadCachedMetadata(cache, sizeof(cache));
+
+    unsigned count = 0;
+    for(CommandBase* cmd = first_command_; cmd != nullptr; cmd = cmd->next())
+        ++count;
+    if(length != static_cast<int>(sizeof(CachedCommandSet) + count * sizeof(CachedCommand)))
+        return false;
+
+    //The fingerprint of the cache does not cover the command set, so its
+    //size, which init() has to query anyway, is compared as well.
+    CachedCommandSet header;
+    memcpy(&header, cache, sizeof(header));
+    if(header.commandSetSize != command_set_size || header.namesHash != commandNamesHash()) {
+        turag_infof("%s: Command set changed, cached metadata discarded.", name());
+        return false;
+    }
+
+    const uint8_t* data = cache + sizeof(header);
+    for(CommandBase* cmd = first_command_; cmd != nullptr; cmd = cmd->next()) {
+        CachedCommand cached;
+        memcpy(&cached, data, sizeof(cached));
+        data += sizeof(cached);
+        cmd->setKey(0);
+        if(cached.key == 0 || cached.key > command_set_size ||
+                !bindCommand(cmd, cached.key, cached.access, cached.length, cached.factor))
+            return false;
+    }
+
+    multi_access_ = header.multiAccess;
+    updateMaxPayloadLength();
+    structured_output_size_ = multi_access_ ? 0 : header.structuredOutputSize;
+    structured_output_keys_.clear();
+    return true;
+}
+
+uint32_t StellantriebeDevice::commandNamesHash(void) const {
+    uint32_t hash = FNV1a::initialValue;
+    for(const CommandBase* cmd = first_command_; cmd != nullptr; cmd = cmd->next())
+        hash = FNV1a::update(hash, cmd->name(), strlen(cmd->name()) + 1);
+    return hash;
+}
+
+bool StellantriebeDevice::init(const CommandInfo* table, unsigned size) {
+    Request<GetCommandInfo> req;
+    req.data.key = 1;
+    req.data.cmd0 = TURAG_FELDBUS_STELLANTRIEBE_COMMAND_INFO_GET_COMMANDSET_HASH;
+    req.data.cmd1 = TURAG_FELDBUS_STELLANTRIEBE_COMMAND_INFO_GET_COMMANDSET_HASH;
+    req.data.cmd2 = TURAG_FELDBUS_STELLANTRIEBE_COMMAND_INFO_GET_COMMANDSET_HASH;
+    Response<uint32_t> hash;
+
+    if(!transceive(req, &hash)) {
+        turag_infof("%s: Device does not report a command set hash, querying command set.", name());
+        return init();
+    }
+    const uint32_t expected = commandSetHash(table, size);
+    if(hash.data != expected) {
+        turag_warningf("%s: Command set hash mismatched, device reports %08x, table has %08x. Querying command set.",
+                       name(), unsigned(hash.data), unsigned(expected));
+        return init();
+    }
+
+    bool all_successful = true;
+    for(CommandBase* cmd = first_command_; cmd != nullptr; cmd = cmd->next()) {
+        //commands declared with commandKey() already know their key
+        uint8_t key = cmd->key();
+        cmd->setKey(0);
+        if(key == 0)
+            key = findKey(table, size, cmd->name(), 0);
+        if(key == 0 || key > size || !table[key - 1].name || strcmp(table[key - 1].name, cmd->name())) {
+            turag_errorf("%s: Command \"%s\" not found in command table.", name(), cmd->name());
+            all_successful = false;
+            continue;
+        }
+        const CommandInfo& info = table[key - 1];
+        if(!bindCommand(cmd, key, info.access, info.length, info.factor))
+            all_successful = false;
+    }
+
+    //devices reporting the hash support multi access
+    multi_access_ = true;
+    updateMaxPayloadLength();
+    structured_output_size_ = 0;
+    structured_output_keys_.clear();
     return all_successful;
 }
 
+void StellantriebeDevice::updateMaxPayloadLength(void) {
+    ExtendedDeviceInfo info;
+    max_payload_length_ = 0;
+    if(!getExtendedDeviceInfo(&info)) {
+        turag_warningf("%s: Unable to query buffer size, transactions are not limited.", name());
+        return;
+    }
+    //address and checksum are part of the buffer
+    if(info.bufferSize() > myAddressLength + 1)
+        max_payload_length_ = info.bufferSize() - myAddressLength - 1;
+}
+
+uint32_t StellantriebeDevice::commandSetHash(const CommandInfo* table, unsigned size) {
+    uint32_t hash = FNV1a::initialValue;
+    for(unsigned i = 0; i < size; ++i) {
+        //same layout as the command info sent by the device
+        GetCommandInfoResponse info;
+        info.writeAccess = table[i].access;
+        info.length = table[i].length;
+        info.factor = table[i].factor; //assumes host is little-endian
+        const char* command_name = table[i].name ? table[i].name : "";
+
+        hash = FNV1a::update(hash, &info, sizeof(info));
+        hash = FNV1a::update(hash, command_name, strlen(command_name) + 1);
+    }
+    return hash;
+}
+
+bool StellantriebeDevice::bindCommand(CommandBase* cmd, uint8_t key, WriteAccess access,
+                                      CommandLength length, float factor) {
+    if(length != cmd->length()) {
+        turag_errorf("%s: Command \"%s\" length mismatched, device reports %u, required %u.",
+                     name(), cmd->name(),
+                     unsigned(length), unsigned(cmd->length()));
+        return false;
+    }
+    if(access != cmd->access()) {
+        turag_errorf("%s: Command \"%s\" write access mismatched, device reports %u, required %u.",
+                     name(), cmd->name(),
+                     unsigned(access), unsigned(cmd->access()));
+        return false;
+    }
+    bool dev_ctrl = factor == TURAG_FELDBUS_STELLANTRIEBE_COMMAND_FACTOR_CONTROL_VALUE;
+    bool cmd_ctrl = cmd->type() == CommandType::control;
+    if(dev_ctrl != cmd_ctrl) {
+        turag_errorf("%s: Command \"%s\" type mismatched, device reports %s, required %s.",
+                     name(), cmd->name(),
+                     dev_ctrl?"control":"real",
+                     cmd_ctrl?"control":"real");
+        return false;
+    }
+    //all checks for this command successful
+    cmd->setKey(key);
+    cmd->setConversionFactor(factor);
+    return true;
+}
+
 bool StellantriebeDevice::CommandBase::assertInitialized() const {
     if (key_ == 0) {
         turag_errorf("%s: Command \"%s\" is not initialized!", dev_ ? dev_->name() : "Invalid device", name_);
@@ -151,5 +350,176 @@ bool StellantriebeDevice::CommandBase::assertInitialized() const {
     }
 }
 
-} // namespace IM
+bool StellantriebeDevice::setWriteBehind(bool enabled) {
+    bool success = true;
+    if (write_behind_ && !enabled)
+        success = flush();
+    write_behind_ = enabled;
+    return success;
+}
+
+bool StellantriebeDevice::flush(void) {
+    bool success = true;
+    CommandBase* cmd = first_command_;
+    while (cmd) {
+        //dirty commands not fitting into the device buffer are sent in chunks
+        Transaction transaction(*this);
+        CommandBase* chunk_begin = cmd;
+        for (; cmd; cmd = cmd->next()) {
+            if (!cmd->dirty())
+                continue;
+            uint8_t data[4];
+            unsigned length = cmd->encodeCache(data);
+            Transaction::Write* write = transaction.addWrite(cmd, length);
+            if (!write)
+                break;
+            memcpy(write->data, data, length);
+        }
+        if (transaction.size() == 0 && cmd) {
+            //does not even fit into an empty transaction
+            turag_errorf("%s: Command \"%s\" exceeds the buffer of the device.", name(), cmd->name());
+            success = false;
+            cmd = cmd->next();
+            continue;
+        }
+        if (!transaction.execute()) {
+            success = false;
+            continue;
+        }
+        for (CommandBase* done = chunk_begin; done != cmd; done = done->next())
+            done->clearDirty();
+    }
+    return success;
+}
+
+bool StellantriebeDevice::Transaction::fits(unsigned request_length, unsigned response_length) const {
+    if (writes_.size() + reads_.size() == TURAG_FELDBUS_STELLANTRIEBE_TRANSACTION_MAX_ENTRIES)
+        return false;
+    if (dev_.max_payload_length_ == 0)
+        return true;
+    //the multi access request starts with opcode and number of writes
+    return 2 + request_length_ + request_length <= dev_.max_payload_length_ &&
+            response_length_ + response_length <= dev_.max_payload_length_;
+}
+
+StellantriebeDevice::Transaction::Write* StellantriebeDevice::Transaction::addWrite(CommandBase* command, uint8_t length) {
+    for (Write& write : writes_) {
+        if (write.command == command)
+            return &write;
+    }
+    if (!fits(1 + length, 0))
+        return nullptr;
+    Write write;
+    write.command = command;
+    write.length = length;
+    writes_.push_back(write);
+    request_length_ += 1 + length;
+    return &writes_.back();
+}
+
+bool StellantriebeDevice::Transaction::execute(void) {
+    if(writes_.empty() && reads_.empty())
+        return true;
+    if(dev_.multi_access_ ? executeMultiAccess() : executeSeparately())
+        return true;
+    //set() already updated the caches, so make sure flush() sends them again
+    for(const Write& write : writes_)
+        write.command->markDirty();
+    return false;
+}
+
+bool StellantriebeDevice::Transaction::executeMultiAccess(void) {
+    //multi access opcode, number of writes and the accesses as variable length part
+    typedef PacketLayout<uint8_t, uint8_t> MultiAccessRequest;
+    Packet<MultiAccessRequest, TURAG_FELDBUS_STELLANTRIEBE_TRANSACTION_MAX_ENTRIES * 5> request;
+    request.set<0>(TURAG_FELDBUS_STELLANTRIEBE_MULTI_ACCESS);
+    request.set<1>(static_cast<uint8_t>(writes_.size()));
+    uint8_t* out = request.tail();
+    for(const Write& write : writes_) {
+        *out++ = write.command->key();
+        memcpy(out, write.data, write.length);
+        out += write.length;
+    }
+    for(const Read& read : reads_) {
+        *out++ = read.command->key();
+    }
+
+    //the response consists of the read values only
+    Packet<PacketLayout<>, TURAG_FELDBUS_STELLANTRIEBE_TRANSACTION_MAX_ENTRIES * 4> response;
+    if(!dev_.transceive(request, response, request_length_, response_length_))
+        return false;
+    decodeReads(response.tail());
+    return true;
+}
+
+bool StellantriebeDevice::Transaction::executeSeparately(void) {
+    bool success = true;
+    for(const Write& write : writes_) {
+        Packet<PacketLayout<uint8_t>, 4> request;
+        request.set<0>(write.command->key());
+        memcpy(request.tail(), write.data, write.length);
+        Packet<PacketLayout<>> response;
+        if(!dev_.transceive(request, response, write.length))
+            success = false;
+    }
+    if(reads_.empty())
+        return success;
+
+    Packet<PacketLayout<>, TURAG_FELDBUS_STELLANTRIEBE_TRANSACTION_MAX_ENTRIES * 4> response;
+    if(reads_.size() > 1 && reads_.size() <= dev_.structured_output_size_) {
+        //the table stays in the device, so it is only sent when it changes
+        bool table_valid = dev_.structured_output_keys_.size() == reads_.size();
+        for(unsigned i = 0; table_valid && i < reads_.size(); ++i)
+            table_valid = dev_.structured_output_keys_[i] == reads_[i].command->key();
+
+        if(!table_valid) {
+            typedef PacketLayout<uint8_t, uint8_t> SetStructureRequest;
+            Packet<SetStructureRequest, TURAG_FELDBUS_STELLANTRIEBE_TRANSACTION_MAX_ENTRIES> request;
+            request.set<0>(TURAG_FELDBUS_STELLANTRIEBE_STRUCTURED_OUTPUT_CONTROL);
+            request.set<1>(TURAG_FELDBUS_STELLANTRIEBE_STRUCTURED_OUTPUT_SET_STRUCTURE);
+            for(unsigned i = 0; i < reads_.size(); ++i)
+                request.tail()[i] = reads_[i].command->key();
+            Packet<PacketLayout<uint8_t>> table_response;
+            dev_.structured_output_keys_.clear();
+            if(!dev_.transceive(request, table_response, reads_.size()) ||
+                    table_response.get<0>() != TURAG_FELDBUS_STELLANTRIEBE_STRUCTURED_OUTPUT_TABLE_OK)
+                return false;
+            for(const Read& read : reads_)
+                dev_.structured_output_keys_.push_back(read.command->key());
+        }
+
+        Packet<PacketLayout<uint8_t>> request;
+        request.set<0>(TURAG_FELDBUS_STELLANTRIEBE_STRUCTURED_OUTPUT_GET);
+        if(!dev_.transceive(request, response, 0, response_length_)) {
+            //a failed or wrongly sized response means the table in the device
+            //may be gone (e.g. after a reset), so it is sent again next time
+            dev_.structured_output_keys_.clear();
+            return false;
+        }
+        decodeReads(response.tail());
+        return success;
+    }
+
+    for(const Read& read : reads_) {
+        Packet<PacketLayout<uint8_t>> request;
+        request.set<0>(read.command->key());
+        if(dev_.coalescedTransceive(request.data(), PacketLayout<uint8_t>::length(),
+                                    response.data(), PacketLayout<>::length(read.length)))
+            read.decode(read.command, response.tail(), read.value);
+        else
+            success = false;
+    }
+    return success;
+}
+
+void StellantriebeDevice::Transaction::decodeReads(const uint8_t* data) {
+    for(const Read& read : reads_) {
+        read.decode(read.command, data, read.value);
+        data += read.length;
+    }
+}
+
+} // namespace Feldbus
 } // namespace TURAG
+
+#endif // TURAG_USE_TURAG_FELDBUS_HOST
@@ -2,27 +2,141 @@
 #define TINAPP_FELDBUS_HOST_STELLANTRIEBEDEVICE_H
 #include <tina++/feldbus/host/device.h>
 #include <tina++/feldbus/host/legacystellantriebedevice.h>
+#include <tina++/container/array_buffer.h>
 #include <type_traits>
 #include <cstring>
 
+
+/// \addtogroup feldbus-host
+/// \{
+
+/// Maximale Anzahl an Zugriffen in einer StellantriebeDevice::Transaction.
+#if !defined(TURAG_FELDBUS_STELLANTRIEBE_TRANSACTION_MAX_ENTRIES) || defined(__DOXYGEN__)
+# define TURAG_FELDBUS_STELLANTRIEBE_TRANSACTION_MAX_ENTRIES		16
+#endif
+
+/// \}
+
+
 namespace TURAG {
 namespace Feldbus {
 
 class StellantriebeDevice: public Feldbus::Device {
 public:
     StellantriebeDevice(const char* name, unsigned address, FeldbusAbstraction& feldbus,
-                        ChecksumType type = TURAG_FELDBUS_DEVICE_CONFIG_STANDARD_CHECKSUM_TYPE,
-                        const AddressLength addressLength = TURAG_FELDBUS_DEVICE_CONFIG_STANDARD_ADDRESS_LENGTH) :
-                  Device(name, address, feldbus, type, addressLength),
-                  first_command_(nullptr)
+                        ChecksumType type = TURAG_FELDBUS_DEVICE_CONFIG_STANDARD_CHECKSUM_TYPE) :
+                  Device(name, address, feldbus, type),
+                  first_command_(nullptr), multi_access_(false), structured_output_size_(0),
+                  max_payload_length_(0), write_behind_(false)
     { }
 
-    bool init();
-    using WriteAccess = Feldbus::LegacyStellantriebeDevice::Command_t::WriteAccess;
+    enum class WriteAccess : uint8_t {
+        no_write = TURAG_FELDBUS_STELLANTRIEBE_COMMAND_ACCESS_NO_WRITE_ACCESS,
+        write = TURAG_FELDBUS_STELLANTRIEBE_COMMAND_ACCESS_WRITE_ACCESS
+    };
     using CommandLength = Feldbus::LegacyStellantriebeDevice::Command_t::CommandLength;
     enum class CommandType {
         real, control
     };
+
+    /**
+     * \brief Eigenschaften eines Befehls in einer Befehlstabelle.
+     *
+     * Die Einträge müssen in der Reihenfolge der Keys des Geräts stehen, der
+     * erste Eintrag hat den Key 1.
+     */
+    struct CommandInfo {
+        const char* name;
+        WriteAccess access;
+        CommandLength length;
+        float factor;
+    };
+
+    /**
+     * \brief Sucht alle Commands im Befehlssatz des Geräts.
+     *
+     * Für jedes Command werden Namen und Eigenschaften aller Keys einzeln abgefragt.
+     *
+     * Ist mit Device::setMetadataCache() ein MetadataCache gesetzt, werden Keys und
+     * Eigenschaften der Commands dort abgelegt. Bei einem Treffer wird nur noch die
+     * Größe des Befehlssatzes abgefragt und mit der im Cache verglichen.
+     */
+    bool init();
+
+    /**
+     * \brief Initialisiert die Commands aus einer zur Compile-Zeit bekannten Befehlstabelle.
+     * \param table Befehlstabelle der Firmware des Geräts.
+     *
+     * Statt den Befehlssatz abzufragen, wird nur dessen Fingerabdruck
+     * (\ref TURAG_FELDBUS_STELLANTRIEBE_COMMAND_INFO_GET_COMMANDSET_HASH) mit dem
+     * der Tabelle verglichen, das braucht ein einziges Paket:
+     * \code
+     * constexpr StellantriebeDevice::CommandInfo servoCommands[] = {
+     *     {"currentAngle", StellantriebeDevice::WriteAccess::no_write,
+     *      StellantriebeDevice::CommandLength::length_short, 0.01f},
+     *     {"desiredAngle", StellantriebeDevice::WriteAccess::write,
+     *      StellantriebeDevice::CommandLength::length_short, 0.01f},
+     * };
+     *
+     * class Servo : public StellantriebeDevice {
+     * public:
+     *     Command<int16_t, WriteAccess::write, CommandType::real> desiredAngle{
+     *         "desiredAngle", this, commandKey(servoCommands, "desiredAngle")};
+     *     ...
+     *     bool init() { return StellantriebeDevice::init(servoCommands); }
+     * };
+     * \endcode
+     *
+     * Commands, die mit commandKey() angelegt wurden, bekommen ihren Key ohne
+     * Suche, alle anderen werden in der Tabelle über ihren Namen gefunden.
+     * Liefert das Gerät keinen oder einen anderen Fingerabdruck, wird wie bei
+     * init() der Befehlssatz abgefragt.
+     */
+    template<size_t N>
+    bool init(const CommandInfo (&table)[N]) { return init(table, N); }
+
+    /// \copydoc init(const CommandInfo (&)[N])
+    bool init(const CommandInfo* table, unsigned size);
+
+    /// Berechnet den Fingerabdruck einer Befehlstabelle.
+    static uint32_t commandSetHash(const CommandInfo* table, unsigned size);
+
+    /**
+     * \brief Gibt den Key eines Befehls in einer Befehlstabelle zurück.
+     * \return Key oder 0, wenn der Name nicht in der Tabelle steht.
+     *
+     * Kann zur Compile-Zeit ausgewertet werden.
+     */
+    template<size_t N>
+    static constexpr uint8_t commandKey(const CommandInfo (&table)[N], const char* name) {
+        return findKey(table, N, name, 0);
+    }
+
+    /**
+     * \brief Schaltet das verzögerte Schreiben ein oder aus.
+     * \param enabled True, wenn geschriebene Werte bis zum nächsten flush() zurückgehalten werden sollen.
+     * \return False, wenn beim Ausschalten noch ausstehende Werte nicht übertragen werden konnten.
+     *
+     * Im verzögerten Modus speichert Command::setValue() den Wert nur und markiert
+     * das Command als geändert. Entspricht der Wert dem zuletzt gesetzten, wird
+     * nichts markiert, außer das Gerät hat diesen wegen eines Übertragungsfehlers
+     * nie erhalten. Erst flush() überträgt alle geänderten Werte gemeinsam, wenn
+     * möglich in einem Paket. So können mehrere Programmteile pro Regelzyklus
+     * Sollwerte setzen, ohne dass unveränderte Werte erneut über den Bus gehen.
+     */
+    bool setWriteBehind(bool enabled);
+
+    /// Gibt zurück, ob das verzögerte Schreiben eingeschaltet ist.
+    bool writeBehind(void) const { return write_behind_; }
+
+    /**
+     * \brief Überträgt alle geänderten Werte.
+     * \return False, wenn nicht alle Werte übertragen werden konnten. Diese bleiben
+     * als geändert markiert und werden beim nächsten Aufruf erneut gesendet.
+     *
+     * Sollte im verzögerten Modus einmal pro Regelzyklus aufgerufen werden.
+     */
+    bool flush(void);
 protected:
     //cache for writeable values
     template<typename T, WriteAccess>
@@ -65,8 +179,8 @@ protected:
 
     class CommandBase {
     public:
-        CommandBase(const char* name, StellantriebeDevice* dev):
-            name_(name), dev_(dev), key_(0), next_(nullptr)
+        CommandBase(const char* name, StellantriebeDevice* dev, uint8_t key = 0):
+            name_(name), dev_(dev), key_(key), dirty_(false), cached_(false), next_(nullptr)
         {
             //append to command list of device
             if(!dev_->first_command_) {
@@ -92,13 +206,25 @@ protected:
         //let StellantriebeDevice set properties obtained from device (TODO: clean design)
         virtual void setConversionFactor(float) = 0;
         void setKey(uint8_t key) { key_ = key; }
+        uint8_t key() const { return key_; }
         bool assertInitialized() const;
 
+        //write-behind state, see StellantriebeDevice::setWriteBehind()
+        bool dirty() const { return dirty_; }
+        void clearDirty() { dirty_ = false; }
+        //the device may not have the cached value, see Command::setValue()
+        void markDirty() { dirty_ = true; }
+        //writes the cached value as sent to the device, returns its length (0 if not writable)
+        virtual unsigned encodeCache(uint8_t* data) = 0;
+
         CommandBase* next() const { return next_; }
     protected:
         const char* name_;
         StellantriebeDevice* dev_;
         uint8_t key_;
+        bool dirty_;
+        //cache holds a value set by the host
+        bool cached_;
     private:
         CommandBase* next_;
     };
@@ -110,9 +236,16 @@ protected:
             private CommandCache<InterfaceType, writeaccess>,
             private CommandConversion<T,cmdtype == CommandType::real> {
     public:
+        typedef InterfaceType ValueType;
+        typedef T DeviceType;
+
         Command(const char* name, StellantriebeDevice* dev):
             CommandBase(name, dev)
         {}
+        //key known from a command table, see StellantriebeDevice::commandKey()
+        Command(const char* name, StellantriebeDevice* dev, uint8_t key):
+            CommandBase(name, dev, key)
+        {}
         WriteAccess access() const override { return writeaccess; }
         CommandType type() const override { return cmdtype; }
         CommandLength length() const override { return TypeCommandLength<T>::value; }
@@ -146,19 +279,226 @@ protected:
             static_assert(writeaccess == WriteAccess::write, "Command does not have write access!");
             if (!assertInitialized())
                 return false;
+            T v = this->toDevice(value);
+            if (dev_->write_behind_) {
+                //compare what would be sent, so values which differ only
+                //below the resolution of the device don't count as changes
+                T cached = this->toDevice(this->value_);
+                if (!cached_ || memcmp(&v, &cached, sizeof(T)) != 0)
+                    dirty_ = true;
+                this->value_ = value;
+                cached_ = true;
+                return true;
+            }
+            this->value_ = value;
+            cached_ = true;
+            if (!dev_->setValue<T>(key_, v)) {
+                //otherwise a write-behind setValue() with the same value
+                //would match the cache and never reach the device
+                dirty_ = true;
+                return false;
+            }
+            dirty_ = false;
+            return true;
+        }
+
+        unsigned encodeCache(uint8_t* data) override {
+            return encodeCache(data, std::integral_constant<bool, writeaccess == WriteAccess::write>());
+        }
+
+        //used by Transaction: value as sent to the device, updates the cache
+        void encode(InterfaceType value, uint8_t* data) {
+            static_assert(writeaccess == WriteAccess::write, "Command does not have write access!");
             this->value_ = value;
-            return dev_->setValue<T>(key_, this->toDevice(value));
+            cached_ = true;
+            T v = this->toDevice(value);
+            memcpy(data, &v, sizeof(v)); //assumes host is little-endian
         }
+        //used by Transaction: value received from the device
+        void decode(const uint8_t* data, InterfaceType* value) {
+            T v;
+            memcpy(&v, data, sizeof(v)); //assumes host is little-endian
+            updateCache(this->fromDevice(v), std::integral_constant<bool, writeaccess == WriteAccess::write>());
+            if (value)
+                *value = this->fromDevice(v);
+        }
+    private:
+        void updateCache(InterfaceType value, std::true_type) { this->value_ = value; }
+        void updateCache(InterfaceType, std::false_type) { }
+        unsigned encodeCache(uint8_t* data, std::true_type) {
+            T v = this->toDevice(this->value_);
+            memcpy(data, &v, sizeof(v)); //assumes host is little-endian
+            return sizeof(v);
+        }
+        unsigned encodeCache(uint8_t*, std::false_type) { return 0; }
     };
+
+public:
+    /**
+     * \brief Sammelt Zugriffe auf mehrere Commands und überträgt sie in einem Paket.
+     *
+     * Statt für jeden Wert eine eigene Anfrage zu senden, werden alle Schreib- und
+     * Lesezugriffe mit \ref TURAG_FELDBUS_STELLANTRIEBE_MULTI_ACCESS in einem Paket
+     * übertragen. Die gelesenen Werte kommen in einer Antwort mit einer Checksumme
+     * zurück:
+     * \code
+     * StellantriebeDevice::Transaction transaction(motor);
+     * transaction.set(motor.gain_p, 1.0f);
+     * transaction.set(motor.gain_i, 0.1f);
+     * transaction.set(motor.gain_d, 0.0f);
+     * transaction.get(motor.current_angle, &angle);
+     * transaction.execute();
+     * \endcode
+     *
+     * Alle Schreibzugriffe werden vor den Lesezugriffen ausgeführt. Die Zugriffe
+     * bleiben nach execute() erhalten, sodass eine Transaction in einem Regelkreis
+     * wiederholt ausgeführt werden kann. set() überschreibt dabei den Wert eines
+     * bereits enthaltenen Commands.
+     *
+     * Unterstützt das Gerät den Mehrfachzugriff nicht, werden die Werte einzeln
+     * geschrieben und mehrere Lesezugriffe über die zusammenhängende Datenausgabe
+     * (Structured Output) gelesen, sofern deren Tabelle im Gerät groß genug ist.
+     *
+     * Anfrage und Antwort müssen in den Puffer des Gerätes passen, dessen Größe
+     * init() aus den erweiterten Geräteinformationen liest. Zugriffe, die ihn
+     * überschreiten würden, werden von set() und get() abgelehnt und müssen in
+     * einer weiteren Transaction übertragen werden.
+     */
+    class Transaction {
+    public:
+        explicit Transaction(StellantriebeDevice& dev) :
+            dev_(dev), request_length_(0), response_length_(0)
+        { }
+
+        /**
+         * \brief Fügt einen Schreibzugriff hinzu.
+         * \return False, wenn die Transaction voll ist, das Paket den Puffer des Gerätes
+         * überschreiten würde oder das Command nicht initialisiert wurde.
+         */
+        template<typename Cmd>
+        bool set(Cmd& command, typename Cmd::ValueType value) {
+            if (!command.assertInitialized())
+                return false;
+            Write* write = addWrite(&command, sizeof(typename Cmd::DeviceType));
+            if (!write)
+                return false;
+            command.encode(value, write->data);
+            return true;
+        }
+
+        /**
+         * \brief Fügt einen Lesezugriff hinzu.
+         * \param command Zu lesendes Command.
+         * \param value Ziel, das bei jedem erfolgreichen execute() beschrieben wird.
+         * \return False, wenn die Transaction voll ist, das Paket den Puffer des Gerätes
+         * überschreiten würde oder das Command nicht initialisiert wurde.
+         */
+        template<typename Cmd>
+        bool get(Cmd& command, typename Cmd::ValueType* value) {
+            if (!command.assertInitialized())
+                return false;
+            if (!fits(1, sizeof(typename Cmd::DeviceType)))
+                return false;
+            Read read;
+            read.command = &command;
+            read.value = value;
+            read.decode = &decodeInto<Cmd>;
+            read.length = sizeof(typename Cmd::DeviceType);
+            reads_.push_back(read);
+            request_length_ += 1;
+            response_length_ += read.length;
+            return true;
+        }
+
+        /**
+         * \brief Überträgt alle Zugriffe.
+         * \return True, wenn alle Zugriffe erfolgreich waren.
+         */
+        bool execute(void);
+
+        /// Entfernt alle Zugriffe.
+        void clear(void) {
+            writes_.clear();
+            reads_.clear();
+            request_length_ = 0;
+            response_length_ = 0;
+        }
+
+        /// Anzahl der Zugriffe.
+        unsigned size(void) const { return writes_.size() + reads_.size(); }
+
+    private:
+        friend class StellantriebeDevice;
+
+        typedef void (*Decoder)(CommandBase* command, const uint8_t* data, void* value);
+
+        struct Write {
+            CommandBase* command;
+            uint8_t length;
+            uint8_t data[4];
+        };
+        struct Read {
+            CommandBase* command;
+            void* value;
+            Decoder decode;
+            uint8_t length;
+        };
+
+        template<typename Cmd>
+        static void decodeInto(CommandBase* command, const uint8_t* data, void* value) {
+            static_cast<Cmd*>(command)->decode(data, static_cast<typename Cmd::ValueType*>(value));
+        }
+
+        //whether one more access with the given lengths fits into the transaction
+        bool fits(unsigned request_length, unsigned response_length) const;
+        //returns the existing write of command or appends a new one
+        Write* addWrite(CommandBase* command, uint8_t length);
+        bool executeMultiAccess(void);
+        bool executeSeparately(void);
+        void decodeReads(const uint8_t* data);
+
+        StellantriebeDevice& dev_;
+        ArrayBuffer<Write, TURAG_FELDBUS_STELLANTRIEBE_TRANSACTION_MAX_ENTRIES> writes_;
+        ArrayBuffer<Read, TURAG_FELDBUS_STELLANTRIEBE_TRANSACTION_MAX_ENTRIES> reads_;
+        unsigned request_length_;
+        unsigned response_length_;
+    };
+
 private:
+    static constexpr bool nameEquals(const char* a, const char* b) {
+        return *a == *b && (*a == '\0' || nameEquals(a + 1, b + 1));
+    }
+    static constexpr uint8_t findKey(const CommandInfo* table, size_t size, const char* name, size_t i) {
+        return i == size ? 0 :
+               table[i].name && nameEquals(table[i].name, name) ? static_cast<uint8_t>(i + 1) :
+               findKey(table, size, name, i + 1);
+    }
+
+    //queries the buffer size of the device to limit the size of a Transaction
+    void updateMaxPayloadLength(void);
+    //binds the commands from the metadata cache, false if they are not cached
+    bool initFromCache(uint8_t command_set_size);
+    uint32_t commandNamesHash(void) const;
+    //checks the properties reported for key and assigns it to cmd
+    bool bindCommand(CommandBase* cmd, uint8_t key, WriteAccess access, CommandLength length, float factor);
+
     CommandBase* first_command_;
 
+    //set by init()
+    bool multi_access_;
+    unsigned structured_output_size_;
+    //table currently set in the device for Transaction fallback
+    ArrayBuffer<uint8_t, TURAG_FELDBUS_STELLANTRIEBE_TRANSACTION_MAX_ENTRIES> structured_output_keys_;
+    //payload bytes of a frame fitting into the device buffer, 0 if unknown
+    unsigned max_payload_length_;
+    bool write_behind_;
+
     template<typename T>
     bool getValue(uint8_t key, T* value) {
         Request<uint8_t> req;
         req.data = key;
         Response<T> resp;
-        if(!transceive(req,&resp))
+        if(!coalescedTransceive(req,&resp))
             return false;
         if (value)
             *value = resp.data; //assumes host is little-endian!
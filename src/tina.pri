@@ -70,6 +70,7 @@ contains(TINA, debug) {
       $$PWD/tina++/debug/graph.cpp \
       $$PWD/tina++/debug/errorlogger.cpp \
       $$PWD/tina++/debug/errorobserver.cpp \
+      $$PWD/tina++/debug/latencyhistogram.cpp \
       $$PWD/tina/debug/binary.cpp \
       $$PWD/tina/debug/print.cpp \
       $$PWD/tina/debug/image.c
@@ -79,6 +80,7 @@ contains(TINA, debug) {
       $$PWD/tina++/debug/errorlogger.h \
       $$PWD/tina++/debug/errorobserver.h \
       $$PWD/tina++/debug/graph.h \
+      $$PWD/tina++/debug/latencyhistogram.h \
       $$PWD/tina/debug/binary.h \
       $$PWD/tina/debug/defines.h \
       $$PWD/tina/debug/game_time.h \
@@ -136,6 +138,7 @@ contains(TINA, crc) {
   HEADERS  += \
       $$PWD/tina++/crc/crc.h \
       $$PWD/tina++/crc/xor.h \
+      $$PWD/tina++/crc/fnv.h \
       $$PWD/tina++/crc.h \
       $$PWD/tina/crc/crc_checksum.h \
       $$PWD/tina/crc/xor_checksum.h
@@ -172,17 +175,41 @@ contains(TINA, statemachine) {
 contains(TINA, feldbus-host) {
   SOURCES += \
       $$PWD/tina++/feldbus/host/legacystellantriebedevice.cpp \
+      $$PWD/tina++/feldbus/host/stellantriebedevice.cpp \
       $$PWD/tina++/feldbus/host/aseb_tina.cpp \
       $$PWD/tina++/feldbus/host/bootloader_tina.cpp \
       $$PWD/tina++/feldbus/host/device_tina.cpp \
-      $$PWD/tina++/feldbus/host/feldbusabstraction.cpp
+      $$PWD/tina++/feldbus/host/feldbusabstraction.cpp \
+      $$PWD/tina++/feldbus/host/feldbus_busscheduler.cpp \
+      $$PWD/tina++/feldbus/host/feldbus_flightrecorder.cpp \
+      $$PWD/tina++/feldbus/host/feldbus_healthmonitor.cpp \
+      $$PWD/tina++/feldbus/host/feldbus_bringupcoordinator.cpp \
+      $$PWD/tina++/feldbus/host/feldbus_metadatacache.cpp \
+      $$PWD/tina++/feldbus/host/feldbus_syncreadgroup.cpp \
+      $$PWD/tina++/feldbus/host/feldbus_router.cpp \
+      $$PWD/tina++/feldbus/host/feldbus_requestcoalescer.cpp \
+      $$PWD/tina++/feldbus/host/feldbus_busmeter.cpp \
+      $$PWD/tina++/feldbus/host/feldbus_baudratenegotiator.cpp
 
   HEADERS  += \
       $$PWD/tina++/feldbus/host/legacystellantriebedevice.h \
+      $$PWD/tina++/feldbus/host/stellantriebedevice.h \
       $$PWD/tina++/feldbus/host/aseb.h \
       $$PWD/tina++/feldbus/host/bootloader.h \
       $$PWD/tina++/feldbus/host/device.h \
-      $$PWD/tina++/feldbus/host/feldbusabstraction.h
+      $$PWD/tina++/feldbus/host/feldbusabstraction.h \
+      $$PWD/tina++/feldbus/host/feldbus_busscheduler.h \
+      $$PWD/tina++/feldbus/host/feldbus_flightrecorder.h \
+      $$PWD/tina++/feldbus/host/feldbus_healthmonitor.h \
+      $$PWD/tina++/feldbus/host/feldbus_bringupcoordinator.h \
+      $$PWD/tina++/feldbus/host/feldbus_metadatacache.h \
+      $$PWD/tina++/feldbus/host/feldbus_littleendian.h \
+      $$PWD/tina++/feldbus/host/feldbus_syncreadgroup.h \
+      $$PWD/tina++/feldbus/host/feldbus_router.h \
+      $$PWD/tina++/feldbus/host/feldbus_requestcoalescer.h \
+      $$PWD/tina++/feldbus/host/feldbus_busmeter.h \
+      $$PWD/tina++/feldbus/host/feldbus_packet.h \
+      $$PWD/tina++/feldbus/host/feldbus_baudratenegotiator.h
 }
 
 #
@@ -26,9 +26,7 @@ const uint8_t turag_crc_crc8_table[256] = {
 };
 
 # if !TURAG_CRC_INLINED_CALCULATION
-uint8_t turag_crc8_calculate(const void* data, size_t length) {
-	uint8_t crc = 0xfd;
-
+uint8_t turag_crc8_update(uint8_t crc, const void* data, size_t length) {
     while (length--) {
         crc = turag_crc_crc8_table[crc ^ *(uint8_t*)data];
 		data = (uint8_t*)data + 1;
@@ -41,8 +39,7 @@ uint8_t turag_crc8_calculate(const void* data, size_t length) {
 
 
 #if TURAG_CRC_CRC8_ALGORITHM == 2 && !TURAG_CRC_INLINED_CALCULATION
-uint8_t turag_crc8_calculate(const void* data_, size_t length) {
-	uint8_t crc = 0xfd;
+uint8_t turag_crc8_update(uint8_t crc, const void* data_, size_t length) {
 	uint8_t i;
     uint8_t bit;
     uint8_t c;
@@ -76,8 +73,7 @@ const uint8_t turag_crc_crc8_table[16] = {
 };
 
 # if !TURAG_CRC_INLINED_CALCULATION
-uint8_t turag_crc8_calculate(const void* data_, size_t length) {
-	uint8_t crc = 0xfd;
+uint8_t turag_crc8_update(uint8_t crc, const void* data_, size_t length) {
 	uint8_t tbl_idx;
 	uint8_t* data = (uint8_t*)data_;
 
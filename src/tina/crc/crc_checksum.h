@@ -31,6 +31,21 @@
  */
 uint8_t turag_crc8_calculate(const void* data, size_t length);
 
+/// Start value of a CRC8-checksum (using CRC-8/I-CODE)
+#define TURAG_CRC8_INITIAL_VALUE 0xfd
+
+/** Continues a CRC8-checksum (using CRC-8/I-CODE) with more data
+ * @param		crc		checksum of the preceding data or \ref TURAG_CRC8_INITIAL_VALUE
+ * @param		data	pointer to data that is to be included in the calculation
+ * @param		length	length in bytes of the given data pointer
+ * @return		checksum of the preceding data and the given data
+ *
+ * The checksum can be calculated in pieces as data arrives:
+ * turag_crc8_update(turag_crc8_update(TURAG_CRC8_INITIAL_VALUE, a, n), b, m) equals
+ * the checksum of a and b. Including a correct checksum byte yields zero.
+ */
+uint8_t turag_crc8_update(uint8_t crc, const void* data, size_t length);
+
 
 /** Checks data with a given CRC8-checksum (using CRC-8/I-CODE)
  * @param		data	pointer to data that is to be checked
@@ -103,9 +118,7 @@ extern "C" {
  */
 extern const uint8_t turag_crc_crc8_table[256];
 
-TURAG_INLINE uint8_t turag_crc8_calculate(const void* data, size_t length) {
-	uint8_t crc = 0xfd;
-
+TURAG_INLINE uint8_t turag_crc8_update(uint8_t crc, const void* data, size_t length) {
     while (length--) {
         crc = turag_crc_crc8_table[crc ^ *(const uint8_t*)data];
         data = (const uint8_t*)data + 1;
@@ -127,8 +140,7 @@ TURAG_INLINE uint8_t turag_crc8_calculate(const void* data, size_t length) {
  *    ReflectOut   = False
  *    Algorithm    = bit-by-bit-fast
  */
-TURAG_INLINE uint8_t turag_crc8_calculate(const void* data_, size_t length) {
-	uint8_t crc = 0xfd;
+TURAG_INLINE uint8_t turag_crc8_update(uint8_t crc, const void* data_, size_t length) {
 	uint8_t i;
     uint8_t bit;
     uint8_t c;
@@ -167,8 +179,7 @@ TURAG_INLINE uint8_t turag_crc8_calculate(const void* data_, size_t length) {
  */
 extern const uint8_t turag_crc_crc8_table[16];
 
-TURAG_INLINE uint8_t turag_crc8_calculate(const void* data_, size_t length) {
-	uint8_t crc = 0xfd;
+TURAG_INLINE uint8_t turag_crc8_update(uint8_t crc, const void* data_, size_t length) {
 	uint8_t tbl_idx;
     const uint8_t* data = (const uint8_t*)data_;
 
@@ -186,12 +197,18 @@ TURAG_INLINE uint8_t turag_crc8_calculate(const void* data_, size_t length) {
 
 #else
 # if TURAG_CRC_CRC8_ALGORITHM != 0
-uint8_t turag_crc8_calculate(const void* data, size_t length);
+uint8_t turag_crc8_update(uint8_t crc, const void* data, size_t length);
 # endif
 #endif
 
 
 #if TURAG_CRC_CRC8_ALGORITHM != 0
+# define TURAG_CRC8_INITIAL_VALUE 0xfd
+
+TURAG_INLINE uint8_t turag_crc8_calculate(const void* data, size_t length) {
+    return turag_crc8_update(TURAG_CRC8_INITIAL_VALUE, data, length);
+}
+
 // the check function is always inline
 TURAG_INLINE bool turag_crc8_check(const void* data, size_t length, uint8_t chksum) {
     return chksum == turag_crc8_calculate(data, length);
@@ -117,6 +117,10 @@
 /// @brief Write data to the static data storage at the specified address. Returns 0 on success, an error code on error.
 #define TURAG_FELDBUS_DEVICE_COMMAND_WRITE_TO_STATIC_STORAGE		0x0D
 
+/// @brief Return the highest baud rate the device supports as uint32_t. Devices that
+/// can't change their baud rate don't answer.
+#define TURAG_FELDBUS_DEVICE_COMMAND_GET_MAX_BAUD_RATE				0x0E
+
 
 ///@}
 /**
@@ -151,6 +155,31 @@
 /// @brief disable bus neighbors if no valid bus address
 #define TURAG_FELDBUS_DEVICE_BROADCAST_GO_TO_SLEEP				0x06
 
+/**
+ * @brief Read the same data from several devices with one request (sync read)
+ *
+ * Layout: broadcast address, 0x00, 0x07, slot length, device count n,
+ * n device addresses, payload, checksum.
+ *
+ * Every listed device processes the payload as if it had been sent to it
+ * directly. The device at position i of the list answers i * slot length
+ * byte-times after the end of the request, so the answers follow each other
+ * in the order of the list. Devices not on the list ignore the packet.
+ */
+#define TURAG_FELDBUS_DEVICE_BROADCAST_SYNC_READ				0x07
+
+/**
+ * @brief Switch all capable devices to another baud rate
+ *
+ * Layout: broadcast address, 0x00, 0x08, baud rate (uint32_t), checksum.
+ *
+ * Every device that supports the given baud rate uses it from the next packet
+ * on, all others ignore the packet. Devices return to their default baud rate
+ * after a reset, so the master repeats this broadcast with the default baud rate
+ * to bring them back. Switching to the default baud rate is always supported.
+ */
+#define TURAG_FELDBUS_DEVICE_BROADCAST_SET_BAUD_RATE			0x08
+
 
 
 ///@}
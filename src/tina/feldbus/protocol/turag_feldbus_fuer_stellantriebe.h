@@ -38,6 +38,11 @@
 #define TURAG_FELDBUS_STELLANTRIEBE_COMMAND_ACCESS_READ_ONLY_ACCESS (0x00)
 #define TURAG_FELDBUS_STELLANTRIEBE_COMMAND_ACCESS_WRITE_ONLY_ACCESS (0x01)
 #define TURAG_FELDBUS_STELLANTRIEBE_COMMAND_ACCESS_READ_AND_WRITE_ACCESS (0x02)
+
+// access types of the current protocol version, compatible to the ones above:
+// values that can be written are only changed by the host and may be buffered
+#define TURAG_FELDBUS_STELLANTRIEBE_COMMAND_ACCESS_NO_WRITE_ACCESS (0x00)
+#define TURAG_FELDBUS_STELLANTRIEBE_COMMAND_ACCESS_WRITE_ACCESS (0x01)
 ///@}
 
 /**
@@ -62,6 +67,18 @@
 #define TURAG_FELDBUS_STELLANTRIEBE_COMMAND_INFO_GET_COMMANDSET_SIZE (0x01)
 #define TURAG_FELDBUS_STELLANTRIEBE_COMMAND_INFO_GET_NAME_LENGTH (0x02)
 #define TURAG_FELDBUS_STELLANTRIEBE_COMMAND_INFO_GET_NAME (0x03)
+/**
+ * Fingerabdruck des gesamten Befehlssatzes.
+ *
+ * Anfrage: Adresse, 0x01, 0x04, 0x04, 0x04, Checksumme.
+ * Antwort: Adresse, Fingerabdruck (uint32_t), Checksumme.
+ *
+ * Der Fingerabdruck ist der 32 Bit FNV-1a-Hash über alle Befehle in der
+ * Reihenfolge ihrer Keys. Je Befehl gehen Zugriff, Länge, Faktor (float,
+ * little endian) und der Name mit abschließender 0 ein. Geräte, die ihn
+ * liefern, unterstützen auch \ref TURAG_FELDBUS_STELLANTRIEBE_MULTI_ACCESS.
+ */
+#define TURAG_FELDBUS_STELLANTRIEBE_COMMAND_INFO_GET_COMMANDSET_HASH (0x04)
 ///@}
 
 /**
@@ -78,6 +95,22 @@
 #define TURAG_FELDBUS_STELLANTRIEBE_STRUCTURED_OUTPUT_TABLE_REJECTED (0x00)
 ///@}
 
+/**
+ * @name multi access
+ *
+ * Schreibt und liest mehrere Werte mit einem Paket:
+ * Anfrage: Adresse, 0xFE, Anzahl Schreibzugriffe, je Schreibzugriff Key und Wert,
+ * Keys der zu lesenden Werte, Checksumme.
+ * Antwort: Adresse, gelesene Werte in der Reihenfolge der Anfrage, Checksumme.
+ *
+ * Alle Schreibzugriffe werden vor den Lesezugriffen ausgeführt. Ist einer der
+ * Zugriffe ungültig, wird das gesamte Paket ignoriert. Key 0xFE ist damit
+ * kein gültiger Key eines Gerätewerts.
+ * @{
+ */
+#define TURAG_FELDBUS_STELLANTRIEBE_MULTI_ACCESS (0xFE)
+///@}
+
 /**
  * @name Command Keys für alle Stellantriebe
  * @{